@@ -3,6 +3,7 @@ GIT_VERSION := "Git ($(shell git describe --abbrev=4 --dirty --always --tags))"
 PERFTEST = 0
 HAVE_HWFBE = 0
 HAVE_SHARED_CONTEXT=0
+HAVE_PERF_COUNTERS=1
 HAVE_OPENGL=1
 GLES = 1
 
@@ -60,6 +61,10 @@ ifeq ($(HAVE_SHARED_CONTEXT), 1)
 COMMON_FLAGS += -DHAVE_SHARED_CONTEXT
 endif
 
+ifeq ($(HAVE_PERF_COUNTERS), 1)
+COMMON_FLAGS += -DHAVE_PERF_COUNTERS
+endif
+
 PLATFORM_EXT := unix
 
 ifeq ($(GLIDE64MK2),1)
@@ -15,6 +15,8 @@
 #include "plugin/plugin.h"
 #include "api/m64p_types.h"
 #include "r4300/r4300.h"
+#include "r4300/cp1.h"
+#include "r4300/translation_cache.h"
 #include "memory/memory.h"
 #include "main/main.h"
 #include "main/version.h"
@@ -23,6 +25,8 @@
 #include "pi/pi_controller.h"
 #include "si/pif.h"
 #include "libretro_memory.h"
+#include "libretro_perf.h"
+#include "libretro_rewind.h"
 
 /* Cxd4 RSP */
 #include "../mupen64plus-rsp-cxd4/config.h"
@@ -57,6 +61,46 @@ static const struct retro_hw_render_interface_vulkan *vulkan;
 struct retro_perf_callback perf_cb;
 retro_get_cpu_features_t perf_get_cpu_features_cb = NULL;
 
+#ifdef HAVE_PERF_COUNTERS
+struct retro_perf_counter perf_counters[NUM_PERF_COUNTERS];
+
+static const char *perf_counter_names[NUM_PERF_COUNTERS] = {
+   "r4300_execute",
+   "rsp_gfx_task",
+   "rsp_audio_task",
+   "vi_update_screen",
+   "audio_resample",
+   "savestate_save",
+   "savestate_load",
+   "rewind_push",
+   "rewind_pop"
+};
+
+static void perf_counter_noop(struct retro_perf_counter *counter)
+{
+}
+
+void perf_counters_register(void)
+{
+   unsigned i;
+
+   /* Without a perf interface the counters still have to be callable. */
+   if (!perf_cb.perf_register || !perf_cb.perf_start || !perf_cb.perf_stop)
+   {
+      perf_cb.perf_start = perf_counter_noop;
+      perf_cb.perf_stop  = perf_counter_noop;
+      return;
+   }
+
+   for (i = 0; i < NUM_PERF_COUNTERS; i++)
+   {
+      memset(&perf_counters[i], 0, sizeof(perf_counters[i]));
+      perf_counters[i].ident = perf_counter_names[i];
+      perf_cb.perf_register(&perf_counters[i]);
+   }
+}
+#endif
+
 retro_log_printf_t log_cb = NULL;
 retro_video_refresh_t video_cb = NULL;
 retro_input_poll_t poll_cb = NULL;
@@ -82,6 +126,7 @@ bool flip_only;
 
 static uint8_t* game_data = NULL;
 static uint32_t game_size = 0;
+static char* game_path = NULL;
 
 static bool     emu_initialized     = false;
 static unsigned initial_boot        = true;
@@ -110,6 +155,11 @@ unsigned int FAKE_SDL_TICKS;
 
 static bool initializing = true;
 
+/* set by the controller plugin while a pad the game reads holds L3 */
+int rewind_button = 0;
+static unsigned rewind_granularity = 1;
+static unsigned rewind_frame = 0;
+
 /* after the controller's CONTROL* member has been assigned we can update
  * them straight from here... */
 extern struct
@@ -128,7 +178,7 @@ static void n64DebugCallback(void* aContext, int aLevel, const char* aMessage)
     char buffer[1024];
     snprintf(buffer, 1024, "mupen64plus: %s\n", aMessage);
     if (log_cb)
-       log_cb(RETRO_LOG_INFO, buffer);
+       log_cb(RETRO_LOG_INFO, "%s", buffer);
 }
 
 extern m64p_rom_header ROM_HEADER;
@@ -272,12 +322,18 @@ static void setup_variables(void)
       { NAME_PREFIX "-cpucore",
 #ifdef DYNAREC
 #if defined(IOS)
-         "CPU Core; cached_interpreter|pure_interpreter|dynamic_recompiler" },
+         "CPU Core; cached_interpreter|pure_interpreter|cached_interpreter_threaded|dynamic_recompiler" },
 #else
-         "CPU Core; dynamic_recompiler|cached_interpreter|pure_interpreter" },
+         "CPU Core; dynamic_recompiler|cached_interpreter|cached_interpreter_threaded|pure_interpreter" },
 #endif
 #else
-         "CPU Core; cached_interpreter|pure_interpreter" },
+         "CPU Core; cached_interpreter|cached_interpreter_threaded|pure_interpreter" },
+#endif
+      { NAME_PREFIX "-translation-cache",
+         "Translation Cache (restart); disabled|enabled" },
+#ifdef DYNAREC
+      { NAME_PREFIX "-dynarec-cache-size",
+         "Dynarec Code Cache (MB, restart); 64|128|256|32" },
 #endif
       {NAME_PREFIX "-audio-buffer-size",
          "Audio Buffer Size (restart); 2048|1024"},
@@ -349,6 +405,10 @@ static void setup_variables(void)
          "Boot Device; Default|64DD IPL" },
       { NAME_PREFIX "-64dd-hardware",
          "64DD Hardware; disabled|enabled" },
+      { NAME_PREFIX "-rewind-buffer",
+         "Core Rewind Buffer (MB, hold L3); disabled|32|64|128|256|512" },
+      { NAME_PREFIX "-rewind-granularity",
+         "Core Rewind Granularity (frames); 1|2|4|8" },
       { NULL, NULL },
    };
 
@@ -375,6 +435,7 @@ static bool emu_step_load_data()
 {
    const char *dir;
    char slash;
+   m64p_error rval;
    
    #if defined(_WIN32)
       slash = '\\';
@@ -385,12 +446,17 @@ static bool emu_step_load_data()
    if(CoreStartup(FRONTEND_API_VERSION, ".", ".", "Core", n64DebugCallback, 0, 0) && log_cb)
        log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to initialize core\n");
 
-   if (*((uint32_t *)game_data) != 0x16D348E8 && *((uint32_t *)game_data) != 0x56EE6322)
+   if (game_path || (*((uint32_t *)game_data) != 0x16D348E8 && *((uint32_t *)game_data) != 0x56EE6322))
    {
       /* Regular N64 ROM */
       log_cb(RETRO_LOG_INFO, "EmuThread: M64CMD_ROM_OPEN\n");
 
-      if(CoreDoCommand(M64CMD_ROM_OPEN, game_size, (void*)game_data))
+      if (game_path)
+         rval = CoreDoCommand(M64CMD_ROM_OPEN_FILE, 0, game_path);
+      else
+         rval = CoreDoCommand(M64CMD_ROM_OPEN, game_size, (void*)game_data);
+
+      if(rval)
       {
          if (log_cb)
             log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to load ROM\n");
@@ -399,6 +465,8 @@ static bool emu_step_load_data()
 
       free(game_data);
       game_data = NULL;
+      free(game_path);
+      game_path = NULL;
 
       log_cb(RETRO_LOG_INFO, "EmuThread: M64CMD_ROM_GET_HEADER\n");
 
@@ -501,6 +569,8 @@ static bool emu_step_load_data()
 load_fail:
    free(game_data);
    game_data = NULL;
+   free(game_path);
+   game_path = NULL;
    stop = 1;
 
    return false;
@@ -692,7 +762,12 @@ void retro_get_system_info(struct retro_system_info *info)
    info->library_version = "2.0-rc2";
 #endif
    info->valid_extensions = "n64|v64|z64|bin|u1|ndd";
+#ifdef MSB_FIRST
+   /* the core maps .z64 images it never has to byte swap */
+   info->need_fullpath = true;
+#else
    info->need_fullpath = false;
+#endif
    info->block_extract = false;
 }
 
@@ -756,7 +831,11 @@ void retro_init(void)
    if (environ_cb(RETRO_ENVIRONMENT_GET_PERF_INTERFACE, &perf_cb))
       perf_get_cpu_features_cb = perf_cb.get_cpu_features;
    else
+   {
+      memset(&perf_cb, 0, sizeof(perf_cb));
       perf_get_cpu_features_cb = NULL;
+   }
+   perf_counters_register();
 
    environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &colorMode);
    environ_cb(RETRO_ENVIRONMENT_GET_RUMBLE_INTERFACE, &rumble);
@@ -794,6 +873,7 @@ void retro_deinit(void)
 #endif
 
    deinit_audio_libretro();
+   rewind_deinit();
 
    if (perf_cb.perf_log)
       perf_cb.perf_log();
@@ -1100,6 +1180,28 @@ void update_variables(bool startup)
       }
    }
 
+   var.key = NAME_PREFIX "-rewind-buffer";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      size_t budget = 0;
+
+      if (strcmp(var.value, "disabled"))
+         budget = (size_t)strtoul(var.value, NULL, 10) << 20;
+
+      if (!rewind_init(budget) && log_cb)
+         log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to allocate %s MB rewind buffer\n", var.value);
+   }
+
+   var.key = NAME_PREFIX "-rewind-granularity";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      rewind_granularity = strtoul(var.value, NULL, 10);
+   if (!rewind_granularity)
+      rewind_granularity = 1;
+
 
 }
 
@@ -1201,6 +1303,58 @@ static bool retro_load_game_gl(const struct retro_game_info *game)
    return true;
 }
 
+/* With need_fullpath (big-endian builds) the frontend only passes a path.
+ * Cartridge images are then loaded by the core itself (see open_rom_file),
+ * without an intermediate copy; 64DD disks are still read into game_data. */
+static bool load_game_path(const char *path)
+{
+   uint32_t magic = 0;
+   long length;
+   FILE *fp;
+
+   if (!path || !(fp = fopen(path, "rb")))
+      return false;
+
+   if (fread(&magic, 1, sizeof(magic), fp) != sizeof(magic))
+   {
+      fclose(fp);
+      return false;
+   }
+
+   if (magic != 0x16D348E8 && magic != 0x56EE6322)
+   {
+      fclose(fp);
+      game_path = (char*)malloc(strlen(path) + 1);
+      if (!game_path)
+         return false;
+      strcpy(game_path, path);
+      return true;
+   }
+
+   fseek(fp, 0L, SEEK_END);
+   length = ftell(fp);
+   fseek(fp, 0L, SEEK_SET);
+
+   if (length <= 0)
+   {
+      fclose(fp);
+      return false;
+   }
+
+   game_data = (uint8_t*)malloc(length);
+   game_size = length;
+   if (!game_data || fread(game_data, 1, length, fp) != (size_t)length)
+   {
+      free(game_data);
+      game_data = NULL;
+      fclose(fp);
+      return false;
+   }
+
+   fclose(fp);
+   return true;
+}
+
 bool retro_load_game(const struct retro_game_info *game)
 {
    format_saved_memory();
@@ -1228,9 +1382,14 @@ bool retro_load_game(const struct retro_game_info *game)
          break;
    }
 
-   game_data = malloc(game->size);
-   game_size = game->size;
-   memcpy(game_data, game->data, game->size);
+   if (game->data)
+   {
+      game_data = malloc(game->size);
+      game_size = game->size;
+      memcpy(game_data, game->data, game->size);
+   }
+   else if (!load_game_path(game->path))
+      return false;
 
    stop      = false;
    /* Finish ROM load before doing anything funny, 
@@ -1256,6 +1415,7 @@ void retro_unload_game(void)
 #endif
 
     CoreDoCommand(M64CMD_ROM_CLOSE, 0, NULL);
+    rewind_clear();
     emu_initialized = false;
 }
 
@@ -1291,6 +1451,48 @@ static void glsm_enter(void)
 }
 #endif
 
+static void rewind_step(void)
+{
+   struct rewind_stats stats;
+   int av_enable = 0;
+   bool pushed;
+
+   /* run-ahead's hidden frames are replayed, keep them out of the ring */
+   if (environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &av_enable)
+         && !(av_enable & 1))
+      return;
+
+   if (rewind_button)
+   {
+      rewind_frame = 0;
+      perf_counter_start(PERF_REWIND_POP);
+      rewind_pop();
+      perf_counter_stop(PERF_REWIND_POP);
+      return;
+   }
+
+   /* the delta covers every page dirtied since the last push, so
+    * skipping frames only coarsens the steps */
+   if (++rewind_frame < rewind_granularity)
+      return;
+   rewind_frame = 0;
+
+   perf_counter_start(PERF_REWIND_PUSH);
+   pushed = rewind_push();
+   perf_counter_stop(PERF_REWIND_PUSH);
+   if (!pushed)
+      return;
+
+   rewind_get_stats(&stats);
+   if (log_cb && stats.frames % 600 == 0)
+      log_cb(RETRO_LOG_DEBUG,
+            "mupen64plus: rewind %u frames, %u KB/frame (%u KB raw), %u/%u MB used\n",
+            stats.entries,
+            (unsigned)(stats.bytes_out / stats.frames >> 10),
+            (unsigned)(stats.bytes_in / stats.frames >> 10),
+            (unsigned)(stats.used >> 20), (unsigned)(stats.budget >> 20));
+}
+
 void retro_run (void)
 {
    static bool updated = false;
@@ -1408,7 +1610,9 @@ void retro_run (void)
       }
 
 #ifndef EMSCRIPTEN
+      perf_counter_start(PERF_R4300_EXECUTE);
       co_switch(game_thread);
+      perf_counter_stop(PERF_R4300_EXECUTE);
 #endif
 
       switch (gfx_plugin)
@@ -1425,11 +1629,17 @@ void retro_run (void)
             break;
       }
    } while (emu_step_render());
+
+   /* once the CPU loop has returned its state can't be saved */
+   if (rewind_enabled() && !initializing && !stop)
+      rewind_step();
+   rewind_button = 0;
 }
 
 void retro_reset (void)
 {
     CoreDoCommand(M64CMD_RESET, 1, (void*)0);
+    rewind_clear();
 }
 
 void *retro_get_memory_data(unsigned type)
@@ -1446,29 +1656,45 @@ size_t retro_get_memory_size(unsigned type)
 
 size_t retro_serialize_size (void)
 {
-    return 16788288 + 1024; /* < 16MB and some change... ouch */
+    return SAVESTATE_SIZE; /* < 16MB and some change... ouch */
 }
 
 bool retro_serialize(void *data, size_t size)
 {
+    int ret;
+
     if (initializing)
        return false;
 
-    if (savestates_save_m64p(data, size))
-        return true;
+    perf_counter_start(PERF_SAVESTATE_SAVE);
+    ret = savestates_save_m64p(data, size);
+    perf_counter_stop(PERF_SAVESTATE_SAVE);
 
-    return false;
+    return ret ? true : false;
 }
 
 bool retro_unserialize(const void * data, size_t size)
 {
+    int ret;
+    int av_enable = 0;
+
     if (initializing)
        return false;
 
-    if (savestates_load_m64p(data, size))
-        return true;
+    /* run-ahead and netplay load a state every frame and flag those
+     * loads as fast savestates; only warm the translation cache for the
+     * others */
+    if (!environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &av_enable)
+          || !(av_enable & 4))
+       translation_cache_request_warm();
 
-    return false;
+    perf_counter_start(PERF_SAVESTATE_LOAD);
+    ret = savestates_load_m64p(data, size);
+    perf_counter_stop(PERF_SAVESTATE_LOAD);
+
+    /* the load marks the pages it changes, so the next delta still
+     * leads back to the last rewind frame */
+    return ret ? true : false;
 }
 
 /*Needed to be able to detach controllers 
@@ -1580,8 +1806,13 @@ int retro_return(int just_flipping)
    flip_only = just_flipping;
 
 #ifndef EMSCRIPTEN
+   /* don't leave the game's rounding mode to the frontend */
+   reset_host_rounding();
    co_switch(main_thread);
 #endif
 
+   /* the frontend may have changed the host FPU state meanwhile */
+   restore_host_rounding();
+
    return 0;
 }
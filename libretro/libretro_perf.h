@@ -9,7 +9,37 @@ extern "C" {
 
 extern struct retro_perf_callback perf_cb;
 
-#if 1
+/* Counters for the emulator's own hot sections, registered with the
+ * frontend's perf interface in retro_init. Build with
+ * HAVE_PERF_COUNTERS=0 to compile them out entirely. */
+enum perf_counter
+{
+   PERF_R4300_EXECUTE,     /* emulation thread slice of retro_run */
+   PERF_RSP_GFX_TASK,
+   PERF_RSP_AUDIO_TASK,
+   PERF_VI_UPDATE_SCREEN,
+   PERF_AUDIO_RESAMPLE,
+   PERF_SAVESTATE_SAVE,
+   PERF_SAVESTATE_LOAD,
+   PERF_REWIND_PUSH,
+   PERF_REWIND_POP,
+   NUM_PERF_COUNTERS
+};
+
+#ifdef HAVE_PERF_COUNTERS
+extern struct retro_perf_counter perf_counters[NUM_PERF_COUNTERS];
+
+void perf_counters_register(void);
+
+#define perf_counter_start(id) perf_cb.perf_start(&perf_counters[id])
+#define perf_counter_stop(id) perf_cb.perf_stop(&perf_counters[id])
+#else
+#define perf_counters_register()
+#define perf_counter_start(id)
+#define perf_counter_stop(id)
+#endif
+
+#ifdef HAVE_PERF_COUNTERS
 #define RETRO_PERFORMANCE_INIT(perf_cb, name) static struct retro_perf_counter name = {#name}; if (!name.registered) perf_cb.perf_register(&(name))
 #define RETRO_PERFORMANCE_START(perf_cb, name) perf_cb.perf_start(&(name))
 #define RETRO_PERFORMANCE_STOP(perf_cb, name) perf_cb.perf_stop(&(name))
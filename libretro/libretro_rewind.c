@@ -0,0 +1,341 @@
+/* Core-side rewind buffer.
+ *
+ * Each recorded frame's incremental savestate (see
+ * savestates_save_delta), which only holds the pages written since the
+ * previous one, is zero-run compressed and appended to a fixed-size
+ * byte ring. The oldest frames are dropped once the ring is full.
+ * Loading the newest delta restores the frame before it, so rewinding
+ * walks the ring backwards one entry at a time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libretro_rewind.h"
+
+#include "main/savestates.h"
+
+#define REWIND_MAX_ENTRIES (1 << 14)
+
+enum rewind_method
+{
+   REWIND_RAW,
+   REWIND_ZRLE
+};
+
+struct rewind_entry
+{
+   size_t   offset;
+   uint32_t size;
+   uint32_t raw_size;
+   int      method;
+};
+
+static uint8_t *ring        = NULL;
+static size_t   ring_size   = 0;
+static uint8_t *delta_buf   = NULL;
+static uint8_t *packed_buf  = NULL;
+static size_t   delta_max   = 0;
+
+static struct rewind_entry entries[REWIND_MAX_ENTRIES];
+static unsigned first       = 0;
+static unsigned count       = 0;
+static bool     oldest_is_base;
+
+static struct rewind_stats stats;
+
+/* Zero-run compression. The XORed pages of a delta are mostly zero, so
+ * the stream is a sequence of (zero run, literal length, literals)
+ * tokens with LEB128 lengths. Returns 0 if the output does not fit. */
+static uint8_t *put_varint(uint8_t *dst, const uint8_t *end, size_t v)
+{
+   do
+   {
+      if (dst >= end)
+         return NULL;
+      *dst++ = (uint8_t)((v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+      v >>= 7;
+   } while (v);
+
+   return dst;
+}
+
+static const uint8_t *get_varint(const uint8_t *src, const uint8_t *end, size_t *v)
+{
+   unsigned shift = 0;
+
+   *v = 0;
+   do
+   {
+      if (src >= end || shift >= sizeof(size_t) * 8)
+         return NULL;
+      *v |= (size_t)(*src & 0x7f) << shift;
+      shift += 7;
+   } while (*src++ & 0x80);
+
+   return src;
+}
+
+static size_t zrle_compress(uint8_t *dst, size_t dst_size,
+      const uint8_t *src, size_t src_size)
+{
+   const uint8_t *in     = src;
+   const uint8_t *in_end = src + src_size;
+   uint8_t *out          = dst;
+   uint8_t *out_end      = dst + dst_size;
+
+   while (in < in_end)
+   {
+      const uint8_t *lit;
+      size_t zeros = 0;
+
+      while (in + zeros < in_end && in[zeros] == 0)
+         zeros++;
+      in += zeros;
+
+      /* Short zero runs cost more as a token than as literals. */
+      lit = in;
+      while (lit < in_end)
+      {
+         const uint8_t *z = lit;
+
+         while (z < in_end && *z == 0 && z - lit < 4)
+            z++;
+         if (z - lit >= 4 || z == in_end)
+            break;
+         lit = (z == lit) ? lit + 1 : z;
+      }
+
+      if (!(out = put_varint(out, out_end, zeros)))
+         return 0;
+      if (!(out = put_varint(out, out_end, (size_t)(lit - in))))
+         return 0;
+      if ((size_t)(out_end - out) < (size_t)(lit - in))
+         return 0;
+      memcpy(out, in, lit - in);
+      out += lit - in;
+      in   = lit;
+   }
+
+   return out - dst;
+}
+
+static bool zrle_decompress(uint8_t *dst, size_t dst_size,
+      const uint8_t *src, size_t src_size)
+{
+   const uint8_t *in     = src;
+   const uint8_t *in_end = src + src_size;
+   size_t pos            = 0;
+
+   while (in < in_end)
+   {
+      size_t zeros, literals;
+
+      if (!(in = get_varint(in, in_end, &zeros)))
+         return false;
+      if (!(in = get_varint(in, in_end, &literals)))
+         return false;
+      if (zeros > dst_size - pos)
+         return false;
+      memset(dst + pos, 0, zeros);
+      pos += zeros;
+
+      if (literals > dst_size - pos || literals > (size_t)(in_end - in))
+         return false;
+      memcpy(dst + pos, in, literals);
+      pos += literals;
+      in  += literals;
+   }
+
+   return pos == dst_size;
+}
+
+static struct rewind_entry *entry_at(unsigned i)
+{
+   return &entries[(first + i) % REWIND_MAX_ENTRIES];
+}
+
+static void drop_oldest(void)
+{
+   stats.used -= entries[first].size;
+   first = (first + 1) % REWIND_MAX_ENTRIES;
+   count--;
+   oldest_is_base = false;
+}
+
+void rewind_clear(void)
+{
+   first          = 0;
+   count          = 0;
+   oldest_is_base = true;
+   memset(&stats, 0, sizeof(stats));
+   stats.budget   = ring_size;
+
+   /* The next delta must be taken against a fresh base image. */
+   savestates_delta_reset();
+}
+
+void rewind_deinit(void)
+{
+   free(ring);
+   free(delta_buf);
+   free(packed_buf);
+   ring       = NULL;
+   delta_buf  = NULL;
+   packed_buf = NULL;
+   ring_size  = 0;
+   delta_max  = 0;
+
+   rewind_clear();
+}
+
+bool rewind_init(size_t budget)
+{
+   if (budget == ring_size && (ring || !budget))
+      return true;
+
+   rewind_deinit();
+
+   if (!budget)
+      return true;
+
+   delta_max  = savestates_delta_size_max();
+   ring       = (uint8_t*)malloc(budget);
+   delta_buf  = (uint8_t*)malloc(delta_max);
+   packed_buf = (uint8_t*)malloc(delta_max);
+
+   if (!ring || !delta_buf || !packed_buf)
+   {
+      rewind_deinit();
+      return false;
+   }
+
+   ring_size = budget;
+   rewind_clear();
+   return true;
+}
+
+bool rewind_enabled(void)
+{
+   return ring != NULL;
+}
+
+bool rewind_push(void)
+{
+   struct rewind_entry *e;
+   const uint8_t *data;
+   size_t raw_size, size, start, end;
+   size_t prev_end = 0;
+   int method      = REWIND_ZRLE;
+
+   if (!ring)
+      return false;
+
+   if (!savestates_save_delta(delta_buf, delta_max, &raw_size))
+      return false;
+
+   size = zrle_compress(packed_buf, delta_max, delta_buf, raw_size);
+   data = packed_buf;
+   if (!size || size >= raw_size)
+   {
+      method = REWIND_RAW;
+      size   = raw_size;
+      data   = delta_buf;
+   }
+
+   if (size > ring_size)
+   {
+      /* This frame cannot be kept, and neither can anything older. */
+      first          = 0;
+      count          = 0;
+      stats.used     = 0;
+      oldest_is_base = false;
+      return false;
+   }
+
+   if (count)
+   {
+      e        = entry_at(count - 1);
+      prev_end = e->offset + e->size;
+   }
+
+   start = prev_end;
+   if (start + size > ring_size)
+   {
+      /* Wrap around; everything past the last write is older than
+       * anything at the start of the ring. */
+      start = 0;
+      while (count && entries[first].offset >= prev_end)
+         drop_oldest();
+   }
+   end = start + size;
+
+   while (count)
+   {
+      e = &entries[first];
+      if (count == REWIND_MAX_ENTRIES
+            || (e->offset < end && e->offset + e->size > start))
+         drop_oldest();
+      else
+         break;
+   }
+
+   memcpy(ring + start, data, size);
+
+   e           = entry_at(count);
+   e->offset   = start;
+   e->size     = (uint32_t)size;
+   e->raw_size = (uint32_t)raw_size;
+   e->method   = method;
+   count++;
+
+   stats.used      += size;
+   stats.frames    += 1;
+   stats.bytes_in  += raw_size;
+   stats.bytes_out += size;
+
+   return true;
+}
+
+bool rewind_pop(void)
+{
+   struct rewind_entry *e;
+   const uint8_t *data;
+
+   /* The first delta after a reset goes back to an empty image. */
+   if (!ring || !count || (count == 1 && oldest_is_base))
+      return false;
+
+   e    = entry_at(count - 1);
+   data = ring + e->offset;
+
+   if (e->method == REWIND_ZRLE)
+   {
+      if (!zrle_decompress(delta_buf, e->raw_size, data, e->size))
+      {
+         rewind_clear();
+         return false;
+      }
+      data = delta_buf;
+   }
+
+   if (!savestates_load_delta(data, e->raw_size))
+   {
+      rewind_clear();
+      return false;
+   }
+
+   stats.used -= e->size;
+   count--;
+
+   return true;
+}
+
+void rewind_get_stats(struct rewind_stats *out)
+{
+   *out         = stats;
+   out->budget  = ring_size;
+   out->entries = count;
+   if (oldest_is_base && count)
+      out->entries--;
+}
@@ -0,0 +1,43 @@
+#ifndef _LIBRETRO_REWIND_H_
+#define _LIBRETRO_REWIND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <boolean.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rewind_stats
+{
+   size_t   budget;       /* ring size in bytes */
+   size_t   used;         /* bytes held by live entries */
+   unsigned entries;      /* frames that can be rewound */
+   uint64_t frames;       /* frames pushed since the last reset */
+   uint64_t bytes_in;     /* uncompressed delta bytes pushed */
+   uint64_t bytes_out;    /* compressed bytes pushed */
+};
+
+/* (Re)allocates the ring. A budget of 0 disables rewinding. */
+bool rewind_init(size_t budget);
+void rewind_deinit(void);
+
+/* Drops every entry, e.g. after a reset. */
+void rewind_clear(void);
+
+bool rewind_enabled(void);
+
+/* Records the current emulator state as the newest frame. */
+bool rewind_push(void);
+
+/* Restores the state preceding the newest frame and drops that frame. */
+bool rewind_pop(void);
+
+void rewind_get_stats(struct rewind_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1014,7 +1014,8 @@ EXPORT int CALL ConfigGetParamInt(m64p_handle ConfigSectionHandle, const char *P
       const value_pair Values[32];
    }   libretro_translate[] =
    {
-      { "R4300Emulator", NAME_PREFIX "-cpucore", { { 0, "pure_interpreter" }, { 1, "cached_interpreter" }, { 2, "dynamic_recompiler" }, { 3, "neb_dynamic_recompiler" }, { 0, 0 } } },
+      { "R4300Emulator", NAME_PREFIX "-cpucore", { { 0, "pure_interpreter" }, { 1, "cached_interpreter" }, { 2, "dynamic_recompiler" }, { 3, "neb_dynamic_recompiler" }, { 4, "cached_interpreter_threaded" }, { 0, 0 } } },
+      { "DynarecCacheSize", NAME_PREFIX "-dynarec-cache-size", { { 32, "32" }, { 64, "64" }, { 128, "128" }, { 256, "256" }, { 0, 0 } } },
       { "ScreenWidth", NAME_PREFIX "-screensize", { 
                                                 { 320, "320x200" },
                                                 { 320, "320x240" },
@@ -1205,6 +1206,11 @@ EXPORT int CALL ConfigGetParamBool(m64p_handle ConfigSectionHandle, const char *
             { 0, "disabled" }, { 1, "enabled" }
          }
       },
+      { "TranslationCache", NAME_PREFIX "-translation-cache",
+         {
+            { 0, "disabled" }, { 1, "enabled" }
+         }
+      },
       { 0, 0, { {0, 0} } }
    };
 
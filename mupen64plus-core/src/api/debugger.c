@@ -37,6 +37,7 @@
 #include "debugger/dbg_decoder.h"
 #include "debugger/dbg_memory.h"
 #include "debugger/debugger.h"
+#include "main/device.h"
 #include "main/main.h"
 #include "memory/memory.h"
 #include "../pi/pi_controller.h"
@@ -214,17 +215,17 @@ EXPORT void * CALL DebugMemGetPointer(m64p_dbg_memptr_type mem_ptr_type)
     switch (mem_ptr_type)
     {
         case M64P_DBG_PTR_RDRAM:
-            return g_rdram;
+            return g_dev.rdram;
         case M64P_DBG_PTR_PI_REG:
-            return g_pi.regs;
+            return g_dev.pi.regs;
         case M64P_DBG_PTR_SI_REG:
-            return g_si.regs;
+            return g_dev.si.regs;
         case M64P_DBG_PTR_VI_REG:
-            return g_vi.regs;
+            return g_dev.vi.regs;
         case M64P_DBG_PTR_RI_REG:
-            return g_ri.regs;
+            return g_dev.ri.regs;
         case M64P_DBG_PTR_AI_REG:
-            return g_ai.regs;
+            return g_dev.ai.regs;
         default:
             DebugMessage(M64MSG_ERROR, "Bug: DebugMemGetPointer() called with invalid m64p_dbg_memptr_type");
             return NULL;
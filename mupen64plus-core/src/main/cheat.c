@@ -26,8 +26,10 @@
 #include "api/callbacks.h"
 #include "api/config.h"
 
+#include "savestates.h"
 #include "memory/memory.h"
 #include "cheat.h"
+#include "device.h"
 #include "main.h"
 #include "rom.h"
 #include "list.h"
@@ -65,35 +67,37 @@ extern unsigned int frame_dupe;
 /* Private functions */
 static uint16_t read_address_16bit(unsigned int address)
 {
-    return *(uint16_t*)(((uint8_t*)g_rdram + ((address & 0xFFFFFF)^S16)));
+    return *(uint16_t*)(((uint8_t*)g_dev.rdram + ((address & 0xFFFFFF)^S16)));
 }
 
 static uint8_t read_address_8bit(unsigned int address)
 {
-    return *(unsigned char *)(((unsigned char*)g_rdram + ((address & 0xFFFFFF)^S8)));
+    return *(unsigned char *)(((unsigned char*)g_dev.rdram + ((address & 0xFFFFFF)^S8)));
 }
 
 static void update_address_16bit(unsigned int address, unsigned short new_value)
 {
-    *(uint16_t *)(((uint8_t*)g_rdram + ((address & 0xFFFFFF)^S16))) = new_value;
+    *(uint16_t *)(((uint8_t*)g_dev.rdram + ((address & 0xFFFFFF)^S16))) = new_value;
+    savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, address & 0x7FFFFF, 2);
 }
 
 static void update_address_8bit(unsigned int address, unsigned char new_value)
 {
-     *(uint8_t *)(((uint8_t*)g_rdram + ((address & 0xFFFFFF)^S8))) = new_value;
+     *(uint8_t *)(((uint8_t*)g_dev.rdram + ((address & 0xFFFFFF)^S8))) = new_value;
+     savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, address & 0x7FFFFF, 1);
 }
 
 static int address_equal_to_8bit(unsigned int address, unsigned char value)
 {
     unsigned char value_read;
-    value_read = *(unsigned char *)(((unsigned char*)g_rdram + ((address & 0xFFFFFF)^S8)));
+    value_read = *(unsigned char *)(((unsigned char*)g_dev.rdram + ((address & 0xFFFFFF)^S8)));
     return value_read == value;
 }
 
 static int address_equal_to_16bit(unsigned int address, unsigned short value)
 {
     unsigned short value_read;
-    value_read = *(unsigned short *)(((unsigned char*)g_rdram + ((address & 0xFFFFFF)^S16)));
+    value_read = *(unsigned short *)(((unsigned char*)g_dev.rdram + ((address & 0xFFFFFF)^S16)));
     return value_read == value;
 }
 
@@ -0,0 +1,73 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - device.h                                                *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2016 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_DEVICE_H
+#define M64P_MAIN_DEVICE_H
+
+#include <stdint.h>
+
+#include "main.h"
+#include "../ai/ai_controller.h"
+#include "../dd/dd_controller.h"
+#include "../memory/memory.h"
+#include "../osal/preproc.h"
+#include "../pi/pi_controller.h"
+#include "../r4300/r4300_core.h"
+#include "../rdp/rdp_core.h"
+#include "../ri/ri_controller.h"
+#include "../rsp/rsp_core.h"
+#include "../si/si_controller.h"
+#include "../vi/vi_controller.h"
+
+/* RDRAM, the memory map and the r4300/RCP components wired together by
+ * connect_all().
+ *
+ * This only groups the state, it doesn't make the core reentrant: there
+ * is exactly one machine per process, g_dev. The CPU registers (reg, PC,
+ * cp0/cp1), the memory access latches (address, cpu_word, ...), blocks
+ * and invalid_code, and the dynarec state are still separate globals
+ * that the code generators and linkage_*.S address by symbol. Running
+ * several machines would need all of these moved in here and a struct
+ * device* passed through the handlers.
+ *
+ * rdram must stay the first member: linkage_x86.asm addresses it
+ * through the g_dev symbol. */
+struct device
+{
+    ALIGN(16, uint32_t rdram[RDRAM_MAX_SIZE/4]);
+
+    struct memory mem;
+
+    struct r4300_core r4300;
+    struct rdp_core dp;
+    struct rsp_core sp;
+
+    struct ai_controller ai;
+    struct pi_controller pi;
+    struct ri_controller ri;
+    struct si_controller si;
+    struct vi_controller vi;
+    struct dd_controller dd;
+};
+
+extern struct device g_dev;
+
+#endif
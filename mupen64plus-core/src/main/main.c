@@ -45,6 +45,7 @@
 
 #include "main.h"
 #include "cheat.h"
+#include "device.h"
 #include "eventloop.h"
 #include "rom.h"
 #include "savestates.h"
@@ -61,6 +62,7 @@
 #include "../r4300/r4300.h"
 #include "../r4300/r4300_core.h"
 #include "../r4300/reset.h"
+#include "../r4300/translation_cache.h"
 #include "../rdp/rdp_core.h"
 #include "../rsp/rsp_core.h"
 #include "../ri/ri_controller.h"
@@ -91,16 +93,7 @@ int         g_MemHasBeenBSwapped = 0;   /* store byte-swapped flag so we don't s
 int        g_DDMemHasBeenBSwapped = 0; /* store byte-swapped flag so we don't swap twice when re-playing game */
 int         g_EmulatorRunning = 0;      /* need separate boolean to tell if emulator is running, since --nogui doesn't use a thread */
 
-ALIGN(16, uint32_t g_rdram[RDRAM_MAX_SIZE/4]);
-struct ai_controller g_ai;
-struct pi_controller g_pi;
-struct ri_controller g_ri;
-struct si_controller g_si;
-struct vi_controller g_vi;
-struct dd_controller g_dd;
-struct r4300_core g_r4300;
-struct rdp_core g_dp;
-struct rsp_core g_sp;
+struct device g_dev;
 
 int g_delay_si = 0;
 
@@ -162,11 +155,13 @@ int main_set_core_defaults(void)
    ConfigSetDefaultFloat(g_CoreConfig, "Version", (float) CONFIG_PARAM_VERSION,  "Mupen64Plus Core config parameter set version number.  Please don't change this version number.");
    ConfigSetDefaultBool(g_CoreConfig, "OnScreenDisplay", 1, "Draw on-screen display if True, otherwise don't draw OSD");
 #if defined(DYNAREC)
-   ConfigSetDefaultInt(g_CoreConfig, "R4300Emulator", 2, "Use Pure Interpreter if 0, Cached Interpreter if 1, or Dynamic Recompiler if 2 or more");
+   ConfigSetDefaultInt(g_CoreConfig, "R4300Emulator", 2, "Use Pure Interpreter if 0, Cached Interpreter if 1, Dynamic Recompiler if 2, or Cached Interpreter with threaded dispatch if 4");
 #else
-   ConfigSetDefaultInt(g_CoreConfig, "R4300Emulator", 1, "Use Pure Interpreter if 0, Cached Interpreter if 1, or Dynamic Recompiler if 2 or more");
+   ConfigSetDefaultInt(g_CoreConfig, "R4300Emulator", 1, "Use Pure Interpreter if 0, Cached Interpreter if 1, Dynamic Recompiler if 2, or Cached Interpreter with threaded dispatch if 4");
 #endif
    ConfigSetDefaultBool(g_CoreConfig, "NoCompiledJump", 0, "Disable compiled jump commands in dynamic recompiler (should be set to False) ");
+   ConfigSetDefaultInt(g_CoreConfig, "DynarecCacheSize", 64, "Size in MB of the dynamic recompiler's code cache; it is flushed when full");
+   ConfigSetDefaultBool(g_CoreConfig, "TranslationCache", 0, "Remember translated code addresses per ROM on disk and compile them ahead of time");
    ConfigSetDefaultBool(g_CoreConfig, "DisableExtraMem", 0, "Disable 4MB expansion RAM pack. May be necessary for some games");
    ConfigSetDefaultBool(g_CoreConfig, "EnableDebugger", 0, "Activate the R4300 debugger when ROM execution begins, if core was built with Debugger support");
    ConfigSetDefaultInt(g_CoreConfig, "CountPerOp", 0, "Force number of cycles per emulated instruction.");
@@ -331,8 +326,32 @@ static void connect_all(
    connect_dd(dd, r4300, dd_disk, dd_disk_size);
 }
 
-static void dummy_save(void *user_data)
+/* The save chips live in saved_memory, which the frontend flushes itself.
+ * Their save callbacks only mark what changed for incremental savestates. */
+static void mark_chip(const void *data, uint32_t size)
 {
+   savestates_mark_dirty(SAVESTATE_DIRTY_CHIPS,
+         (uint32_t)((const uint8_t*)data - (const uint8_t*)&saved_memory), size);
+}
+
+static void eeprom_save_dirty(void *user_data)
+{
+   mark_chip(saved_memory.eeprom, sizeof(saved_memory.eeprom));
+}
+
+static void mempak_save_dirty(void *user_data)
+{
+   mark_chip(user_data, sizeof(saved_memory.mempack[0]));
+}
+
+static void sram_save_dirty(void *user_data)
+{
+   mark_chip(saved_memory.sram, sizeof(saved_memory.sram));
+}
+
+static void flashram_save_dirty(void *user_data)
+{
+   mark_chip(saved_memory.flashram, sizeof(saved_memory.flashram));
 }
 
 /*********************************************************************************************************
@@ -348,6 +367,9 @@ m64p_error main_init(void)
 
    /* set some other core parameters based on the config file values */
    no_compiled_jump = ConfigGetParamBool(g_CoreConfig, "NoCompiledJump");
+   if (ConfigGetParamInt(g_CoreConfig, "DynarecCacheSize") > 0)
+      code_cache_limit = (size_t)ConfigGetParamInt(g_CoreConfig, "DynarecCacheSize") << 20;
+   translation_cache_enabled = ConfigGetParamBool(g_CoreConfig, "TranslationCache");
    disable_extra_mem = ConfigGetParamInt(g_CoreConfig, "DisableExtraMem");
 #if 0
    count_per_op = ConfigGetParamInt(g_CoreConfig, "CountPerOp");
@@ -356,22 +378,23 @@ m64p_error main_init(void)
    if (count_per_op <= 0)
       count_per_op = 2;
 
-   /* do byte-swapping if it's not been done yet */
+   /* do byte-swapping if it's not been done yet; cartridge reads load
+    * whole words, so big-endian hosts use the .z64 order as is */
    if (g_MemHasBeenBSwapped == 0)
    {
-      swap_buffer(g_rom, 4, g_rom_size / 4);
+      swap_loaded_rom();
       g_MemHasBeenBSwapped = 1;
    }
 
    if (g_DDMemHasBeenBSwapped == 0)
    {
-      swap_buffer(g_ddrom, 4, g_ddrom_size / 4);
+      to_big_endian_buffer(g_ddrom, 4, g_ddrom_size / 4);
       g_DDMemHasBeenBSwapped = 1;
    }
 
-   connect_all(&g_r4300, &g_dp, &g_sp,
-         &g_ai, &g_pi, &g_ri, &g_si, &g_vi, &g_dd,
-         g_rdram, (disable_extra_mem == 0) ? 0x800000 : 0x400000,
+   connect_all(&g_dev.r4300, &g_dev.dp, &g_dev.sp,
+         &g_dev.ai, &g_dev.pi, &g_dev.ri, &g_dev.si, &g_dev.vi, &g_dev.dd,
+         g_dev.rdram, (disable_extra_mem == 0) ? 0x800000 : 0x400000,
          g_rom, g_rom_size, g_ddrom, g_ddrom_size, g_dd_disk, g_dd_disk_size);
 
    init_memory();
@@ -392,58 +415,58 @@ m64p_error main_init(void)
    }
 
    /* connect external time source to AF_RTC component */
-   g_si.pif.af_rtc.user_data = NULL;
-   g_si.pif.af_rtc.get_time = get_time_using_C_localtime;
+   g_dev.si.pif.af_rtc.user_data = NULL;
+   g_dev.si.pif.af_rtc.get_time = get_time_using_C_localtime;
 
    /* connect external game controllers */
    for(i = 0; i < GAME_CONTROLLERS_COUNT; ++i)
    {
-      g_si.pif.controllers[i].user_data = &channels[i];
-      g_si.pif.controllers[i].is_connected = egcvip_is_connected;
-      g_si.pif.controllers[i].get_input = egcvip_get_input;
+      g_dev.si.pif.controllers[i].user_data = &channels[i];
+      g_dev.si.pif.controllers[i].is_connected = egcvip_is_connected;
+      g_dev.si.pif.controllers[i].get_input = egcvip_get_input;
    }
 
    /* connect external rumblepaks */
    for(i = 0; i < GAME_CONTROLLERS_COUNT; ++i)
    {
-      g_si.pif.controllers[i].rumblepak.user_data = &channels[i];
-      g_si.pif.controllers[i].rumblepak.rumble = rvip_rumble;
+      g_dev.si.pif.controllers[i].rumblepak.user_data = &channels[i];
+      g_dev.si.pif.controllers[i].rumblepak.rumble = rvip_rumble;
    }
 
    /* connect saved_memory.mempacks to mempaks */
    for(i = 0; i < GAME_CONTROLLERS_COUNT; ++i)
    {
-      g_si.pif.controllers[i].mempak.user_data = NULL;
-      g_si.pif.controllers[i].mempak.save = dummy_save;
-      g_si.pif.controllers[i].mempak.data = &saved_memory.mempack[i][0];
+      g_dev.si.pif.controllers[i].mempak.user_data = &saved_memory.mempack[i][0];
+      g_dev.si.pif.controllers[i].mempak.save = mempak_save_dirty;
+      g_dev.si.pif.controllers[i].mempak.data = &saved_memory.mempack[i][0];
    }
 
    /* connect saved_memory.eeprom to eeprom */
-   g_si.pif.eeprom.user_data = NULL;
-   g_si.pif.eeprom.save = dummy_save;
-   g_si.pif.eeprom.data = saved_memory.eeprom;
+   g_dev.si.pif.eeprom.user_data = NULL;
+   g_dev.si.pif.eeprom.save = eeprom_save_dirty;
+   g_dev.si.pif.eeprom.data = saved_memory.eeprom;
    if (ROM_SETTINGS.savetype != EEPROM_16KB)
    {
       /* 4kbits EEPROM */
-      g_si.pif.eeprom.size = 0x200;
-      g_si.pif.eeprom.id = 0x8000;
+      g_dev.si.pif.eeprom.size = 0x200;
+      g_dev.si.pif.eeprom.id = 0x8000;
    }
    else
    {
       /* 16kbits EEPROM */
-      g_si.pif.eeprom.size = 0x800;
-      g_si.pif.eeprom.id = 0xc000;
+      g_dev.si.pif.eeprom.size = 0x800;
+      g_dev.si.pif.eeprom.id = 0xc000;
    }
 
    /* connect saved_memory.flashram to flashram */
-   g_pi.flashram.user_data = NULL;
-   g_pi.flashram.save = dummy_save;
-   g_pi.flashram.data = saved_memory.flashram;
+   g_dev.pi.flashram.user_data = NULL;
+   g_dev.pi.flashram.save = flashram_save_dirty;
+   g_dev.pi.flashram.data = saved_memory.flashram;
 
    /* connect saved_memory.sram to SRAM */
-   g_pi.sram.user_data = NULL;
-   g_pi.sram.save = dummy_save;
-   g_pi.sram.data = saved_memory.sram;
+   g_dev.pi.sram.user_data = NULL;
+   g_dev.pi.sram.save = sram_save_dirty;
+   g_dev.pi.sram.data = saved_memory.sram;
 
 #ifdef DBG
    if (ConfigGetParamBool(g_CoreConfig, "EnableDebugger"))
@@ -462,6 +485,10 @@ m64p_error main_init(void)
 
 m64p_error main_run(void)
 {
+   /* the CPU reads the whole cartridge, which the MD5 thread may
+    * still be byte-swapping */
+   rom_md5_wait();
+
    r4300_execute();
 
    return M64ERR_SUCCESS;
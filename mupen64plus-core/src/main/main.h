@@ -28,15 +28,6 @@
 
 #include <stdint.h>
 
-struct r4300_core;
-struct rsp_core;
-struct ai_controller;
-struct pi_controller;
-struct ri_controller;
-struct si_controller;
-struct vi_controller;
-struct dd_controller;
-
 enum { RDRAM_MAX_SIZE = 0x800000 };
 
 /* globals */
@@ -46,20 +37,6 @@ extern int g_MemHasBeenBSwapped;
 extern int g_DDMemHasBeenBSwapped;
 extern int g_EmulatorRunning;
 
-extern ALIGN(16, uint32_t g_rdram[RDRAM_MAX_SIZE/4]);
-
-extern struct ai_controller g_ai;
-extern struct pi_controller g_pi;
-extern struct ri_controller g_ri;
-extern struct si_controller g_si;
-extern struct vi_controller g_vi;
-extern struct dd_controller g_dd;
-
-extern struct r4300_core g_r4300;
-extern struct rdp_core g_dp;
-extern struct rsp_core g_sp;
-
-
 extern m64p_frame_callback g_FrameCallback;
 
 extern int g_delay_si;
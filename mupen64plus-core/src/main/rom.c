@@ -24,6 +24,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif
 
 #define M64P_CORE_PROTOTYPES 1
 #include "api/m64p_types.h"
@@ -47,6 +60,28 @@
 unsigned char* g_rom = NULL;
 /* Global loaded rom size. */
 int g_rom_size = 0;
+/* Length of the file mapping g_rom points into, 0 if it was malloc'd. */
+static size_t g_rom_mapping_size = 0;
+
+/* The MD5 is only needed once emulation starts, so where threads are
+ * available it is computed in the background; see rom_md5_wait. The
+ * first ROM_MD5_HEAD bytes, which the core and the plugins read while
+ * starting up, are hashed right away; the thread hashes the rest and
+ * then byte-swaps it itself. The key identifies the ROM file in the
+ * MD5 cache, NULL if it has none. */
+#define ROM_MD5_HEAD 0x1000
+#define MD5_CACHE_FILE "mupen64plus_md5.cache"
+#define MD5_CACHE_ENTRIES 256
+
+static md5_state_t g_rom_md5_state;
+static md5_byte_t g_rom_digest[16];
+static char *g_rom_md5_key = NULL;
+#ifdef HAVE_THREADS
+static pthread_t g_rom_md5_thread;
+static int g_rom_md5_pending = 0;
+/* set while the tail of g_rom is (being) byte-swapped by the thread */
+static int g_rom_tail_swapped = 0;
+#endif
 unsigned alternate_vi_timing = 0;
 
 uint8_t isGoldeneyeRom = 0;
@@ -133,82 +168,218 @@ static int is_valid_rom(const unsigned char *buffer)
  */
 static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int loadlength)
 {
-   unsigned char temp;
-   int i;
-
    /* Btyeswap if .v64 image. */
    if(localrom[0]==0x37)
    {
       *imagetype = V64IMAGE;
-      for (i = 0; i < loadlength; i+=2)
-      {
-         temp=localrom[i];
-         localrom[i]=localrom[i+1];
-         localrom[i+1]=temp;
-      }
+      swap_buffer(localrom, 2, loadlength / 2);
    }
    /* Wordswap if .n64 image. */
    else if(localrom[0]==0x40)
    {
       *imagetype = N64IMAGE;
-      for (i = 0; i < loadlength; i+=4)
-      {
-         temp=localrom[i];
-         localrom[i]=localrom[i+3];
-         localrom[i+3]=temp;
-         temp=localrom[i+1];
-         localrom[i+1]=localrom[i+2];
-         localrom[i+2]=temp;
-      }
+      swap_buffer(localrom, 4, loadlength / 4);
    }
    else
       *imagetype = Z64IMAGE;
 }
 
-m64p_error open_rom(const unsigned char* romimage, unsigned int size)
+/* The MD5 cache is a text file of "<MD5> <size> <mtime> <path>" lines,
+ * most recently stored first and at most one per path. */
+static char *md5_cache_path(void)
+{
+   const char *dir = ConfigGetUserCachePath();
+
+   return dir != NULL ? combinepath(dir, MD5_CACHE_FILE) : NULL;
+}
+
+static int md5_cache_lookup(const char *key, char *md5)
+{
+   char line[4096];
+   char *path = md5_cache_path();
+   FILE *f = path != NULL ? fopen(path, "r") : NULL;
+   int found = 0;
+
+   free(path);
+   if (f == NULL)
+      return 0;
+
+   while (!found && fgets(line, sizeof(line), f) != NULL)
+   {
+      line[strcspn(line, "\r\n")] = '\0';
+      if (strlen(line) > 33 && line[32] == ' ' && strcmp(line + 33, key) == 0)
+      {
+         memcpy(md5, line, 32);
+         md5[32] = '\0';
+         found = 1;
+      }
+   }
+
+   fclose(f);
+   return found;
+}
+
+/* Skips the size and mtime of a cache key. */
+static const char *md5_key_path(const char *key)
+{
+   const char *p = strchr(key, ' ');
+
+   if (p != NULL)
+      p = strchr(p + 1, ' ');
+   return p != NULL ? p + 1 : key;
+}
+
+/* Rewrites the cache with the new entry in front, dropping the old
+ * entry for the same file and anything past MD5_CACHE_ENTRIES. */
+static void md5_cache_store(const char *key, const char *md5)
+{
+   char line[4096];
+   char *path = md5_cache_path();
+   char *tmp = path != NULL ? formatstr("%s.tmp", path) : NULL;
+   FILE *in, *out;
+   int entries = 1;
+   int ok;
+
+   if (tmp == NULL || (out = fopen(tmp, "w")) == NULL)
+   {
+      free(tmp);
+      free(path);
+      return;
+   }
+
+   fprintf(out, "%s %s\n", md5, key);
+
+   if ((in = fopen(path, "r")) != NULL)
+   {
+      while (entries < MD5_CACHE_ENTRIES && fgets(line, sizeof(line), in) != NULL)
+      {
+         line[strcspn(line, "\r\n")] = '\0';
+         if (strlen(line) <= 33 || line[32] != ' '
+               || strcmp(md5_key_path(line + 33), md5_key_path(key)) == 0)
+            continue;
+         fprintf(out, "%s\n", line);
+         entries++;
+      }
+      fclose(in);
+   }
+
+   /* rename() won't replace an existing file everywhere */
+   ok = fclose(out) == 0;
+   if (ok)
+   {
+      remove(path);
+      ok = rename(tmp, path) == 0;
+   }
+   if (!ok)
+   {
+      DebugMessage(M64MSG_WARNING, "couldn't update MD5 cache %s", path);
+      remove(tmp);
+   }
+
+   free(tmp);
+   free(path);
+}
+
+#ifdef HAVE_THREADS
+static void *rom_md5_thread(void *arg)
+{
+   size_t tail = g_rom_size - ROM_MD5_HEAD;
+
+   md5_append(&g_rom_md5_state, (const md5_byte_t*)g_rom + ROM_MD5_HEAD, tail);
+   md5_finish(&g_rom_md5_state, g_rom_digest);
+   to_big_endian_buffer(g_rom + ROM_MD5_HEAD, 4, tail / 4);
+   return NULL;
+}
+#endif
+
+static void finish_rom_md5(void)
 {
-#include "rom_luts.c"
-   md5_state_t state;
-   md5_byte_t digest[16];
-   char buffer[256];
-   unsigned char imagetype;
    int i;
-   uint64_t lut_id;
-   int patch_applied = 0;
 
-   /* check input requirements */
-   if (g_rom != NULL)
+   for (i = 0; i < 16; ++i)
+      sprintf(ROM_SETTINGS.MD5 + i * 2, "%02X", g_rom_digest[i]);
+   ROM_SETTINGS.MD5[32] = '\0';
+
+   if (g_rom_md5_key != NULL)
+      md5_cache_store(g_rom_md5_key, ROM_SETTINGS.MD5);
+
+   DebugMessage(M64MSG_INFO, "MD5: %s", ROM_SETTINGS.MD5);
+}
+
+/* g_rom must hold the .z64 image; only its first ROM_MD5_HEAD bytes
+ * may change before rom_md5_wait. */
+static void start_rom_md5(void)
+{
+   ROM_SETTINGS.MD5[0] = '\0';
+#ifdef HAVE_THREADS
+   g_rom_tail_swapped = 0;
+#endif
+
+   if (g_rom_md5_key != NULL && md5_cache_lookup(g_rom_md5_key, ROM_SETTINGS.MD5))
    {
-      DebugMessage(M64MSG_ERROR, "open_rom(): previous ROM image was not freed");
-      return M64ERR_INTERNAL;
+      DebugMessage(M64MSG_INFO, "MD5: %s (cached)", ROM_SETTINGS.MD5);
+      return;
    }
-   if (romimage == NULL || !is_valid_rom(romimage))
+
+   md5_init(&g_rom_md5_state);
+
+#ifdef HAVE_THREADS
+   if (g_rom_size > ROM_MD5_HEAD)
    {
-      DebugMessage(M64MSG_ERROR, "open_rom(): not a valid ROM image");
-      return M64ERR_INPUT_INVALID;
+      md5_append(&g_rom_md5_state, (const md5_byte_t*)g_rom, ROM_MD5_HEAD);
+      if (pthread_create(&g_rom_md5_thread, NULL, rom_md5_thread, NULL) == 0)
+      {
+         g_rom_md5_pending = 1;
+         g_rom_tail_swapped = 1;
+         return;
+      }
+      md5_init(&g_rom_md5_state);
    }
+#endif
+
+   md5_append(&g_rom_md5_state, (const md5_byte_t*)g_rom, g_rom_size);
+   md5_finish(&g_rom_md5_state, g_rom_digest);
+   finish_rom_md5();
+}
+
+void rom_md5_wait(void)
+{
+#ifdef HAVE_THREADS
+   if (!g_rom_md5_pending)
+      return;
+
+   pthread_join(g_rom_md5_thread, NULL);
+   g_rom_md5_pending = 0;
+   finish_rom_md5();
+#endif
+}
+
+void swap_loaded_rom(void)
+{
+   size_t length = g_rom_size;
+
+#ifdef HAVE_THREADS
+   if (g_rom_tail_swapped)
+      length = ROM_MD5_HEAD;
+#endif
+
+   to_big_endian_buffer(g_rom, 4, length / 4);
+}
+
+/* Fills in the ROM header, settings and hacks once g_rom holds a .z64 image. */
+static m64p_error setup_rom(unsigned char imagetype)
+{
+#include "rom_luts.c"
+   char buffer[256];
+   int i;
+   uint64_t lut_id;
+   int patch_applied = 0;
 
-   /* Clear Byte-swapped flag, since ROM is now deleted. */
-   g_MemHasBeenBSwapped = 0;
-   /* allocate new buffer for ROM and copy into this buffer */
-   g_rom_size = size;
-   g_rom = (unsigned char *) malloc(size);
    alternate_vi_timing = 0;
-   if (g_rom == NULL)
-      return M64ERR_NO_MEMORY;
-   memcpy(g_rom, romimage, size);
-   swap_rom(g_rom, &imagetype, g_rom_size);
 
    memcpy(&ROM_HEADER, g_rom, sizeof(m64p_rom_header));
 
-   /* Calculate MD5 hash  */
-   md5_init(&state);
-   md5_append(&state, (const md5_byte_t*)g_rom, g_rom_size);
-   md5_finish(&state, digest);
-   for ( i = 0; i < 16; ++i )
-      sprintf(buffer+i*2, "%02X", digest[i]);
-   buffer[32] = '\0';
-   strcpy(ROM_SETTINGS.MD5, buffer);
+   start_rom_md5();
 
    /* add some useful properties to ROM_PARAMS */
    ROM_PARAMS.systemtype = rom_country_code_to_system_type(ROM_HEADER.destination_code);
@@ -325,7 +496,6 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
    DebugMessage(M64MSG_INFO, "Headername: %s", ROM_PARAMS.headername);
    DebugMessage(M64MSG_INFO, "Name: %s", ROM_HEADER.Name);
    imagestring(imagetype, buffer);
-   DebugMessage(M64MSG_INFO, "MD5: %s", ROM_SETTINGS.MD5);
    DebugMessage(M64MSG_INFO, "CRC: %x %x", sl(ROM_HEADER.CRC1), sl(ROM_HEADER.CRC2));
    DebugMessage(M64MSG_INFO, "Imagetype: %s", buffer);
    DebugMessage(M64MSG_INFO, "Rom size: %d bytes (or %d Mb or %d Megabits)", g_rom_size, g_rom_size/1024/1024, g_rom_size/1024/1024*8);
@@ -349,13 +519,168 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
    return M64ERR_SUCCESS;
 }
 
+m64p_error open_rom(const unsigned char* romimage, unsigned int size)
+{
+   unsigned char imagetype;
+
+   /* check input requirements */
+   if (g_rom != NULL)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom(): previous ROM image was not freed");
+      return M64ERR_INTERNAL;
+   }
+   if (romimage == NULL || !is_valid_rom(romimage))
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom(): not a valid ROM image");
+      return M64ERR_INPUT_INVALID;
+   }
+
+   /* Clear Byte-swapped flag, since ROM is now deleted. */
+   g_MemHasBeenBSwapped = 0;
+   /* allocate new buffer for ROM and copy into this buffer */
+   g_rom_size = size;
+   g_rom = (unsigned char *) malloc(size);
+   if (g_rom == NULL)
+      return M64ERR_NO_MEMORY;
+   memcpy(g_rom, romimage, size);
+   swap_rom(g_rom, &imagetype, g_rom_size);
+
+   return setup_rom(imagetype);
+}
+
+#if defined(HAVE_MMAP) && defined(MSB_FIRST)
+/* Maps the file privately. Only a .z64 image on a big-endian host is
+ * used without byte swapping, anything else would copy every page of
+ * the mapping and is read instead. */
+static unsigned char *map_rom_file(const char *path, size_t *size)
+{
+   struct stat st;
+   void *map;
+   int fd = open(path, O_RDONLY);
+
+   if (fd < 0)
+      return NULL;
+
+   if (fstat(fd, &st) != 0 || st.st_size < 4096 || st.st_size > INT_MAX)
+   {
+      close(fd);
+      return NULL;
+   }
+
+   map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return NULL;
+
+   if (((unsigned char *)map)[0] != 0x80)
+   {
+      munmap(map, (size_t)st.st_size);
+      return NULL;
+   }
+
+   *size = (size_t)st.st_size;
+   return (unsigned char *)map;
+}
+#endif
+
+static unsigned char *read_rom_file(const char *path, size_t *size)
+{
+   unsigned char *data;
+   long length;
+   FILE *f = fopen(path, "rb");
+
+   if (f == NULL)
+      return NULL;
+
+   fseek(f, 0L, SEEK_END);
+   length = ftell(f);
+   fseek(f, 0L, SEEK_SET);
+
+   if (length < 4096 || length > INT_MAX
+         || (data = (unsigned char *) malloc(length)) == NULL)
+   {
+      fclose(f);
+      return NULL;
+   }
+
+   if (fread(data, 1, length, f) != (size_t)length)
+   {
+      free(data);
+      fclose(f);
+      return NULL;
+   }
+
+   fclose(f);
+   *size = (size_t)length;
+   return data;
+}
+
+/* Like open_rom, but loads the image straight from a file so that no
+ * intermediate copy of it is needed. */
+m64p_error open_rom_file(const char *path)
+{
+   unsigned char imagetype;
+   unsigned char *image = NULL;
+   size_t size = 0;
+   struct stat st;
+
+   if (g_rom != NULL)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): previous ROM image was not freed");
+      return M64ERR_INTERNAL;
+   }
+
+   if (stat(path, &st) == 0)
+      g_rom_md5_key = formatstr("%lu %ld %s", (unsigned long)st.st_size, (long)st.st_mtime, path);
+
+#if defined(HAVE_MMAP) && defined(MSB_FIRST)
+   if ((image = map_rom_file(path, &size)) != NULL)
+      g_rom_mapping_size = size;
+   else
+#endif
+   if ((image = read_rom_file(path, &size)) == NULL)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): couldn't read %s", path);
+      free(g_rom_md5_key);
+      g_rom_md5_key = NULL;
+      return M64ERR_FILES;
+   }
+
+   g_rom = image;
+   g_rom_size = (int)size;
+
+   if (!is_valid_rom(g_rom))
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): not a valid ROM image");
+      close_rom();
+      return M64ERR_INPUT_INVALID;
+   }
+
+   /* Clear Byte-swapped flag, since ROM is now deleted. */
+   g_MemHasBeenBSwapped = 0;
+   swap_rom(g_rom, &imagetype, g_rom_size);
+
+   return setup_rom(imagetype);
+}
+
 m64p_error close_rom(void)
 {
    if (g_rom == NULL)
       return M64ERR_INVALID_STATE;
 
+   /* the hash may still be reading the image */
+   rom_md5_wait();
+   free(g_rom_md5_key);
+   g_rom_md5_key = NULL;
+
+#ifdef HAVE_MMAP
+   if (g_rom_mapping_size != 0)
+      munmap(g_rom, g_rom_mapping_size);
+   else
+#endif
    free(g_rom);
    g_rom = NULL;
+   g_rom_mapping_size = 0;
 
    /* Clear Byte-swapped flag, since ROM is now deleted. */
    g_MemHasBeenBSwapped = 0;
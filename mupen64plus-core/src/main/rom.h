@@ -29,6 +29,14 @@
 /* ROM Loading and Saving functions */
 
 m64p_error open_rom(const unsigned char* romimage, unsigned int size);
+m64p_error open_rom_file(const char *path);
+/* Blocks until the MD5 in ROM_SETTINGS is filled in and g_rom is fully
+ * byte-swapped. Must be called before ROM_SETTINGS.MD5 or anything past
+ * the first 4 KiB of g_rom is read. */
+void rom_md5_wait(void);
+/* Byte-swaps g_rom for cartridge reads, leaving out whatever the MD5
+ * thread swaps itself. */
+void swap_loaded_rom(void);
 m64p_error close_rom(void);
 
 extern unsigned char* g_rom;
@@ -32,6 +32,7 @@
 #include "api/config.h"
 
 #include "savestates.h"
+#include "device.h"
 #include "main.h"
 #include "rom.h"
 #include "util.h"
@@ -68,163 +69,272 @@ static const int savestate_latest_version = 0x00010000;  /* 1.0 */
 #define PUTDATA(buff, type, value) \
     do { type x = value; PUTARRAY(&x, buff, type, 1); } while(0)
 
-int savestates_load_m64p(const unsigned char *data, size_t size)
+#define RDRAM_PAGES (RDRAM_MAX_SIZE / SAVESTATE_PAGE_SIZE)
+
+unsigned char savestates_dirty[SAVESTATE_DIRTY_CHIPS
+   + (offsetof(save_memory_data, disk) + SAVESTATE_PAGE_SIZE - 1) / SAVESTATE_PAGE_SIZE];
+int savestates_dirty_unknown;
+
+/* RDRAM pages changed by the last state load */
+static uint32_t loaded_pages[RDRAM_PAGES / 32];
+
+/* Copies an RDRAM page if it differs from the current contents. */
+static void load_rdram_page(size_t page, const uint32_t *src)
 {
-   char queue[1024];
-   int version;
-   int i;
-   uint32_t FCR31;
-   uint32_t* cp0_regs = r4300_cp0_regs();
-   unsigned char *curr = (unsigned char*)data; // < HACK
+   uint32_t *dst = g_dev.rdram + page * (SAVESTATE_PAGE_SIZE / 4);
 
-   /* Read and check Mupen64Plus magic number. */
-   if(strncmp((char *)curr, savestate_magic, 8)!=0)
-      return 0;
+   if (memcmp(dst, src, SAVESTATE_PAGE_SIZE) == 0)
+      return;
 
-   curr += 8;
+   memcpy(dst, src, SAVESTATE_PAGE_SIZE);
+   loaded_pages[page >> 5] |= UINT32_C(1) << (page & 31);
+   savestates_dirty[SAVESTATE_DIRTY_RDRAM + page] = 1;
+}
 
-   version = *curr++;
-   version = (version << 8) | *curr++;
-   version = (version << 8) | *curr++;
-   version = (version << 8) | *curr++;
+/* Invalidates the cached code of the loaded pages, so recompiled blocks
+ * of untouched pages survive the load. */
+static void invalidate_loaded_pages(void)
+{
+   size_t page, run = 0;
 
-   if(version != 0x00010000)
-      return 0;
+   for (page = 0; page <= RDRAM_PAGES; ++page)
+   {
+      if (page < RDRAM_PAGES
+            && (loaded_pages[page >> 5] & (UINT32_C(1) << (page & 31))))
+      {
+         ++run;
+         continue;
+      }
+
+      if (run)
+      {
+         uint32_t start = (uint32_t)((page - run) * SAVESTATE_PAGE_SIZE);
+         size_t length  = run * SAVESTATE_PAGE_SIZE;
+
+         invalidate_r4300_cached_code(0x80000000 + start, length);
+         invalidate_r4300_cached_code(0xa0000000 + start, length);
+         run = 0;
+      }
+   }
+}
 
-   if(memcmp((char *)curr, ROM_SETTINGS.MD5, 32))
+/* Copies only the RDRAM pages that differ from the current contents. */
+static void load_rdram_pages(const uint32_t *src)
+{
+   size_t page;
+
+   memset(loaded_pages, 0, sizeof(loaded_pages));
+
+   for (page = 0; page < RDRAM_PAGES; ++page)
+      load_rdram_page(page, src + page * (SAVESTATE_PAGE_SIZE / 4));
+
+   invalidate_loaded_pages();
+}
+
+/* Returns non-zero if the last state load changed a page of the physical
+ * range [phys, phys + length]. */
+static int loaded_range(uint32_t phys, uint32_t length)
+{
+   size_t page, last;
+
+   if (phys >= RDRAM_MAX_SIZE)
       return 0;
 
-   curr += 32;
+   last = ((size_t)phys + length) / SAVESTATE_PAGE_SIZE;
+   if (last >= RDRAM_MAX_SIZE / SAVESTATE_PAGE_SIZE)
+      last = RDRAM_MAX_SIZE / SAVESTATE_PAGE_SIZE - 1;
 
-   /* Parse savestate */
-   g_ri.rdram.regs[RDRAM_CONFIG_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_DEVICE_ID_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_DELAY_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_MODE_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_REF_INTERVAL_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_REF_ROW_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_RAS_INTERVAL_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_MIN_INTERVAL_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_ADDR_SELECT_REG] = GETDATA(curr, uint32_t);
-   g_ri.rdram.regs[RDRAM_DEVICE_MANUF_REG] = GETDATA(curr, uint32_t);
+   for (page = phys / SAVESTATE_PAGE_SIZE; page <= last; ++page)
+      if (loaded_pages[page >> 5] & (UINT32_C(1) << (page & 31)))
+         return 1;
+
+   return 0;
+}
+
+/* Returns non-zero if a TLB entry maps an RDRAM page changed by the load.
+ * Code of TLB mapped pages is cached by virtual address, so it can't be
+ * invalidated from the physical page alone. */
+static int tlb_maps_loaded_pages(void)
+{
+   int i;
+
+   for (i = 0; i < 32; i++)
+   {
+      if (tlb_e[i].v_even && tlb_e[i].start_even < tlb_e[i].end_even
+            && loaded_range(tlb_e[i].phys_even, tlb_e[i].end_even - tlb_e[i].start_even))
+         return 1;
+      if (tlb_e[i].v_odd && tlb_e[i].start_odd < tlb_e[i].end_odd
+            && loaded_range(tlb_e[i].phys_odd, tlb_e[i].end_odd - tlb_e[i].start_odd))
+         return 1;
+   }
+
+   return 0;
+}
+
+/* Loads a TLB lookup table page by page, returns non-zero if its
+ * contents changed. */
+static int load_tlb_lut(uint32_t *dst, unsigned int area, const uint32_t *src)
+{
+   const size_t page_entries = SAVESTATE_PAGE_SIZE / sizeof(*dst);
+   size_t i;
+   int changed = 0;
+
+   for (i = 0; i < 0x100000; i += page_entries)
+   {
+      if (memcmp(dst + i, src + i, SAVESTATE_PAGE_SIZE) == 0)
+         continue;
+
+      memcpy(dst + i, src + i, SAVESTATE_PAGE_SIZE);
+      savestates_dirty[area + i / page_entries] = 1;
+      changed = 1;
+   }
+
+   if (changed)
+      tlb_cache_flush();
+   return changed;
+}
+
+/* The parts of the m64p savestate around the RDRAM, SP memory, PIF RAM
+ * and TLB lookup tables. Incremental savestates keep them as one small
+ * block and handle the large arrays page by page. */
+static unsigned char *load_device_regs(unsigned char *curr)
+{
+   g_dev.ri.rdram.regs[RDRAM_CONFIG_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_DEVICE_ID_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_DELAY_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_MODE_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_REF_INTERVAL_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_REF_ROW_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_RAS_INTERVAL_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_MIN_INTERVAL_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_ADDR_SELECT_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.rdram.regs[RDRAM_DEVICE_MANUF_REG] = GETDATA(curr, uint32_t);
 
    curr += 4; /* Padding from old implementation */
-   g_r4300.mi.regs[MI_INIT_MODE_REG] = GETDATA(curr, uint32_t);
+   g_dev.r4300.mi.regs[MI_INIT_MODE_REG] = GETDATA(curr, uint32_t);
    curr += 4; // Duplicate MI init mode flags from old implementation
-   g_r4300.mi.regs[MI_VERSION_REG] = GETDATA(curr, uint32_t);
-   g_r4300.mi.regs[MI_INTR_REG] = GETDATA(curr, uint32_t);
-   g_r4300.mi.regs[MI_INTR_MASK_REG] = GETDATA(curr, uint32_t);
+   g_dev.r4300.mi.regs[MI_VERSION_REG] = GETDATA(curr, uint32_t);
+   g_dev.r4300.mi.regs[MI_INTR_REG] = GETDATA(curr, uint32_t);
+   g_dev.r4300.mi.regs[MI_INTR_MASK_REG] = GETDATA(curr, uint32_t);
    curr += 4; /* Padding from old implementation. */
    curr += 8; // Duplicated MI intr flags and padding from old implementation
 
-   g_pi.regs[PI_DRAM_ADDR_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_CART_ADDR_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_RD_LEN_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_WR_LEN_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_STATUS_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM1_LAT_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM1_PWD_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM1_PGS_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM1_RLS_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM2_LAT_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM2_PWD_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM2_PGS_REG] = GETDATA(curr, uint32_t);
-   g_pi.regs[PI_BSD_DOM2_RLS_REG] = GETDATA(curr, uint32_t);
-
-   g_sp.regs[SP_MEM_ADDR_REG] = GETDATA(curr, uint32_t);
-   g_sp.regs[SP_DRAM_ADDR_REG] = GETDATA(curr, uint32_t);
-   g_sp.regs[SP_RD_LEN_REG] = GETDATA(curr, uint32_t);
-   g_sp.regs[SP_WR_LEN_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_DRAM_ADDR_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_CART_ADDR_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_RD_LEN_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_WR_LEN_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_STATUS_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM1_LAT_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM1_PWD_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM1_PGS_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM1_RLS_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM2_LAT_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM2_PWD_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM2_PGS_REG] = GETDATA(curr, uint32_t);
+   g_dev.pi.regs[PI_BSD_DOM2_RLS_REG] = GETDATA(curr, uint32_t);
+
+   g_dev.sp.regs[SP_MEM_ADDR_REG] = GETDATA(curr, uint32_t);
+   g_dev.sp.regs[SP_DRAM_ADDR_REG] = GETDATA(curr, uint32_t);
+   g_dev.sp.regs[SP_RD_LEN_REG] = GETDATA(curr, uint32_t);
+   g_dev.sp.regs[SP_WR_LEN_REG] = GETDATA(curr, uint32_t);
    curr += 4; /* Padding from old implementation. */
-   g_sp.regs[SP_STATUS_REG] = GETDATA(curr, uint32_t);
+   g_dev.sp.regs[SP_STATUS_REG] = GETDATA(curr, uint32_t);
    curr += 16; // Duplicated SP flags and padding from old implementation
-   g_sp.regs[SP_DMA_FULL_REG] = GETDATA(curr, uint32_t);
-   g_sp.regs[SP_DMA_BUSY_REG] = GETDATA(curr, uint32_t);
-   g_sp.regs[SP_SEMAPHORE_REG] = GETDATA(curr, uint32_t);
-
-   g_sp.regs2[SP_PC_REG] = GETDATA(curr, uint32_t);
-   g_sp.regs2[SP_IBIST_REG] = GETDATA(curr, uint32_t);
-
-   g_si.regs[SI_DRAM_ADDR_REG]      = GETDATA(curr, uint32_t);
-   g_si.regs[SI_PIF_ADDR_RD64B_REG] = GETDATA(curr, uint32_t);
-   g_si.regs[SI_PIF_ADDR_WR64B_REG] = GETDATA(curr, uint32_t);
-   g_si.regs[SI_STATUS_REG]         = GETDATA(curr, uint32_t);
-
-   g_vi.regs[VI_STATUS_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_ORIGIN_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_WIDTH_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_V_INTR_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_CURRENT_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_BURST_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_V_SYNC_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_H_SYNC_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_LEAP_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_H_START_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_V_START_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_V_BURST_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_X_SCALE_REG] = GETDATA(curr, uint32_t);
-   g_vi.regs[VI_Y_SCALE_REG] = GETDATA(curr, uint32_t);
-   g_vi.delay = GETDATA(curr, unsigned int);
+   g_dev.sp.regs[SP_DMA_FULL_REG] = GETDATA(curr, uint32_t);
+   g_dev.sp.regs[SP_DMA_BUSY_REG] = GETDATA(curr, uint32_t);
+   g_dev.sp.regs[SP_SEMAPHORE_REG] = GETDATA(curr, uint32_t);
+
+   g_dev.sp.regs2[SP_PC_REG] = GETDATA(curr, uint32_t);
+   g_dev.sp.regs2[SP_IBIST_REG] = GETDATA(curr, uint32_t);
+
+   g_dev.si.regs[SI_DRAM_ADDR_REG]      = GETDATA(curr, uint32_t);
+   g_dev.si.regs[SI_PIF_ADDR_RD64B_REG] = GETDATA(curr, uint32_t);
+   g_dev.si.regs[SI_PIF_ADDR_WR64B_REG] = GETDATA(curr, uint32_t);
+   g_dev.si.regs[SI_STATUS_REG]         = GETDATA(curr, uint32_t);
+
+   g_dev.vi.regs[VI_STATUS_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_ORIGIN_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_WIDTH_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_V_INTR_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_CURRENT_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_BURST_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_V_SYNC_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_H_SYNC_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_LEAP_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_H_START_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_V_START_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_V_BURST_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_X_SCALE_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.regs[VI_Y_SCALE_REG] = GETDATA(curr, uint32_t);
+   g_dev.vi.delay = GETDATA(curr, unsigned int);
 
    gfx.viStatusChanged();
    gfx.viWidthChanged();
 
-   g_ri.regs[RI_MODE_REG]         = GETDATA(curr, uint32_t);
-   g_ri.regs[RI_CONFIG_REG]       = GETDATA(curr, uint32_t);
-   g_ri.regs[RI_CURRENT_LOAD_REG] = GETDATA(curr, uint32_t);
-   g_ri.regs[RI_SELECT_REG]       = GETDATA(curr, uint32_t);
-   g_ri.regs[RI_REFRESH_REG]      = GETDATA(curr, uint32_t);
-   g_ri.regs[RI_LATENCY_REG]      = GETDATA(curr, uint32_t);
-   g_ri.regs[RI_ERROR_REG]        = GETDATA(curr, uint32_t);
-   g_ri.regs[RI_WERROR_REG]       = GETDATA(curr, uint32_t);
-
-   g_ai.regs[AI_DRAM_ADDR_REG] = GETDATA(curr, uint32_t);
-   g_ai.regs[AI_LEN_REG] = GETDATA(curr, uint32_t);
-   g_ai.regs[AI_CONTROL_REG] = GETDATA(curr, uint32_t);
-   g_ai.regs[AI_STATUS_REG] = GETDATA(curr, uint32_t);
-   g_ai.regs[AI_DACRATE_REG] = GETDATA(curr, uint32_t);
-   g_ai.regs[AI_BITRATE_REG] = GETDATA(curr, uint32_t);
-   g_ai.fifo[1].duration     = GETDATA(curr, unsigned int);
-   g_ai.fifo[1].length       = GETDATA(curr, uint32_t);
-   g_ai.fifo[0].duration     = GETDATA(curr, unsigned int);
-   g_ai.fifo[0].length       = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_MODE_REG]         = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_CONFIG_REG]       = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_CURRENT_LOAD_REG] = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_SELECT_REG]       = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_REFRESH_REG]      = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_LATENCY_REG]      = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_ERROR_REG]        = GETDATA(curr, uint32_t);
+   g_dev.ri.regs[RI_WERROR_REG]       = GETDATA(curr, uint32_t);
+
+   g_dev.ai.regs[AI_DRAM_ADDR_REG] = GETDATA(curr, uint32_t);
+   g_dev.ai.regs[AI_LEN_REG] = GETDATA(curr, uint32_t);
+   g_dev.ai.regs[AI_CONTROL_REG] = GETDATA(curr, uint32_t);
+   g_dev.ai.regs[AI_STATUS_REG] = GETDATA(curr, uint32_t);
+   g_dev.ai.regs[AI_DACRATE_REG] = GETDATA(curr, uint32_t);
+   g_dev.ai.regs[AI_BITRATE_REG] = GETDATA(curr, uint32_t);
+   g_dev.ai.fifo[1].duration     = GETDATA(curr, unsigned int);
+   g_dev.ai.fifo[1].length       = GETDATA(curr, uint32_t);
+   g_dev.ai.fifo[0].duration     = GETDATA(curr, unsigned int);
+   g_dev.ai.fifo[0].length       = GETDATA(curr, uint32_t);
 
    /* best effort initialization of fifo addresses...
     * You might get a small sound "pop" because address might be wrong.
     * Proper initialization requires changes to savestate format
     */
-   g_ai.fifo[0].address = g_ai.regs[AI_DRAM_ADDR_REG];
-   g_ai.fifo[1].address = g_ai.regs[AI_DRAM_ADDR_REG];
-   g_ai.samples_format_changed = 1;
+   g_dev.ai.fifo[0].address = g_dev.ai.regs[AI_DRAM_ADDR_REG];
+   g_dev.ai.fifo[1].address = g_dev.ai.regs[AI_DRAM_ADDR_REG];
+   g_dev.ai.samples_format_changed = 1;
 
-   g_dp.dpc_regs[DPC_START_REG] = GETDATA(curr, uint32_t);
-   g_dp.dpc_regs[DPC_END_REG]   = GETDATA(curr, uint32_t);
-   g_dp.dpc_regs[DPC_CURRENT_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_START_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_END_REG]   = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_CURRENT_REG] = GETDATA(curr, uint32_t);
    curr += 4; /* Padding from old implementation. */
-   g_dp.dpc_regs[DPC_STATUS_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_STATUS_REG] = GETDATA(curr, uint32_t);
    curr += 12; // Duplicated DPC flags and padding from old implementation
-   g_dp.dpc_regs[DPC_CLOCK_REG] = GETDATA(curr, uint32_t);
-   g_dp.dpc_regs[DPC_BUFBUSY_REG] = GETDATA(curr, uint32_t);
-   g_dp.dpc_regs[DPC_PIPEBUSY_REG] = GETDATA(curr, uint32_t);
-   g_dp.dpc_regs[DPC_TMEM_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_CLOCK_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_BUFBUSY_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_PIPEBUSY_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dpc_regs[DPC_TMEM_REG] = GETDATA(curr, uint32_t);
 
-   g_dp.dps_regs[DPS_TBIST_REG] = GETDATA(curr, uint32_t);
-   g_dp.dps_regs[DPS_TEST_MODE_REG] = GETDATA(curr, uint32_t);
-   g_dp.dps_regs[DPS_BUFTEST_ADDR_REG] = GETDATA(curr, uint32_t);
-   g_dp.dps_regs[DPS_BUFTEST_DATA_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dps_regs[DPS_TBIST_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dps_regs[DPS_TEST_MODE_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dps_regs[DPS_BUFTEST_ADDR_REG] = GETDATA(curr, uint32_t);
+   g_dev.dp.dps_regs[DPS_BUFTEST_DATA_REG] = GETDATA(curr, uint32_t);
 
-   COPYARRAY(g_rdram, curr, uint32_t, RDRAM_MAX_SIZE/4);
-   COPYARRAY(g_sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
-   COPYARRAY(g_si.pif.ram, curr, uint8_t, PIF_RAM_SIZE);
+   return curr;
+}
+
+static unsigned char *load_flashram_state(unsigned char *curr)
+{
+   g_dev.pi.use_flashram = GETDATA(curr, int);
+   g_dev.pi.flashram.mode = GETDATA(curr, int);
+   g_dev.pi.flashram.status = GETDATA(curr, unsigned long long);
+   g_dev.pi.flashram.erase_offset = GETDATA(curr, unsigned int);
+   g_dev.pi.flashram.write_pointer = GETDATA(curr, unsigned int);
 
-   g_pi.use_flashram = GETDATA(curr, int);
-   g_pi.flashram.mode = GETDATA(curr, int);
-   g_pi.flashram.status = GETDATA(curr, unsigned long long);
-   g_pi.flashram.erase_offset = GETDATA(curr, unsigned int);
-   g_pi.flashram.write_pointer = GETDATA(curr, unsigned int);
+   return curr;
+}
 
-   COPYARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
-   COPYARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+static void load_cpu_state(unsigned char *curr, int tlb_changed)
+{
+   char queue[1024];
+   int i;
+   uint32_t FCR31;
+   uint32_t* cp0_regs = r4300_cp0_regs();
 
    *r4300_llbit() = GETDATA(curr, unsigned int);
    COPYARRAY(r4300_regs(), curr, int64_t, 32);
@@ -273,201 +383,235 @@ int savestates_load_m64p(const unsigned char *data, size_t size)
       tlb_e[i].phys_odd   = GETDATA(curr, unsigned int);
    }
 
-   savestates_load_set_pc(GETDATA(curr, uint32_t));
+   /* Code reached through a changed TLB mapping, or through a mapping of
+    * a changed page, can't be tracked by physical page, so fall back to
+    * dropping all of it. */
+   savestates_load_set_pc(GETDATA(curr, uint32_t),
+         tlb_changed || tlb_maps_loaded_pages());
 
    *r4300_next_interrupt() = GETDATA(curr, unsigned int);
-   g_vi.next_vi  = GETDATA(curr, unsigned int);
-   g_vi.field    = GETDATA(curr, unsigned int);
+   g_dev.vi.next_vi  = GETDATA(curr, unsigned int);
+   g_dev.vi.field    = GETDATA(curr, unsigned int);
 
    memcpy(queue, curr, sizeof(queue));
    to_little_endian_buffer(queue, 4, 256);
    load_eventqueue_infos(queue);
 
    *r4300_last_addr() = *r4300_pc();
-
-   /* deliver callback to indicate 
-    * completion of state loading operation */
-   StateChanged(M64CORE_STATE_LOADCOMPLETE, 1);
-
-   return 1;
 }
 
-int savestates_save_m64p(unsigned char *data, size_t size)
+int savestates_load_m64p(const unsigned char *data, size_t size)
 {
-   unsigned char outbuf[4];
-   int i, queuelength;
-   char queue[1024];
-   uint32_t* cp0_regs = r4300_cp0_regs();
-   unsigned char *curr = (unsigned char*)data;
+   int version;
+   int tlb_changed;
+   unsigned char *curr = (unsigned char*)data; // < HACK
 
-   if (!curr)
+   /* Read and check Mupen64Plus magic number. */
+   if(strncmp((char *)curr, savestate_magic, 8)!=0)
       return 0;
 
-   queuelength = save_eventqueue_infos(queue);
+   curr += 8;
 
-   // Write the save state data to memory
-   PUTARRAY(savestate_magic, curr, unsigned char, 8);
+   version = *curr++;
+   version = (version << 8) | *curr++;
+   version = (version << 8) | *curr++;
+   version = (version << 8) | *curr++;
 
-   outbuf[0] = (savestate_latest_version >> 24) & 0xff;
-   outbuf[1] = (savestate_latest_version >> 16) & 0xff;
-   outbuf[2] = (savestate_latest_version >>  8) & 0xff;
-   outbuf[3] = (savestate_latest_version >>  0) & 0xff;
-   PUTARRAY(outbuf, curr, unsigned char, 4);
+   if(version != 0x00010000)
+      return 0;
 
-   PUTARRAY(ROM_SETTINGS.MD5, curr, char, 32);
+   rom_md5_wait();
+   if(memcmp((char *)curr, ROM_SETTINGS.MD5, 32))
+      return 0;
+
+   curr += 32;
+
+   /* Parse savestate */
+   curr = load_device_regs(curr);
+
+   load_rdram_pages(GETARRAY(curr, uint32_t, RDRAM_MAX_SIZE/4));
+   COPYARRAY(g_dev.sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
+   COPYARRAY(g_dev.si.pif.ram, curr, uint8_t, PIF_RAM_SIZE);
+   savestates_mark_dirty(SAVESTATE_DIRTY_SP_MEM, 0, SP_MEM_SIZE);
+   savestates_mark_dirty(SAVESTATE_DIRTY_PIF_RAM, 0, PIF_RAM_SIZE);
+
+   curr = load_flashram_state(curr);
+
+   tlb_changed  = load_tlb_lut(tlb_LUT_r, SAVESTATE_DIRTY_TLB_LUT_R, GETARRAY(curr, uint32_t, 0x100000));
+   tlb_changed |= load_tlb_lut(tlb_LUT_w, SAVESTATE_DIRTY_TLB_LUT_W, GETARRAY(curr, uint32_t, 0x100000));
+
+   load_cpu_state(curr, tlb_changed);
+
+   /* deliver callback to indicate 
+    * completion of state loading operation */
+   StateChanged(M64CORE_STATE_LOADCOMPLETE, 1);
 
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_CONFIG_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_DEVICE_ID_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_DELAY_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_MODE_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_REF_INTERVAL_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_REF_ROW_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_RAS_INTERVAL_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_MIN_INTERVAL_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_ADDR_SELECT_REG]);
-   PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_DEVICE_MANUF_REG]);
+   return 1;
+}
+
+static unsigned char *save_device_regs(unsigned char *curr)
+{
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_CONFIG_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_DEVICE_ID_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_DELAY_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_MODE_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_REF_INTERVAL_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_REF_ROW_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_RAS_INTERVAL_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_MIN_INTERVAL_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_ADDR_SELECT_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.rdram.regs[RDRAM_DEVICE_MANUF_REG]);
 
    PUTDATA(curr, uint32_t, 0);
-   PUTDATA(curr, uint32_t, g_r4300.mi.regs[MI_INIT_MODE_REG]);
-   PUTDATA(curr, uint8_t, g_r4300.mi.regs[MI_INIT_MODE_REG] & 0x7F);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INIT_MODE_REG] & 0x80) != 0);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INIT_MODE_REG] & 0x100) != 0);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INIT_MODE_REG] & 0x200) != 0);
-   PUTDATA(curr, uint32_t, g_r4300.mi.regs[MI_VERSION_REG]);
-   PUTDATA(curr, uint32_t, g_r4300.mi.regs[MI_INTR_REG]);
-   PUTDATA(curr, uint32_t, g_r4300.mi.regs[MI_INTR_MASK_REG]);
+   PUTDATA(curr, uint32_t, g_dev.r4300.mi.regs[MI_INIT_MODE_REG]);
+   PUTDATA(curr, uint8_t, g_dev.r4300.mi.regs[MI_INIT_MODE_REG] & 0x7F);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INIT_MODE_REG] & 0x80) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INIT_MODE_REG] & 0x100) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INIT_MODE_REG] & 0x200) != 0);
+   PUTDATA(curr, uint32_t, g_dev.r4300.mi.regs[MI_VERSION_REG]);
+   PUTDATA(curr, uint32_t, g_dev.r4300.mi.regs[MI_INTR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.r4300.mi.regs[MI_INTR_MASK_REG]);
    PUTDATA(curr, uint32_t, 0); /* Padding from old implementation */
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INTR_MASK_REG] & 0x1) != 0);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INTR_MASK_REG] & 0x2) != 0);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INTR_MASK_REG] & 0x4) != 0);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INTR_MASK_REG] & 0x8) != 0);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INTR_MASK_REG] & 0x10) != 0);
-   PUTDATA(curr, uint8_t, (g_r4300.mi.regs[MI_INTR_MASK_REG] & 0x20) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INTR_MASK_REG] & 0x1) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INTR_MASK_REG] & 0x2) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INTR_MASK_REG] & 0x4) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INTR_MASK_REG] & 0x8) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INTR_MASK_REG] & 0x10) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.r4300.mi.regs[MI_INTR_MASK_REG] & 0x20) != 0);
    PUTDATA(curr, uint16_t, 0); // Padding from old implementation
 
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_DRAM_ADDR_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_CART_ADDR_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_RD_LEN_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_WR_LEN_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_STATUS_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_LAT_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_PWD_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_PGS_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_RLS_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_LAT_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_PWD_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_PGS_REG]);
-   PUTDATA(curr, uint32_t, g_pi.regs[PI_BSD_DOM1_RLS_REG]);
-
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_MEM_ADDR_REG]);
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_DRAM_ADDR_REG]);
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_RD_LEN_REG]);
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_WR_LEN_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_DRAM_ADDR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_CART_ADDR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_RD_LEN_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_WR_LEN_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_STATUS_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_LAT_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_PWD_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_PGS_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_RLS_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_LAT_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_PWD_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_PGS_REG]);
+   PUTDATA(curr, uint32_t, g_dev.pi.regs[PI_BSD_DOM1_RLS_REG]);
+
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_MEM_ADDR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_DRAM_ADDR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_RD_LEN_REG]);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_WR_LEN_REG]);
    PUTDATA(curr, uint32_t, 0); /* Padding from old implementation */
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_STATUS_REG]);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x1) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x2) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x4) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x8) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x10) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x20) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x40) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x80) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x100) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x200) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x400) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x800) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x1000) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x2000) != 0);
-   PUTDATA(curr, uint8_t, (g_sp.regs[SP_STATUS_REG] & 0x4000) != 0);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_STATUS_REG]);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x1) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x2) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x4) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x8) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x10) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x20) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x40) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x80) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x100) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x200) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x400) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x800) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x1000) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x2000) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.sp.regs[SP_STATUS_REG] & 0x4000) != 0);
    PUTDATA(curr, uint8_t, 0);
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_DMA_FULL_REG]);
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_DMA_BUSY_REG]);
-   PUTDATA(curr, uint32_t, g_sp.regs[SP_SEMAPHORE_REG]);
-
-   PUTDATA(curr, uint32_t, g_sp.regs2[SP_PC_REG]);
-   PUTDATA(curr, uint32_t, g_sp.regs2[SP_IBIST_REG]);
-
-   PUTDATA(curr, uint32_t, g_si.regs[SI_DRAM_ADDR_REG]);
-   PUTDATA(curr, uint32_t, g_si.regs[SI_PIF_ADDR_RD64B_REG]);
-   PUTDATA(curr, uint32_t, g_si.regs[SI_PIF_ADDR_WR64B_REG]);
-   PUTDATA(curr, uint32_t, g_si.regs[SI_STATUS_REG]);
-
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_STATUS_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_ORIGIN_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_WIDTH_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_V_INTR_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_CURRENT_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_BURST_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_V_SYNC_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_H_SYNC_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_LEAP_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_H_START_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_V_START_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_V_BURST_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_X_SCALE_REG]);
-   PUTDATA(curr, uint32_t, g_vi.regs[VI_Y_SCALE_REG]);
-   PUTDATA(curr, unsigned int, g_vi.delay);
-
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_MODE_REG]);
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_CONFIG_REG]);
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_CURRENT_LOAD_REG]);
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_SELECT_REG]);
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_REFRESH_REG]);
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_LATENCY_REG]);
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_ERROR_REG]);
-   PUTDATA(curr, uint32_t, g_ri.regs[RI_WERROR_REG]);
-
-   PUTDATA(curr, uint32_t, g_ai.regs[AI_DRAM_ADDR_REG]);
-   PUTDATA(curr, uint32_t, g_ai.regs[AI_LEN_REG]);
-   PUTDATA(curr, uint32_t, g_ai.regs[AI_CONTROL_REG]);
-   PUTDATA(curr, uint32_t, g_ai.regs[AI_STATUS_REG]);
-   PUTDATA(curr, uint32_t, g_ai.regs[AI_DACRATE_REG]);
-   PUTDATA(curr, uint32_t, g_ai.regs[AI_BITRATE_REG]);
-   PUTDATA(curr, unsigned int, g_ai.fifo[1].duration);
-   PUTDATA(curr, uint32_t, g_ai.fifo[1].length);
-   PUTDATA(curr, unsigned int, g_ai.fifo[0].duration);
-   PUTDATA(curr, uint32_t, g_ai.fifo[0].length);
-
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_START_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_END_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_CURRENT_REG]);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_DMA_FULL_REG]);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_DMA_BUSY_REG]);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs[SP_SEMAPHORE_REG]);
+
+   PUTDATA(curr, uint32_t, g_dev.sp.regs2[SP_PC_REG]);
+   PUTDATA(curr, uint32_t, g_dev.sp.regs2[SP_IBIST_REG]);
+
+   PUTDATA(curr, uint32_t, g_dev.si.regs[SI_DRAM_ADDR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.si.regs[SI_PIF_ADDR_RD64B_REG]);
+   PUTDATA(curr, uint32_t, g_dev.si.regs[SI_PIF_ADDR_WR64B_REG]);
+   PUTDATA(curr, uint32_t, g_dev.si.regs[SI_STATUS_REG]);
+
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_STATUS_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_ORIGIN_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_WIDTH_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_V_INTR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_CURRENT_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_BURST_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_V_SYNC_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_H_SYNC_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_LEAP_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_H_START_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_V_START_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_V_BURST_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_X_SCALE_REG]);
+   PUTDATA(curr, uint32_t, g_dev.vi.regs[VI_Y_SCALE_REG]);
+   PUTDATA(curr, unsigned int, g_dev.vi.delay);
+
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_MODE_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_CONFIG_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_CURRENT_LOAD_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_SELECT_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_REFRESH_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_LATENCY_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_ERROR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ri.regs[RI_WERROR_REG]);
+
+   PUTDATA(curr, uint32_t, g_dev.ai.regs[AI_DRAM_ADDR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ai.regs[AI_LEN_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ai.regs[AI_CONTROL_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ai.regs[AI_STATUS_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ai.regs[AI_DACRATE_REG]);
+   PUTDATA(curr, uint32_t, g_dev.ai.regs[AI_BITRATE_REG]);
+   PUTDATA(curr, unsigned int, g_dev.ai.fifo[1].duration);
+   PUTDATA(curr, uint32_t, g_dev.ai.fifo[1].length);
+   PUTDATA(curr, unsigned int, g_dev.ai.fifo[0].duration);
+   PUTDATA(curr, uint32_t, g_dev.ai.fifo[0].length);
+
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_START_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_END_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_CURRENT_REG]);
    PUTDATA(curr, uint32_t, 0); /* Padding from oold implementation */
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_STATUS_REG]);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x1) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x2) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x4) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x8) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x10) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x20) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x40) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x80) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x100) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x200) != 0);
-   PUTDATA(curr, uint8_t, (g_dp.dpc_regs[DPC_STATUS_REG] & 0x400) != 0);
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_STATUS_REG]);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x1) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x2) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x4) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x8) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x10) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x20) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x40) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x80) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x100) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x200) != 0);
+   PUTDATA(curr, uint8_t, (g_dev.dp.dpc_regs[DPC_STATUS_REG] & 0x400) != 0);
    PUTDATA(curr, uint8_t, 0);
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_CLOCK_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_BUFBUSY_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_PIPEBUSY_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dpc_regs[DPC_TMEM_REG]);
-
-   PUTDATA(curr, uint32_t, g_dp.dps_regs[DPS_TBIST_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dps_regs[DPS_TEST_MODE_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dps_regs[DPS_BUFTEST_ADDR_REG]);
-   PUTDATA(curr, uint32_t, g_dp.dps_regs[DPS_BUFTEST_DATA_REG]);
-
-   PUTARRAY(g_rdram, curr, uint32_t, RDRAM_MAX_SIZE/4);
-   PUTARRAY(g_sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
-   PUTARRAY(g_si.pif.ram, curr, uint8_t, PIF_RAM_SIZE);
-
-   PUTDATA(curr, int, g_pi.use_flashram);
-   PUTDATA(curr, int, g_pi.flashram.mode);
-   PUTDATA(curr, unsigned long long, g_pi.flashram.status);
-   PUTDATA(curr, unsigned int, g_pi.flashram.erase_offset);
-   PUTDATA(curr, unsigned int, g_pi.flashram.write_pointer);
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_CLOCK_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_BUFBUSY_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_PIPEBUSY_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dpc_regs[DPC_TMEM_REG]);
 
-   PUTARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
-   PUTARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+   PUTDATA(curr, uint32_t, g_dev.dp.dps_regs[DPS_TBIST_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dps_regs[DPS_TEST_MODE_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dps_regs[DPS_BUFTEST_ADDR_REG]);
+   PUTDATA(curr, uint32_t, g_dev.dp.dps_regs[DPS_BUFTEST_DATA_REG]);
+
+   return curr;
+}
+
+static unsigned char *save_flashram_state(unsigned char *curr)
+{
+   PUTDATA(curr, int, g_dev.pi.use_flashram);
+   PUTDATA(curr, int, g_dev.pi.flashram.mode);
+   PUTDATA(curr, unsigned long long, g_dev.pi.flashram.status);
+   PUTDATA(curr, unsigned int, g_dev.pi.flashram.erase_offset);
+   PUTDATA(curr, unsigned int, g_dev.pi.flashram.write_pointer);
+
+   return curr;
+}
+
+static unsigned char *save_cpu_state(unsigned char *curr)
+{
+   int i, queuelength;
+   char queue[1024];
+   uint32_t* cp0_regs = r4300_cp0_regs();
+
+   queuelength = save_eventqueue_infos(queue);
 
    PUTDATA(curr, unsigned int, *r4300_llbit());
    PUTARRAY(r4300_regs(), curr, int64_t, 32);
@@ -513,15 +657,353 @@ int savestates_save_m64p(unsigned char *data, size_t size)
    PUTDATA(curr, uint32_t, *r4300_pc());
 
    PUTDATA(curr, unsigned int, *r4300_next_interrupt());
-   PUTDATA(curr, unsigned int, g_vi.next_vi);
-   PUTDATA(curr, unsigned int, g_vi.field);
+   PUTDATA(curr, unsigned int, g_dev.vi.next_vi);
+   PUTDATA(curr, unsigned int, g_dev.vi.field);
 
    to_little_endian_buffer(queue, 4, queuelength/4);
    PUTARRAY(queue, curr, char, queuelength);
 
+   return curr;
+}
+
+int savestates_save_m64p(unsigned char *data, size_t size)
+{
+   unsigned char outbuf[4];
+   unsigned char *curr = (unsigned char*)data;
+
+   if (!curr)
+      return 0;
+
+   // Write the save state data to memory
+   PUTARRAY(savestate_magic, curr, unsigned char, 8);
+
+   outbuf[0] = (savestate_latest_version >> 24) & 0xff;
+   outbuf[1] = (savestate_latest_version >> 16) & 0xff;
+   outbuf[2] = (savestate_latest_version >>  8) & 0xff;
+   outbuf[3] = (savestate_latest_version >>  0) & 0xff;
+   PUTARRAY(outbuf, curr, unsigned char, 4);
+
+   rom_md5_wait();
+   PUTARRAY(ROM_SETTINGS.MD5, curr, char, 32);
+
+   curr = save_device_regs(curr);
+
+   PUTARRAY(g_dev.rdram, curr, uint32_t, RDRAM_MAX_SIZE/4);
+   PUTARRAY(g_dev.sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
+   PUTARRAY(g_dev.si.pif.ram, curr, uint8_t, PIF_RAM_SIZE);
+
+   curr = save_flashram_state(curr);
+
+   PUTARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
+   PUTARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+
+   curr = save_cpu_state(curr);
+
    /* Deliver callback to indicate completion 
     * of state saving operation */
    StateChanged(M64CORE_STATE_SAVECOMPLETE, 1);
 
    return 1;
 }
+
+/* Incremental savestates
+ *
+ * The state image is the RDRAM, the TLB lookup tables, the SP memory, the
+ * PIF RAM and the save chips, each starting on a page at the position
+ * savestates_dirty gives it, followed by the remaining registers.
+ * A copy of the last saved/loaded image is kept, and deltas only carry
+ * the SAVESTATE_PAGE_SIZE pages that differ from it, stored as
+ * old ^ new. Applying a delta is therefore its own inverse: it moves
+ * the image forward after a save and back again on load.
+ *
+ * Only pages marked dirty since the last delta are compared; the
+ * registers are small enough to be serialized every time. RDRAM written
+ * by plugins isn't marked, savestates_dirty_unknown makes the next delta
+ * compare all of it instead. */
+
+static const char* delta_magic = "M64+DLTA";
+
+#define SAVESTATE_CHIPS_SIZE offsetof(save_memory_data, disk)
+#define DELTA_DIRTY_PAGES    (sizeof(savestates_dirty))
+
+/* registers and flashram state, bounded by what the full state leaves
+ * once the arrays are taken out */
+#define DELTA_REGS_SIZE \
+   (SAVESTATE_SIZE - RDRAM_MAX_SIZE - 2 * 0x100000 * 4 - SP_MEM_SIZE - PIF_RAM_SIZE)
+#define DELTA_REGS_PAGE      DELTA_DIRTY_PAGES
+#define DELTA_IMAGE_PAGES \
+   (DELTA_REGS_PAGE + (DELTA_REGS_SIZE + SAVESTATE_PAGE_SIZE - 1) / SAVESTATE_PAGE_SIZE)
+
+static const struct delta_area
+{
+   unsigned int first;
+   size_t size;
+   void *data;
+} delta_areas[] =
+{
+   { SAVESTATE_DIRTY_RDRAM,     RDRAM_MAX_SIZE,       g_dev.rdram },
+   { SAVESTATE_DIRTY_TLB_LUT_R, 0x100000 * 4,         tlb_LUT_r },
+   { SAVESTATE_DIRTY_TLB_LUT_W, 0x100000 * 4,         tlb_LUT_w },
+   { SAVESTATE_DIRTY_SP_MEM,    SP_MEM_SIZE,          g_dev.sp.mem },
+   { SAVESTATE_DIRTY_PIF_RAM,   PIF_RAM_SIZE,         g_dev.si.pif.ram },
+   { SAVESTATE_DIRTY_CHIPS,     SAVESTATE_CHIPS_SIZE, &saved_memory }
+};
+
+#define DELTA_AREAS (sizeof(delta_areas) / sizeof(delta_areas[0]))
+
+static unsigned char *delta_image = NULL;
+static unsigned char *delta_regs = NULL;
+/* pages of the image changed by the delta being loaded */
+static unsigned char *delta_loaded = NULL;
+
+static int delta_alloc(void)
+{
+   if (delta_image)
+      return 1;
+
+   delta_image  = (unsigned char*)calloc(DELTA_IMAGE_PAGES, SAVESTATE_PAGE_SIZE);
+   delta_regs   = (unsigned char*)calloc(1, DELTA_REGS_SIZE);
+   delta_loaded = (unsigned char*)calloc(1, DELTA_IMAGE_PAGES);
+
+   if (!delta_image || !delta_regs || !delta_loaded)
+   {
+      DebugMessage(M64MSG_ERROR, "Failed to allocate incremental savestate buffers");
+      savestates_delta_reset();
+      return 0;
+   }
+
+   /* the image starts out empty, the first delta compares everything */
+   memset(savestates_dirty, 1, DELTA_DIRTY_PAGES);
+   return 1;
+}
+
+static size_t delta_page_length(size_t size, size_t page)
+{
+   size_t offset = page * SAVESTATE_PAGE_SIZE;
+
+   return (size - offset < SAVESTATE_PAGE_SIZE) ? size - offset : SAVESTATE_PAGE_SIZE;
+}
+
+static size_t delta_area_pages(const struct delta_area *area)
+{
+   return (area->size + SAVESTATE_PAGE_SIZE - 1) / SAVESTATE_PAGE_SIZE;
+}
+
+/* Returns non-zero if a page has to be compared with the image. */
+static int delta_page_dirty(const struct delta_area *area, size_t page)
+{
+   if (savestates_dirty[area->first + page])
+      return 1;
+
+   return savestates_dirty_unknown && area->first == SAVESTATE_DIRTY_RDRAM
+      && page < g_dev.ri.rdram.dram_size / SAVESTATE_PAGE_SIZE;
+}
+
+static unsigned char *delta_put_page(unsigned char *curr, uint32_t *pages,
+      size_t page, const unsigned char *src, size_t len)
+{
+   unsigned char *old = delta_image + page * SAVESTATE_PAGE_SIZE;
+   size_t i;
+
+   if (memcmp(old, src, len) == 0)
+      return curr;
+
+   PUTDATA(curr, uint32_t, (uint32_t)page);
+   for (i = 0; i < len; ++i)
+      curr[i] = old[i] ^ src[i];
+   curr += len;
+
+   memcpy(old, src, len);
+   ++*pages;
+   return curr;
+}
+
+static unsigned char *save_delta_regs(unsigned char *curr)
+{
+   curr = save_device_regs(curr);
+   curr = save_flashram_state(curr);
+   return save_cpu_state(curr);
+}
+
+static void load_delta_regs(unsigned char *curr, int tlb_changed)
+{
+   curr = load_device_regs(curr);
+   curr = load_flashram_state(curr);
+   load_cpu_state(curr, tlb_changed);
+}
+
+size_t savestates_delta_size_max(void)
+{
+   return 8 + 4 + DELTA_IMAGE_PAGES * (4 + SAVESTATE_PAGE_SIZE);
+}
+
+void savestates_delta_reset(void)
+{
+   free(delta_image);
+   free(delta_regs);
+   free(delta_loaded);
+   delta_image  = NULL;
+   delta_regs   = NULL;
+   delta_loaded = NULL;
+}
+
+int savestates_save_delta(unsigned char *data, size_t size, size_t *written)
+{
+   size_t a, page;
+   uint32_t pages = 0;
+   unsigned char *curr = data + 12;
+
+   if (!data || size < savestates_delta_size_max() || !delta_alloc())
+      return 0;
+
+#ifdef NEW_DYNAREC
+   /* new_dynarec stores to RDRAM without marking pages */
+   if (r4300emu == CORE_DYNAREC)
+      savestates_dirty_unknown = 1;
+#endif
+
+   for (a = 0; a < DELTA_AREAS; ++a)
+   {
+      const struct delta_area *area = &delta_areas[a];
+
+      for (page = 0; page < delta_area_pages(area); ++page)
+      {
+         if (!delta_page_dirty(area, page))
+            continue;
+
+         curr = delta_put_page(curr, &pages, area->first + page,
+               (const unsigned char*)area->data + page * SAVESTATE_PAGE_SIZE,
+               delta_page_length(area->size, page));
+      }
+   }
+
+   memset(delta_regs, 0, DELTA_REGS_SIZE);
+   save_delta_regs(delta_regs);
+   for (page = 0; page < DELTA_IMAGE_PAGES - DELTA_REGS_PAGE; ++page)
+      curr = delta_put_page(curr, &pages, DELTA_REGS_PAGE + page,
+            delta_regs + page * SAVESTATE_PAGE_SIZE,
+            delta_page_length(DELTA_REGS_SIZE, page));
+
+   memset(savestates_dirty, 0, DELTA_DIRTY_PAGES);
+   savestates_dirty_unknown = 0;
+
+   if (written)
+      *written = (size_t)(curr - data);
+
+   memcpy(data, delta_magic, 8);
+   curr = data + 8;
+   PUTDATA(curr, uint32_t, pages);
+
+   return 1;
+}
+
+/* Brings an area back to the image: the pages the delta changed, and
+ * those written since the image was last in sync. */
+static int load_delta_area(const struct delta_area *area)
+{
+   size_t page;
+   int changed = 0;
+
+   for (page = 0; page < delta_area_pages(area); ++page)
+   {
+      const unsigned char *src = delta_image + (area->first + page) * SAVESTATE_PAGE_SIZE;
+      unsigned char *dst = (unsigned char*)area->data + page * SAVESTATE_PAGE_SIZE;
+      size_t len = delta_page_length(area->size, page);
+
+      if (!delta_loaded[area->first + page] && !delta_page_dirty(area, page))
+         continue;
+
+      if (area->first == SAVESTATE_DIRTY_RDRAM)
+      {
+         load_rdram_page(page, (const uint32_t*)src);
+         continue;
+      }
+
+      if (memcmp(dst, src, len) == 0)
+         continue;
+
+      memcpy(dst, src, len);
+      changed = 1;
+   }
+
+   return changed;
+}
+
+int savestates_load_delta(const unsigned char *data, size_t size)
+{
+   size_t a, i, len;
+   uint32_t page, pages;
+   int tlb_changed = 0;
+   unsigned char *curr = (unsigned char*)data; // < HACK
+   const unsigned char *end = data + size;
+
+   if (!data || size < 12 || memcmp(data, delta_magic, 8) != 0)
+   {
+      DebugMessage(M64MSG_ERROR, "Invalid incremental savestate");
+      return 0;
+   }
+   if (!delta_image)
+   {
+      DebugMessage(M64MSG_ERROR, "Incremental savestate loaded without a base state");
+      return 0;
+   }
+
+   curr += 8;
+   pages = GETDATA(curr, uint32_t);
+
+   memset(delta_loaded, 0, DELTA_IMAGE_PAGES);
+
+   while (pages--)
+   {
+      unsigned char *dst;
+
+      if (end - curr < 4)
+         goto corrupt;
+      page = GETDATA(curr, uint32_t);
+      if (page >= DELTA_IMAGE_PAGES)
+         goto corrupt;
+
+      len = (page >= DELTA_REGS_PAGE)
+         ? delta_page_length(DELTA_REGS_SIZE, page - DELTA_REGS_PAGE)
+         : SAVESTATE_PAGE_SIZE;
+      if ((size_t)(end - curr) < len)
+         goto corrupt;
+
+      dst = delta_image + page * SAVESTATE_PAGE_SIZE;
+      for (i = 0; i < len; ++i)
+         dst[i] ^= curr[i];
+      curr += len;
+      delta_loaded[page] = 1;
+   }
+
+   memset(loaded_pages, 0, sizeof(loaded_pages));
+
+   for (a = 0; a < DELTA_AREAS; ++a)
+   {
+      int changed = load_delta_area(&delta_areas[a]);
+
+      if (changed && (delta_areas[a].first == SAVESTATE_DIRTY_TLB_LUT_R
+               || delta_areas[a].first == SAVESTATE_DIRTY_TLB_LUT_W))
+         tlb_changed = 1;
+   }
+
+   if (tlb_changed)
+      tlb_cache_flush();
+   invalidate_loaded_pages();
+
+   load_delta_regs(delta_image + DELTA_REGS_PAGE * SAVESTATE_PAGE_SIZE, tlb_changed);
+
+   memset(savestates_dirty, 0, DELTA_DIRTY_PAGES);
+   savestates_dirty_unknown = 0;
+
+   StateChanged(M64CORE_STATE_LOADCOMPLETE, 1);
+
+   return 1;
+
+corrupt:
+   /* Some pages may already have been applied; the image no longer
+    * matches any known state. */
+   DebugMessage(M64MSG_ERROR, "Corrupt incremental savestate");
+   savestates_delta_reset();
+   return 0;
+}
@@ -25,6 +25,47 @@
 #ifndef __SAVESTAVES_H__
 #define __SAVESTAVES_H__
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <retro_inline.h>
+
+#include "main.h"
+
+/* Size of a full m64p savestate, including the event queue. */
+#define SAVESTATE_SIZE (16788288 + 1024)
+
+/* Granularity of incremental savestates. */
+#define SAVESTATE_PAGE_SIZE 4096
+
+/* Writes to the bulk of the state are tracked per page for incremental
+ * savestates, one byte per page like invalid_code. These are the first
+ * pages of each tracked area in savestates_dirty. */
+enum
+{
+   SAVESTATE_DIRTY_RDRAM     = 0,
+   SAVESTATE_DIRTY_TLB_LUT_R = SAVESTATE_DIRTY_RDRAM + RDRAM_MAX_SIZE / SAVESTATE_PAGE_SIZE,
+   SAVESTATE_DIRTY_TLB_LUT_W = SAVESTATE_DIRTY_TLB_LUT_R + 0x100000 * 4 / SAVESTATE_PAGE_SIZE,
+   SAVESTATE_DIRTY_SP_MEM    = SAVESTATE_DIRTY_TLB_LUT_W + 0x100000 * 4 / SAVESTATE_PAGE_SIZE,
+   SAVESTATE_DIRTY_PIF_RAM   = SAVESTATE_DIRTY_SP_MEM + 2, /* DMEM, IMEM */
+   SAVESTATE_DIRTY_CHIPS     = SAVESTATE_DIRTY_PIF_RAM + 1
+};
+
+extern unsigned char savestates_dirty[];
+
+/* Set when RDRAM may have been written without marking its pages, i.e.
+ * by a plugin; the next incremental savestate then compares them all. */
+extern int savestates_dirty_unknown;
+
+static INLINE void savestates_mark_dirty(unsigned int area, uint32_t offset, uint32_t length)
+{
+   uint32_t first = offset / SAVESTATE_PAGE_SIZE;
+   uint32_t last  = (offset + length - 1) / SAVESTATE_PAGE_SIZE;
+
+   memset(&savestates_dirty[area + first], 1, last - first + 1);
+}
+
 typedef enum _savestates_job
 {
     savestates_job_nothing,
@@ -35,6 +76,15 @@ typedef enum _savestates_job
 int savestates_load_m64p(const unsigned char *data, size_t size);
 int savestates_save_m64p(unsigned char *data, size_t size);
 
+/* Incremental savestates: each delta holds the pages that changed since
+ * the previous delta save, and loading it restores that previous state.
+ * Only pages marked in savestates_dirty are looked at, plus the few KB of
+ * registers. The first delta after a reset holds every non-zero page. */
+size_t savestates_delta_size_max(void);
+int savestates_save_delta(unsigned char *data, size_t size, size_t *written);
+int savestates_load_delta(const unsigned char *data, size_t size);
+void savestates_delta_reset(void);
+
 
 #endif /* __SAVESTAVES_H__ */
 
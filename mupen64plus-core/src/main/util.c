@@ -39,28 +39,106 @@
 #include "util.h"
 #include "osal/preproc.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+   && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SWAP_SSSE3
+#include <tmmintrin.h>
+#include <features/features_cpu.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define SWAP_NEON
+#include <arm_neon.h>
+#endif
+
 /**********************
    Byte swap utilities
  **********************/
+#if defined(SWAP_SSSE3)
+/* Compiled for SSSE3 regardless of the build flags, only called once
+ * the CPU is known to support it. */
+__attribute__((target("ssse3")))
+static size_t swap_blocks_ssse3(uint8_t *p, size_t size, size_t length)
+{
+   __m128i mask;
+   size_t i;
+
+   if (length == 2)
+      mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+   else if (length == 4)
+      mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+   else
+      mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+   for (i = 0; i + 16 <= size; i += 16)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+      _mm_storeu_si128((__m128i*)(p + i), _mm_shuffle_epi8(v, mask));
+   }
+
+   return i;
+}
+#elif defined(SWAP_NEON)
+static size_t swap_blocks_neon(uint8_t *p, size_t size, size_t length)
+{
+   size_t i;
+
+   for (i = 0; i + 16 <= size; i += 16)
+   {
+      uint8x16_t v = vld1q_u8(p + i);
+      if (length == 2)
+         v = vrev16q_u8(v);
+      else if (length == 4)
+         v = vrev32q_u8(v);
+      else
+         v = vrev64q_u8(v);
+      vst1q_u8(p + i, v);
+   }
+
+   return i;
+}
+#endif
+
+/* Swaps as many whole 16-byte blocks as the host has a vector byte
+ * shuffle for, and returns the number of elements done. */
+static size_t swap_buffer_simd(void *buffer, size_t length, size_t count)
+{
+#if defined(SWAP_SSSE3)
+   static int have_ssse3 = -1;
+
+   if (have_ssse3 < 0)
+      have_ssse3 = (cpu_features_get() & RETRO_SIMD_SSSE3) != 0;
+   if (have_ssse3)
+      return swap_blocks_ssse3((uint8_t*)buffer, length * count, length) / length;
+#elif defined(SWAP_NEON)
+   return swap_blocks_neon((uint8_t*)buffer, length * count, length) / length;
+#endif
+   return 0;
+}
+
 void swap_buffer(void *buffer, size_t length, size_t count)
 {
    size_t i;
+
+   if (length != 2 && length != 4 && length != 8)
+      return;
+
+   i = swap_buffer_simd(buffer, length, count);
+
    if (length == 2)
    {
       uint16_t *pun = (uint16_t*)buffer;
-      for (i = 0; i < count; i++)
+      for (; i < count; i++)
          pun[i] = m64p_swap16(pun[i]);
    }
    else if (length == 4)
    {
       uint32_t *pun = (uint32_t*)buffer;
-      for (i = 0; i < count; i++)
+      for (; i < count; i++)
          pun[i] = m64p_swap32(pun[i]);
    }
    else if (length == 8)
    {
       uint64_t *pun = (uint64_t*)buffer;
-      for (i = 0; i < count; i++)
+      for (; i < count; i++)
          pun[i] = m64p_swap64(pun[i]);
    }
 }
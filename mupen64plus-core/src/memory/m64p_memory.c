@@ -24,8 +24,10 @@
 #include "../api/m64p_types.h"
 #include "../api/callbacks.h"
 
+#include "../main/device.h"
 #include "../main/main.h"
 #include "../main/rom.h"
+#include "../main/savestates.h"
 
 #include "../r4300/new_dynarec/new_dynarec.h"
 #include "../r4300/r4300_core.h"
@@ -50,8 +52,11 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 extern int fast_memory;
+extern uint32_t fast_memory_fb_start;
+extern uint32_t fast_memory_fb_end;
 
 #if NEW_DYNAREC != NEW_DYNAREC_ARM
 // address : address of the read/write operation being done
@@ -69,18 +74,6 @@ uint64_t cpu_dword;
 // address where the read value will be stored
 uint64_t* rdword;
 
-// hash tables of read functions
-void (*readmem[0x10000])(void);
-void (*readmemb[0x10000])(void);
-void (*readmemh[0x10000])(void);
-void (*readmemd[0x10000])(void);
-
-// hash tables of write functions
-void (*writemem[0x10000])(void);
-void (*writememb[0x10000])(void);
-void (*writememd[0x10000])(void);
-void (*writememh[0x10000])(void);
-
 uint32_t VI_REFRESH = 1500;
 
 typedef int (*readfn)(void*,uint32_t,uint32_t*);
@@ -172,6 +165,22 @@ static int writed(writefn write_word, void *opaque, uint32_t address, uint64_t v
    return result;
 }
 
+/* A page keeps its direct host pointer only while it is mapped to the
+ * plain RDRAM handlers (not framebuffer, breakpoint or MMIO handlers) */
+void update_host_pages(uint16_t region)
+{
+   uint32_t* page = NULL;
+
+   if (g_dev.mem.readmem[region] == read_rdram
+         || g_dev.mem.writemem[region] == write_rdram)
+      page = &g_dev.ri.rdram.dram[(region & 0xff) << 14];
+
+   g_dev.mem.host_read[region] =
+      (g_dev.mem.readmem[region] == read_rdram) ? page : NULL;
+   g_dev.mem.host_write[region] =
+      (g_dev.mem.writemem[region] == write_rdram) ? page : NULL;
+}
+
 static void read_nothing(void)
 {
     *rdword = 0;
@@ -271,747 +280,747 @@ static void write_nomemd(void)
 
 void read_rdram(void)
 {
-    readw(read_rdram_dram, &g_ri, address, rdword);
+    readw(read_rdram_dram, &g_dev.ri, address, rdword);
 }
 
 void read_rdramb(void)
 {
-    readb(read_rdram_dram, &g_ri, address, rdword);
+    readb(read_rdram_dram, &g_dev.ri, address, rdword);
 }
 
 void read_rdramh(void)
 {
-    readh(read_rdram_dram, &g_ri, address, rdword);
+    readh(read_rdram_dram, &g_dev.ri, address, rdword);
 }
 
 void read_rdramd(void)
 {
-    readd(read_rdram_dram, &g_ri, address, rdword);
+    readd(read_rdram_dram, &g_dev.ri, address, rdword);
 }
 
 void write_rdram(void)
 {
-    writew(write_rdram_dram, &g_ri, address, cpu_word);
+    writew(write_rdram_dram, &g_dev.ri, address, cpu_word);
 }
 
 void write_rdramb(void)
 {
-    writeb(write_rdram_dram, &g_ri, address, cpu_byte);
+    writeb(write_rdram_dram, &g_dev.ri, address, cpu_byte);
 }
 
 void write_rdramh(void)
 {
-    writeh(write_rdram_dram, &g_ri, address, cpu_hword);
+    writeh(write_rdram_dram, &g_dev.ri, address, cpu_hword);
 }
 
 void write_rdramd(void)
 {
-    writed(write_rdram_dram, &g_ri, address, cpu_dword);
+    writed(write_rdram_dram, &g_dev.ri, address, cpu_dword);
 }
 
 
 void read_rdramFB(void)
 {
-    readw(read_rdram_fb, &g_dp, address, rdword);
+    readw(read_rdram_fb, &g_dev.dp, address, rdword);
 }
 
 void read_rdramFBb(void)
 {
-    readb(read_rdram_fb, &g_dp, address, rdword);
+    readb(read_rdram_fb, &g_dev.dp, address, rdword);
 }
 
 void read_rdramFBh(void)
 {
-    readh(read_rdram_fb, &g_dp, address, rdword);
+    readh(read_rdram_fb, &g_dev.dp, address, rdword);
 }
 
 void read_rdramFBd(void)
 {
-    readd(read_rdram_fb, &g_dp, address, rdword);
+    readd(read_rdram_fb, &g_dev.dp, address, rdword);
 }
 
 void write_rdramFB(void)
 {
-    writew(write_rdram_fb, &g_dp, address, cpu_word);
+    writew(write_rdram_fb, &g_dev.dp, address, cpu_word);
 }
 
 void write_rdramFBb(void)
 {
-    writeb(write_rdram_fb, &g_dp, address, cpu_byte);
+    writeb(write_rdram_fb, &g_dev.dp, address, cpu_byte);
 }
 
 void write_rdramFBh(void)
 {
-    writeh(write_rdram_fb, &g_dp, address, cpu_hword);
+    writeh(write_rdram_fb, &g_dev.dp, address, cpu_hword);
 }
 
 void write_rdramFBd(void)
 {
-    writed(write_rdram_fb, &g_dp, address, cpu_dword);
+    writed(write_rdram_fb, &g_dev.dp, address, cpu_dword);
 }
 
 
 static void read_rdramreg(void)
 {
-    readw(read_rdram_regs, &g_ri, address, rdword);
+    readw(read_rdram_regs, &g_dev.ri, address, rdword);
 }
 
 static void read_rdramregb(void)
 {
-    readb(read_rdram_regs, &g_ri, address, rdword);
+    readb(read_rdram_regs, &g_dev.ri, address, rdword);
 }
 
 static void read_rdramregh(void)
 {
-    readh(read_rdram_regs, &g_ri, address, rdword);
+    readh(read_rdram_regs, &g_dev.ri, address, rdword);
 }
 
 static void read_rdramregd(void)
 {
-    readd(read_rdram_regs, &g_ri, address, rdword);
+    readd(read_rdram_regs, &g_dev.ri, address, rdword);
 }
 
 static void write_rdramreg(void)
 {
-    writew(write_rdram_regs, &g_ri, address, cpu_word);
+    writew(write_rdram_regs, &g_dev.ri, address, cpu_word);
 }
 
 static void write_rdramregb(void)
 {
-    writeb(write_rdram_regs, &g_ri, address, cpu_byte);
+    writeb(write_rdram_regs, &g_dev.ri, address, cpu_byte);
 }
 
 static void write_rdramregh(void)
 {
-    writeh(write_rdram_regs, &g_ri, address, cpu_hword);
+    writeh(write_rdram_regs, &g_dev.ri, address, cpu_hword);
 }
 
 static void write_rdramregd(void)
 {
-    writed(write_rdram_regs, &g_ri, address, cpu_dword);
+    writed(write_rdram_regs, &g_dev.ri, address, cpu_dword);
 }
 
 
 static void read_rspmem(void)
 {
-    readw(read_rsp_mem, &g_sp, address, rdword);
+    readw(read_rsp_mem, &g_dev.sp, address, rdword);
 }
 
 static void read_rspmemb(void)
 {
-    readb(read_rsp_mem, &g_sp, address, rdword);
+    readb(read_rsp_mem, &g_dev.sp, address, rdword);
 }
 
 static void read_rspmemh(void)
 {
-    readh(read_rsp_mem, &g_sp, address, rdword);
+    readh(read_rsp_mem, &g_dev.sp, address, rdword);
 }
 
 static void read_rspmemd(void)
 {
-    readd(read_rsp_mem, &g_sp, address, rdword);
+    readd(read_rsp_mem, &g_dev.sp, address, rdword);
 }
 
 static void write_rspmem(void)
 {
-    writew(write_rsp_mem, &g_sp, address, cpu_word);
+    writew(write_rsp_mem, &g_dev.sp, address, cpu_word);
 }
 
 static void write_rspmemb(void)
 {
-    writeb(write_rsp_mem, &g_sp, address, cpu_byte);
+    writeb(write_rsp_mem, &g_dev.sp, address, cpu_byte);
 }
 
 static void write_rspmemh(void)
 {
-    writeh(write_rsp_mem, &g_sp, address, cpu_hword);
+    writeh(write_rsp_mem, &g_dev.sp, address, cpu_hword);
 }
 
 static void write_rspmemd(void)
 {
-    writed(write_rsp_mem, &g_sp, address, cpu_dword);
+    writed(write_rsp_mem, &g_dev.sp, address, cpu_dword);
 }
 
 
 static void read_rspreg(void)
 {
-    readw(read_rsp_regs, &g_sp, address, rdword);
+    readw(read_rsp_regs, &g_dev.sp, address, rdword);
 }
 
 static void read_rspregb(void)
 {
-    readb(read_rsp_regs, &g_sp, address, rdword);
+    readb(read_rsp_regs, &g_dev.sp, address, rdword);
 }
 
 static void read_rspregh(void)
 {
-    readh(read_rsp_regs, &g_sp, address, rdword);
+    readh(read_rsp_regs, &g_dev.sp, address, rdword);
 }
 
 static void read_rspregd(void)
 {
-    readd(read_rsp_regs, &g_sp, address, rdword);
+    readd(read_rsp_regs, &g_dev.sp, address, rdword);
 }
 
 static void write_rspreg(void)
 {
-    writew(write_rsp_regs, &g_sp, address, cpu_word);
+    writew(write_rsp_regs, &g_dev.sp, address, cpu_word);
 }
 
 static void write_rspregb(void)
 {
-    writeb(write_rsp_regs, &g_sp, address, cpu_byte);
+    writeb(write_rsp_regs, &g_dev.sp, address, cpu_byte);
 }
 
 static void write_rspregh(void)
 {
-    writeh(write_rsp_regs, &g_sp, address, cpu_hword);
+    writeh(write_rsp_regs, &g_dev.sp, address, cpu_hword);
 }
 
 static void write_rspregd(void)
 {
-    writed(write_rsp_regs, &g_sp, address, cpu_dword);
+    writed(write_rsp_regs, &g_dev.sp, address, cpu_dword);
 }
 
 
 static void read_rspreg2(void)
 {
-    readw(read_rsp_regs2, &g_sp, address, rdword);
+    readw(read_rsp_regs2, &g_dev.sp, address, rdword);
 }
 
 static void read_rspreg2b(void)
 {
-    readb(read_rsp_regs2, &g_sp, address, rdword);
+    readb(read_rsp_regs2, &g_dev.sp, address, rdword);
 }
 
 static void read_rspreg2h(void)
 {
-    readh(read_rsp_regs2, &g_sp, address, rdword);
+    readh(read_rsp_regs2, &g_dev.sp, address, rdword);
 }
 
 static void read_rspreg2d(void)
 {
-    readd(read_rsp_regs2, &g_sp, address, rdword);
+    readd(read_rsp_regs2, &g_dev.sp, address, rdword);
 }
 
 static void write_rspreg2(void)
 {
-    writew(write_rsp_regs2, &g_sp, address, cpu_word);
+    writew(write_rsp_regs2, &g_dev.sp, address, cpu_word);
 }
 
 static void write_rspreg2b(void)
 {
-    writeb(write_rsp_regs2, &g_sp, address, cpu_byte);
+    writeb(write_rsp_regs2, &g_dev.sp, address, cpu_byte);
 }
 
 static void write_rspreg2h(void)
 {
-    writeh(write_rsp_regs2, &g_sp, address, cpu_hword);
+    writeh(write_rsp_regs2, &g_dev.sp, address, cpu_hword);
 }
 
 static void write_rspreg2d(void)
 {
-    writed(write_rsp_regs2, &g_sp, address, cpu_dword);
+    writed(write_rsp_regs2, &g_dev.sp, address, cpu_dword);
 }
 
 
 static void read_dp(void)
 {
-    readw(read_dpc_regs, &g_dp, address, rdword);
+    readw(read_dpc_regs, &g_dev.dp, address, rdword);
 }
 
 static void read_dpb(void)
 {
-    readb(read_dpc_regs, &g_dp, address, rdword);
+    readb(read_dpc_regs, &g_dev.dp, address, rdword);
 }
 
 static void read_dph(void)
 {
-    readh(read_dpc_regs, &g_dp, address, rdword);
+    readh(read_dpc_regs, &g_dev.dp, address, rdword);
 }
 
 static void read_dpd(void)
 {
-    readd(read_dpc_regs, &g_dp, address, rdword);
+    readd(read_dpc_regs, &g_dev.dp, address, rdword);
 }
 
 static void write_dp(void)
 {
-    writew(write_dpc_regs, &g_dp, address, cpu_word);
+    writew(write_dpc_regs, &g_dev.dp, address, cpu_word);
 }
 
 static void write_dpb(void)
 {
-    writeb(write_dpc_regs, &g_dp, address, cpu_byte);
+    writeb(write_dpc_regs, &g_dev.dp, address, cpu_byte);
 }
 
 static void write_dph(void)
 {
-    writeh(write_dpc_regs, &g_dp, address, cpu_hword);
+    writeh(write_dpc_regs, &g_dev.dp, address, cpu_hword);
 }
 
 static void write_dpd(void)
 {
-    writed(write_dpc_regs, &g_dp, address, cpu_dword);
+    writed(write_dpc_regs, &g_dev.dp, address, cpu_dword);
 }
 
 
 static void read_dps(void)
 {
-    readw(read_dps_regs, &g_dp, address, rdword);
+    readw(read_dps_regs, &g_dev.dp, address, rdword);
 }
 
 static void read_dpsb(void)
 {
-    readb(read_dps_regs, &g_dp, address, rdword);
+    readb(read_dps_regs, &g_dev.dp, address, rdword);
 }
 
 static void read_dpsh(void)
 {
-    readh(read_dps_regs, &g_dp, address, rdword);
+    readh(read_dps_regs, &g_dev.dp, address, rdword);
 }
 
 static void read_dpsd(void)
 {
-    readd(read_dps_regs, &g_dp, address, rdword);
+    readd(read_dps_regs, &g_dev.dp, address, rdword);
 }
 
 static void write_dps(void)
 {
-    writew(write_dps_regs, &g_dp, address, cpu_word);
+    writew(write_dps_regs, &g_dev.dp, address, cpu_word);
 }
 
 static void write_dpsb(void)
 {
-    writeb(write_dps_regs, &g_dp, address, cpu_byte);
+    writeb(write_dps_regs, &g_dev.dp, address, cpu_byte);
 }
 
 static void write_dpsh(void)
 {
-    writeh(write_dps_regs, &g_dp, address, cpu_hword);
+    writeh(write_dps_regs, &g_dev.dp, address, cpu_hword);
 }
 
 static void write_dpsd(void)
 {
-    writed(write_dps_regs, &g_dp, address, cpu_dword);
+    writed(write_dps_regs, &g_dev.dp, address, cpu_dword);
 }
 
 
 static void read_mi(void)
 {
-    readw(read_mi_regs, &g_r4300, address, rdword);
+    readw(read_mi_regs, &g_dev.r4300, address, rdword);
 }
 
 static void read_mib(void)
 {
-    readb(read_mi_regs, &g_r4300, address, rdword);
+    readb(read_mi_regs, &g_dev.r4300, address, rdword);
 }
 
 static void read_mih(void)
 {
-    readh(read_mi_regs, &g_r4300, address, rdword);
+    readh(read_mi_regs, &g_dev.r4300, address, rdword);
 }
 
 static void read_mid(void)
 {
-    readd(read_mi_regs, &g_r4300, address, rdword);
+    readd(read_mi_regs, &g_dev.r4300, address, rdword);
 }
 
 static void write_mi(void)
 {
-    writew(write_mi_regs, &g_r4300, address, cpu_word);
+    writew(write_mi_regs, &g_dev.r4300, address, cpu_word);
 }
 
 static void write_mib(void)
 {
-    writeb(write_mi_regs, &g_r4300, address, cpu_byte);
+    writeb(write_mi_regs, &g_dev.r4300, address, cpu_byte);
 }
 
 static void write_mih(void)
 {
-    writeh(write_mi_regs, &g_r4300, address, cpu_hword);
+    writeh(write_mi_regs, &g_dev.r4300, address, cpu_hword);
 }
 
 static void write_mid(void)
 {
-    writed(write_mi_regs, &g_r4300, address, cpu_dword);
+    writed(write_mi_regs, &g_dev.r4300, address, cpu_dword);
 }
 
 
 static void read_vi(void)
 {
-    readw(read_vi_regs, &g_vi, address, rdword);
+    readw(read_vi_regs, &g_dev.vi, address, rdword);
 }
 
 static void read_vib(void)
 {
-    readb(read_vi_regs, &g_vi, address, rdword);
+    readb(read_vi_regs, &g_dev.vi, address, rdword);
 }
 
 static void read_vih(void)
 {
-    readh(read_vi_regs, &g_vi, address, rdword);
+    readh(read_vi_regs, &g_dev.vi, address, rdword);
 }
 
 static void read_vid(void)
 {
-    readd(read_vi_regs, &g_vi, address, rdword);
+    readd(read_vi_regs, &g_dev.vi, address, rdword);
 }
 
 static void write_vi(void)
 {
-    writew(write_vi_regs, &g_vi, address, cpu_word);
+    writew(write_vi_regs, &g_dev.vi, address, cpu_word);
 }
 
 static void write_vib(void)
 {
-    writeb(write_vi_regs, &g_vi, address, cpu_byte);
+    writeb(write_vi_regs, &g_dev.vi, address, cpu_byte);
 }
 
 static void write_vih(void)
 {
-    writeh(write_vi_regs, &g_vi, address, cpu_hword);
+    writeh(write_vi_regs, &g_dev.vi, address, cpu_hword);
 }
 
 static void write_vid(void)
 {
-    writed(write_vi_regs, &g_vi, address, cpu_dword);
+    writed(write_vi_regs, &g_dev.vi, address, cpu_dword);
 }
 
 
 static void read_ai(void)
 {
-    readw(read_ai_regs, &g_ai, address, rdword);
+    readw(read_ai_regs, &g_dev.ai, address, rdword);
 }
 
 static void read_aib(void)
 {
-    readb(read_ai_regs, &g_ai, address, rdword);
+    readb(read_ai_regs, &g_dev.ai, address, rdword);
 }
 
 static void read_aih(void)
 {
-    readh(read_ai_regs, &g_ai, address, rdword);
+    readh(read_ai_regs, &g_dev.ai, address, rdword);
 }
 
 static void read_aid(void)
 {
-    readd(read_ai_regs, &g_ai, address, rdword);
+    readd(read_ai_regs, &g_dev.ai, address, rdword);
 }
 
 static void write_ai(void)
 {
-    writew(write_ai_regs, &g_ai, address, cpu_word);
+    writew(write_ai_regs, &g_dev.ai, address, cpu_word);
 }
 
 static void write_aib(void)
 {
-    writeb(write_ai_regs, &g_ai, address, cpu_byte);
+    writeb(write_ai_regs, &g_dev.ai, address, cpu_byte);
 }
 
 static void write_aih(void)
 {
-    writeh(write_ai_regs, &g_ai, address, cpu_hword);
+    writeh(write_ai_regs, &g_dev.ai, address, cpu_hword);
 }
 
 static void write_aid(void)
 {
-    writed(write_ai_regs, &g_ai, address, cpu_dword);
+    writed(write_ai_regs, &g_dev.ai, address, cpu_dword);
 }
 
 
 static void read_pi(void)
 {
-    readw(read_pi_regs, &g_pi, address, rdword);
+    readw(read_pi_regs, &g_dev.pi, address, rdword);
 }
 
 static void read_pib(void)
 {
-    readb(read_pi_regs, &g_pi, address, rdword);
+    readb(read_pi_regs, &g_dev.pi, address, rdword);
 }
 
 static void read_pih(void)
 {
-    readh(read_pi_regs, &g_pi, address, rdword);
+    readh(read_pi_regs, &g_dev.pi, address, rdword);
 }
 
 static void read_pid(void)
 {
-    readd(read_pi_regs, &g_pi, address, rdword);
+    readd(read_pi_regs, &g_dev.pi, address, rdword);
 }
 
 static void write_pi(void)
 {
-    writew(write_pi_regs, &g_pi, address, cpu_word);
+    writew(write_pi_regs, &g_dev.pi, address, cpu_word);
 }
 
 static void write_pib(void)
 {
-    writeb(write_pi_regs, &g_pi, address, cpu_byte);
+    writeb(write_pi_regs, &g_dev.pi, address, cpu_byte);
 }
 
 static void write_pih(void)
 {
-    writeh(write_pi_regs, &g_pi, address, cpu_hword);
+    writeh(write_pi_regs, &g_dev.pi, address, cpu_hword);
 }
 
 static void write_pid(void)
 {
-    writed(write_pi_regs, &g_pi, address, cpu_dword);
+    writed(write_pi_regs, &g_dev.pi, address, cpu_dword);
 }
 
 
 static void read_ri(void)
 {
-    readw(read_ri_regs, &g_ri, address, rdword);
+    readw(read_ri_regs, &g_dev.ri, address, rdword);
 }
 
 static void read_rib(void)
 {
-    readb(read_ri_regs, &g_ri, address, rdword);
+    readb(read_ri_regs, &g_dev.ri, address, rdword);
 }
 
 static void read_rih(void)
 {
-    readh(read_ri_regs, &g_ri, address, rdword);
+    readh(read_ri_regs, &g_dev.ri, address, rdword);
 }
 
 static void read_rid(void)
 {
-    readd(read_ri_regs, &g_ri, address, rdword);
+    readd(read_ri_regs, &g_dev.ri, address, rdword);
 }
 
 static void write_ri(void)
 {
-    writew(write_ri_regs, &g_ri, address, cpu_word);
+    writew(write_ri_regs, &g_dev.ri, address, cpu_word);
 }
 
 static void write_rib(void)
 {
-    writeb(write_ri_regs, &g_ri, address, cpu_byte);
+    writeb(write_ri_regs, &g_dev.ri, address, cpu_byte);
 }
 
 static void write_rih(void)
 {
-    writeh(write_ri_regs, &g_ri, address, cpu_hword);
+    writeh(write_ri_regs, &g_dev.ri, address, cpu_hword);
 }
 
 static void write_rid(void)
 {
-    writed(write_ri_regs, &g_ri, address, cpu_dword);
+    writed(write_ri_regs, &g_dev.ri, address, cpu_dword);
 }
 
 
 static void read_si(void)
 {
-    readw(read_si_regs, &g_si, address, rdword);
+    readw(read_si_regs, &g_dev.si, address, rdword);
 }
 
 static void read_sib(void)
 {
-    readb(read_si_regs, &g_si, address, rdword);
+    readb(read_si_regs, &g_dev.si, address, rdword);
 }
 
 static void read_sih(void)
 {
-    readh(read_si_regs, &g_si, address, rdword);
+    readh(read_si_regs, &g_dev.si, address, rdword);
 }
 
 static void read_sid(void)
 {
-    readd(read_si_regs, &g_si, address, rdword);
+    readd(read_si_regs, &g_dev.si, address, rdword);
 }
 
 static void write_si(void)
 {
-    writew(write_si_regs, &g_si, address, cpu_word);
+    writew(write_si_regs, &g_dev.si, address, cpu_word);
 }
 
 static void write_sib(void)
 {
-    writeb(write_si_regs, &g_si, address, cpu_byte);
+    writeb(write_si_regs, &g_dev.si, address, cpu_byte);
 }
 
 static void write_sih(void)
 {
-    writeh(write_si_regs, &g_si, address, cpu_hword);
+    writeh(write_si_regs, &g_dev.si, address, cpu_hword);
 }
 
 static void write_sid(void)
 {
-    writed(write_si_regs, &g_si, address, cpu_dword);
+    writed(write_si_regs, &g_dev.si, address, cpu_dword);
 }
 
 static void read_pi_flashram_status(void)
 {
-    readw(read_flashram_status, &g_pi, address, rdword);
+    readw(read_flashram_status, &g_dev.pi, address, rdword);
 }
 
 static void read_pi_flashram_statusb(void)
 {
-    readb(read_flashram_status, &g_pi, address, rdword);
+    readb(read_flashram_status, &g_dev.pi, address, rdword);
 }
 
 static void read_pi_flashram_statush(void)
 {
-    readh(read_flashram_status, &g_pi, address, rdword);
+    readh(read_flashram_status, &g_dev.pi, address, rdword);
 }
 
 static void read_pi_flashram_statusd(void)
 {
-    readd(read_flashram_status, &g_pi, address, rdword);
+    readd(read_flashram_status, &g_dev.pi, address, rdword);
 }
 
 static void write_pi_flashram_command(void)
 {
-    writew(write_flashram_command, &g_pi, address, cpu_word);
+    writew(write_flashram_command, &g_dev.pi, address, cpu_word);
 }
 
 static void write_pi_flashram_commandb(void)
 {
-    writeb(write_flashram_command, &g_pi, address, cpu_byte);
+    writeb(write_flashram_command, &g_dev.pi, address, cpu_byte);
 }
 
 static void write_pi_flashram_commandh(void)
 {
-    writeh(write_flashram_command, &g_pi, address, cpu_hword);
+    writeh(write_flashram_command, &g_dev.pi, address, cpu_hword);
 }
 
 static void write_pi_flashram_commandd(void)
 {
-    writed(write_flashram_command, &g_pi, address, cpu_dword);
+    writed(write_flashram_command, &g_dev.pi, address, cpu_dword);
 }
 
 
 static void read_rom(void)
 {
-    readw(read_cart_rom, &g_pi, address, rdword);
+    readw(read_cart_rom, &g_dev.pi, address, rdword);
 }
 
 static void read_romb(void)
 {
-    readb(read_cart_rom, &g_pi, address, rdword);
+    readb(read_cart_rom, &g_dev.pi, address, rdword);
 }
 
 static void read_romh(void)
 {
-    readh(read_cart_rom, &g_pi, address, rdword);
+    readh(read_cart_rom, &g_dev.pi, address, rdword);
 }
 
 static void read_romd(void)
 {
-    readd(read_cart_rom, &g_pi, address, rdword);
+    readd(read_cart_rom, &g_dev.pi, address, rdword);
 }
 
 static void write_rom(void)
 {
-    writew(write_cart_rom, &g_pi, address, cpu_word);
+    writew(write_cart_rom, &g_dev.pi, address, cpu_word);
 }
 
 
 static void read_pif(void)
 {
-    readw(read_pif_ram, &g_si, address, rdword);
+    readw(read_pif_ram, &g_dev.si, address, rdword);
 }
 
 static void read_pifb(void)
 {
-    readb(read_pif_ram, &g_si, address, rdword);
+    readb(read_pif_ram, &g_dev.si, address, rdword);
 }
 
 static void read_pifh(void)
 {
-    readh(read_pif_ram, &g_si, address, rdword);
+    readh(read_pif_ram, &g_dev.si, address, rdword);
 }
 
 static void read_pifd(void)
 {
-    readd(read_pif_ram, &g_si, address, rdword);
+    readd(read_pif_ram, &g_dev.si, address, rdword);
 }
 
 static void write_pif(void)
 {
-    writew(write_pif_ram, &g_si, address, cpu_word);
+    writew(write_pif_ram, &g_dev.si, address, cpu_word);
 }
 
 static void write_pifb(void)
 {
-    writeb(write_pif_ram, &g_si, address, cpu_byte);
+    writeb(write_pif_ram, &g_dev.si, address, cpu_byte);
 }
 
 static void write_pifh(void)
 {
-    writeh(write_pif_ram, &g_si, address, cpu_hword);
+    writeh(write_pif_ram, &g_dev.si, address, cpu_hword);
 }
 
 static void write_pifd(void)
 {
-    writed(write_pif_ram, &g_si, address, cpu_dword);
+    writed(write_pif_ram, &g_dev.si, address, cpu_dword);
 }
 
 static void read_dd(void)
 {
-    readw(read_dd_regs, &g_dd, address, rdword);
+    readw(read_dd_regs, &g_dev.dd, address, rdword);
 }
 
 static void read_ddb(void)
 {
-    readb(read_dd_regs, &g_dd, address, rdword);
+    readb(read_dd_regs, &g_dev.dd, address, rdword);
 }
 
 static void read_ddh(void)
 {
-    readh(read_dd_regs, &g_dd, address, rdword);
+    readh(read_dd_regs, &g_dev.dd, address, rdword);
 }
 
 static void read_ddd(void)
 {
-    readd(read_dd_regs, &g_dd, address, rdword);
+    readd(read_dd_regs, &g_dev.dd, address, rdword);
 }
 
 static void write_dd(void)
 {
-    writew(write_dd_regs, &g_dd, address, cpu_word);
+    writew(write_dd_regs, &g_dev.dd, address, cpu_word);
 }
 
 static void write_ddb(void)
 {
-    writeb(write_dd_regs, &g_dd, address, cpu_byte);
+    writeb(write_dd_regs, &g_dev.dd, address, cpu_byte);
 }
 
 static void write_ddh(void)
 {
-    writeh(write_dd_regs, &g_dd, address, cpu_hword);
+    writeh(write_dd_regs, &g_dev.dd, address, cpu_hword);
 }
 
 static void write_ddd(void)
 {
-    writed(write_dd_regs, &g_dd, address, cpu_dword);
+    writed(write_dd_regs, &g_dev.dd, address, cpu_dword);
 }
 
 static void read_ddipl(void)
 {
-   readw(read_dd_ipl, &g_pi, address, rdword);
+   readw(read_dd_ipl, &g_dev.pi, address, rdword);
 }
 
 static void read_ddiplb(void)
 {
-   readb(read_dd_ipl, &g_pi, address, rdword);
+   readb(read_dd_ipl, &g_dev.pi, address, rdword);
 }
 
 static void read_ddiplh(void)
 {
-   readh(read_dd_ipl, &g_pi, address, rdword);
+   readh(read_dd_ipl, &g_dev.pi, address, rdword);
 }
 
 static void read_ddipld(void)
 {
-   readd(read_dd_ipl, &g_pi, address, rdword);
+   readd(read_dd_ipl, &g_dev.pi, address, rdword);
 }
 
 static void write_ddipl(void)
 {
-   writew(write_dd_ipl, &g_pi, address, cpu_word);
+   writew(write_dd_ipl, &g_dev.pi, address, cpu_word);
 }
 
 #ifdef DBG
@@ -1096,14 +1105,15 @@ void activate_memory_break_read(uint32_t address)
    if (saved_readmem[region] != NULL)
       return;
 
-   saved_readmemb[region] = readmemb[region];
-   saved_readmemh[region] = readmemh[region];
-   saved_readmem [region] = readmem [region];
-   saved_readmemd[region] = readmemd[region];
-   readmemb[region] = readmemb_with_bp_checks;
-   readmemh[region] = readmemh_with_bp_checks;
-   readmem [region] = readmem_with_bp_checks;
-   readmemd[region] = readmemd_with_bp_checks;
+   saved_readmemb[region] = g_dev.mem.readmemb[region];
+   saved_readmemh[region] = g_dev.mem.readmemh[region];
+   saved_readmem [region] = g_dev.mem.readmem [region];
+   saved_readmemd[region] = g_dev.mem.readmemd[region];
+   g_dev.mem.readmemb[region] = readmemb_with_bp_checks;
+   g_dev.mem.readmemh[region] = readmemh_with_bp_checks;
+   g_dev.mem.readmem [region] = readmem_with_bp_checks;
+   g_dev.mem.readmemd[region] = readmemd_with_bp_checks;
+   update_host_pages(region);
 }
 
 void deactivate_memory_break_read(uint32_t address)
@@ -1113,14 +1123,15 @@ void deactivate_memory_break_read(uint32_t address)
    if (saved_readmem[region] == NULL)
       return;
 
-   readmemb[region] = saved_readmemb[region];
-   readmemh[region] = saved_readmemh[region];
-   readmem [region] = saved_readmem [region];
-   readmemd[region] = saved_readmemd[region];
+   g_dev.mem.readmemb[region] = saved_readmemb[region];
+   g_dev.mem.readmemh[region] = saved_readmemh[region];
+   g_dev.mem.readmem [region] = saved_readmem [region];
+   g_dev.mem.readmemd[region] = saved_readmemd[region];
    saved_readmemb[region] = NULL;
    saved_readmemh[region] = NULL;
    saved_readmem [region] = NULL;
    saved_readmemd[region] = NULL;
+   update_host_pages(region);
 }
 
 void activate_memory_break_write(uint32_t address)
@@ -1130,14 +1141,15 @@ void activate_memory_break_write(uint32_t address)
    if (saved_writemem[region] != NULL)
       return;
 
-   saved_writememb[region] = writememb[region];
-   saved_writememh[region] = writememh[region];
-   saved_writemem [region] = writemem [region];
-   saved_writememd[region] = writememd[region];
-   writememb[region] = writememb_with_bp_checks;
-   writememh[region] = writememh_with_bp_checks;
-   writemem [region] = writemem_with_bp_checks;
-   writememd[region] = writememd_with_bp_checks;
+   saved_writememb[region] = g_dev.mem.writememb[region];
+   saved_writememh[region] = g_dev.mem.writememh[region];
+   saved_writemem [region] = g_dev.mem.writemem [region];
+   saved_writememd[region] = g_dev.mem.writememd[region];
+   g_dev.mem.writememb[region] = writememb_with_bp_checks;
+   g_dev.mem.writememh[region] = writememh_with_bp_checks;
+   g_dev.mem.writemem [region] = writemem_with_bp_checks;
+   g_dev.mem.writememd[region] = writememd_with_bp_checks;
+   update_host_pages(region);
 }
 
 void deactivate_memory_break_write(uint32_t address)
@@ -1147,14 +1159,15 @@ void deactivate_memory_break_write(uint32_t address)
    if (saved_writemem[region] == NULL)
       return;
 
-   writememb[region] = saved_writememb[region];
-   writememh[region] = saved_writememh[region];
-   writemem [region] = saved_writemem [region];
-   writememd[region] = saved_writememd[region];
+   g_dev.mem.writememb[region] = saved_writememb[region];
+   g_dev.mem.writememh[region] = saved_writememh[region];
+   g_dev.mem.writemem [region] = saved_writemem [region];
+   g_dev.mem.writememd[region] = saved_writememd[region];
    saved_writememb[region] = NULL;
    saved_writememh[region] = NULL;
    saved_writemem [region] = NULL;
    saved_writememd[region] = NULL;
+   update_host_pages(region);
 }
 
 int get_memory_type(uint32_t address)
@@ -1362,27 +1375,29 @@ int init_memory(void)
    }
 
    fast_memory = 1;
+   fast_memory_fb_start = 0;
+   fast_memory_fb_end = 0;
 
    if ((g_ddrom != NULL) && (g_ddrom_size != 0) && (g_rom == NULL) && (g_rom_size == 0))
    {
       //Init from 64DD IPL ROM
-      init_cic_using_ipl3(&g_si.pif.cic, g_ddrom + 0x40);
+      init_cic_using_ipl3(&g_dev.si.pif.cic, g_ddrom + 0x40);
    }
    else
    {
       //Init from N64 ROM
-      init_cic_using_ipl3(&g_si.pif.cic, g_rom + 0x40);
+      init_cic_using_ipl3(&g_dev.si.pif.cic, g_rom + 0x40);
    }
 
-   init_r4300(&g_r4300);
-   init_rdp(&g_dp);
-   init_rsp(&g_sp);
-   init_ai(&g_ai);
-   init_pi(&g_pi);
-   init_ri(&g_ri);
-   init_si(&g_si);
-   init_vi(&g_vi);
-   init_dd(&g_dd);
+   init_r4300(&g_dev.r4300);
+   init_rdp(&g_dev.dp);
+   init_rsp(&g_dev.sp);
+   init_ai(&g_dev.ai);
+   init_pi(&g_dev.pi);
+   init_ri(&g_dev.ri);
+   init_si(&g_dev.si);
+   init_vi(&g_dev.vi);
+   init_dd(&g_dev.dd);
 
    DebugMessage(M64MSG_VERBOSE, "Memory initialized");
    return 0;
@@ -1412,18 +1427,18 @@ static void map_region_r(uint16_t region,
       saved_readmemh[region] = read16;
       saved_readmem [region] = read32;
       saved_readmemd[region] = read64;
-      readmemb[region] = readmemb_with_bp_checks;
-      readmemh[region] = readmemh_with_bp_checks;
-      readmem [region] = readmem_with_bp_checks;
-      readmemd[region] = readmemd_with_bp_checks;
+      g_dev.mem.readmemb[region] = readmemb_with_bp_checks;
+      g_dev.mem.readmemh[region] = readmemh_with_bp_checks;
+      g_dev.mem.readmem [region] = readmem_with_bp_checks;
+      g_dev.mem.readmemd[region] = readmemd_with_bp_checks;
    }
    else
 #endif
    {
-      readmemb[region] = read8;
-      readmemh[region] = read16;
-      readmem [region] = read32;
-      readmemd[region] = read64;
+      g_dev.mem.readmemb[region] = read8;
+      g_dev.mem.readmemh[region] = read16;
+      g_dev.mem.readmem [region] = read32;
+      g_dev.mem.readmemd[region] = read64;
    }
 }
 
@@ -1441,18 +1456,18 @@ void map_region_w(uint16_t region,
       saved_writememh[region] = write16;
       saved_writemem [region] = write32;
       saved_writememd[region] = write64;
-      writememb[region] = writememb_with_bp_checks;
-      writememh[region] = writememh_with_bp_checks;
-      writemem [region] = writemem_with_bp_checks;
-      writememd[region] = writememd_with_bp_checks;
+      g_dev.mem.writememb[region] = writememb_with_bp_checks;
+      g_dev.mem.writememh[region] = writememh_with_bp_checks;
+      g_dev.mem.writemem [region] = writemem_with_bp_checks;
+      g_dev.mem.writememd[region] = writememd_with_bp_checks;
    }
    else
 #endif
    {
-      writememb[region] = write8;
-      writememh[region] = write16;
-      writemem [region] = write32;
-      writememd[region] = write64;
+      g_dev.mem.writememb[region] = write8;
+      g_dev.mem.writememh[region] = write16;
+      g_dev.mem.writemem [region] = write32;
+      g_dev.mem.writememd[region] = write64;
    }
 }
 
@@ -1470,6 +1485,7 @@ void map_region(uint16_t region,
    map_region_t(region, type);
    map_region_r(region, read8, read16, read32, read64);
    map_region_w(region, write8, write16, write32, write64);
+   update_host_pages(region);
 }
 
 uint32_t *fast_mem_access(uint32_t address)
@@ -1477,15 +1493,55 @@ uint32_t *fast_mem_access(uint32_t address)
    /* This code is performance critical, specially on pure interpreter mode.
     * Removing error checking saves some time, but the emulator may crash. */
    if ((address & 0xc0000000) != 0x80000000)
+   {
+      const struct tlb_cache_entry *e = tlb_cache_find(address, 2);
+
+      if (e != NULL && e->host != NULL)
+         return e->host + ((address & UINT32_C(0xffc)) >> 2);
       address = virtual_to_physical_address(address, 2);
+   }
 
    address &= UINT32_C(0x1ffffffc);
 
    if (address < RDRAM_MAX_SIZE)
-      return (uint32_t*)((uint8_t*)g_rdram + address);
+      return (uint32_t*)((uint8_t*)g_dev.rdram + address);
    else if (address >= UINT32_C(0x10000000))
       return (uint32_t*)((uint8_t*)g_rom + address - UINT32_C(0x10000000));
    else if ((address & UINT32_C(0xffffe000)) == UINT32_C(0x04000000))
-      return (uint32_t*)((uint8_t*)g_sp.mem + (address & UINT32_C(0x1ffc)));
+      return (uint32_t*)((uint8_t*)g_dev.sp.mem + (address & UINT32_C(0x1ffc)));
    return NULL;
 }
+
+void dma_copy(uint8_t *dst, uint32_t dst_addr,
+      const uint8_t *src, uint32_t src_addr, size_t length)
+{
+   if (dst == (uint8_t*)g_dev.rdram && length != 0)
+      savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, dst_addr, (uint32_t)length);
+
+   /* Only whole words are stored the same way in both buffers, so the
+    * bulk copy needs both addresses at the same offset within a word. */
+   if (((dst_addr ^ src_addr) & 3) == 0)
+   {
+      size_t words;
+
+      for (; length != 0 && (dst_addr & 3) != 0; --length)
+      {
+         dst[dst_addr ^ S8] = src[src_addr ^ S8];
+         dst_addr++;
+         src_addr++;
+      }
+
+      words = length & ~(size_t)3;
+      memcpy(dst + dst_addr, src + src_addr, words);
+      dst_addr += (uint32_t)words;
+      src_addr += (uint32_t)words;
+      length   -= words;
+   }
+
+   for (; length != 0; --length)
+   {
+      dst[dst_addr ^ S8] = src[src_addr ^ S8];
+      dst_addr++;
+      src_addr++;
+   }
+}
@@ -22,6 +22,7 @@
 #ifndef M64P_MEMORY_MEMORY_H
 #define M64P_MEMORY_MEMORY_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifndef MASKED_WRITE
@@ -29,34 +30,119 @@
 #endif
 
 #include "libretro_memory.h"
+#include "../main/savestates.h"
 
 #define AI_STATUS_FIFO_FULL	0x80000000		/* Bit 31: full */
 #define AI_STATUS_DMA_BUSY	   0x40000000		/* Bit 30: busy */
 
 extern uint32_t VI_REFRESH;
 
-#define read_word_in_memory() readmem[address>>16]()
-#define read_byte_in_memory() readmemb[address>>16]()
-#define read_hword_in_memory() readmemh[address>>16]()
-#define read_dword_in_memory() readmemd[address>>16]()
-#define write_word_in_memory() writemem[address>>16]()
-#define write_byte_in_memory() writememb[address >>16]()
-#define write_hword_in_memory() writememh[address >>16]()
-#define write_dword_in_memory() writememd[address >>16]()
+/* Pages with a host pointer in host_read/host_write are plain RDRAM and
+ * are accessed directly, everything else goes through the handlers.
+ * Direct stores mark their page for incremental savestates. */
+#define HOST_PAGE_OFFSET(a) (((a) & 0xffff) >> 2)
+#define HOST_PAGE_DIRTY(a) \
+   (savestates_dirty[SAVESTATE_DIRTY_RDRAM + (((a) & 0x7fffff) >> 12)] = 1)
+
+#define read_word_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_read[address >> 16]; \
+   if (page != NULL) \
+      *rdword = page[HOST_PAGE_OFFSET(address)]; \
+   else \
+      g_dev.mem.readmem[address >> 16](); \
+} while (0)
+
+#define read_byte_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_read[address >> 16]; \
+   if (page != NULL) \
+      *rdword = ((uint8_t*)page)[(address & 0xffff) ^ S8]; \
+   else \
+      g_dev.mem.readmemb[address >> 16](); \
+} while (0)
+
+#define read_hword_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_read[address >> 16]; \
+   if (page != NULL) \
+      *rdword = ((uint16_t*)page)[((address & 0xffff) >> 1) ^ Sh16]; \
+   else \
+      g_dev.mem.readmemh[address >> 16](); \
+} while (0)
+
+#define read_dword_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_read[address >> 16]; \
+   if (page != NULL) \
+      *rdword = ((uint64_t)page[HOST_PAGE_OFFSET(address)] << 32) \
+              | page[HOST_PAGE_OFFSET(address) + 1]; \
+   else \
+      g_dev.mem.readmemd[address >> 16](); \
+} while (0)
+
+#define write_word_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_write[address >> 16]; \
+   if (page != NULL) \
+   { \
+      page[HOST_PAGE_OFFSET(address)] = cpu_word; \
+      HOST_PAGE_DIRTY(address); \
+   } \
+   else \
+      g_dev.mem.writemem[address >> 16](); \
+} while (0)
+
+#define write_byte_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_write[address >> 16]; \
+   if (page != NULL) \
+   { \
+      ((uint8_t*)page)[(address & 0xffff) ^ S8] = cpu_byte; \
+      HOST_PAGE_DIRTY(address); \
+   } \
+   else \
+      g_dev.mem.writememb[address >> 16](); \
+} while (0)
+
+#define write_hword_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_write[address >> 16]; \
+   if (page != NULL) \
+   { \
+      ((uint16_t*)page)[((address & 0xffff) >> 1) ^ Sh16] = cpu_hword; \
+      HOST_PAGE_DIRTY(address); \
+   } \
+   else \
+      g_dev.mem.writememh[address >> 16](); \
+} while (0)
+
+#define write_dword_in_memory() do { \
+   uint32_t* page = g_dev.mem.host_write[address >> 16]; \
+   if (page != NULL) \
+   { \
+      page[HOST_PAGE_OFFSET(address)]     = (uint32_t)(cpu_dword >> 32); \
+      page[HOST_PAGE_OFFSET(address) + 1] = (uint32_t)cpu_dword; \
+      HOST_PAGE_DIRTY(address); \
+   } \
+   else \
+      g_dev.mem.writememd[address >> 16](); \
+} while (0)
 
 extern uint32_t address, cpu_word;
 extern uint8_t cpu_byte;
 extern uint16_t cpu_hword;
 extern uint64_t cpu_dword, *rdword;
 
-extern void (*readmem[0x10000])(void);
-extern void (*readmemb[0x10000])(void);
-extern void (*readmemh[0x10000])(void);
-extern void (*readmemd[0x10000])(void);
-extern void (*writemem[0x10000])(void);
-extern void (*writememb[0x10000])(void);
-extern void (*writememh[0x10000])(void);
-extern void (*writememd[0x10000])(void);
+/* Per 64KiB page memory map, filled by init_memory() */
+struct memory
+{
+   void (*readmem[0x10000])(void);
+   void (*readmemb[0x10000])(void);
+   void (*readmemh[0x10000])(void);
+   void (*readmemd[0x10000])(void);
+   void (*writemem[0x10000])(void);
+   void (*writememb[0x10000])(void);
+   void (*writememh[0x10000])(void);
+   void (*writememd[0x10000])(void);
+
+   /* direct RDRAM pointers, NULL for pages that need a handler */
+   uint32_t* host_read[0x10000];
+   uint32_t* host_write[0x10000];
+};
 
 #ifdef MSB_FIRST
 #define sl(mot) mot
@@ -91,6 +177,10 @@ void map_region(uint16_t region,
  void (*write32)(void),
  void (*write64)(void));
 
+/* Recomputes the host pointers of a region; must follow any direct
+ * change of its handlers. */
+void update_host_pages(uint16_t region);
+
 /* XXX: cannot make them static because of dynarec + rdp fb */
 void read_rdram(void);
 void read_rdramb(void);
@@ -115,6 +205,13 @@ void write_rdramFBd(void);
  * Useful for getting fast access to a zone with executable code. */
 uint32_t *fast_mem_access(uint32_t address);
 
+/* Copies length bytes between two buffers laid out like RDRAM (32-bit
+ * words in host order), with both addresses in N64 byte order. This is
+ * what the DMA engines use instead of copying byte by byte. Copies into
+ * RDRAM mark their pages for incremental savestates. */
+void dma_copy(uint8_t *dst, uint32_t dst_addr,
+      const uint8_t *src, uint32_t src_addr, size_t length);
+
 #ifdef DBG
 void activate_memory_break_read(uint32_t address);
 void deactivate_memory_break_read(uint32_t address);
@@ -24,6 +24,7 @@
 
 #include "../api/m64p_types.h"
 #include "../api/callbacks.h"
+#include "../main/savestates.h"
 #include "../memory/memory.h"
 #include "../ri/ri_controller.h"
 
@@ -66,8 +67,8 @@ static void flashram_command(struct pi_controller *pi, uint32_t command)
                break;
             case FLASHRAM_MODE_WRITE:
                {
-                  for(i = 0; i < 128; ++i)
-                     flashram->data[(flashram->erase_offset+i)^S8]= dram[(flashram->write_pointer+i)^S8];
+                  dma_copy(flashram->data, flashram->erase_offset,
+                        dram, flashram->write_pointer, 128);
                   flashram_save(flashram);
                }
                break;
@@ -142,7 +143,7 @@ int write_flashram_command(void* opaque, uint32_t address, uint32_t value, uint3
 void dma_read_flashram(struct pi_controller *pi)
 {
    unsigned int dram_addr, cart_addr;
-   unsigned int i, length;
+   unsigned int length;
    struct flashram* flashram = &pi->flashram;
    uint32_t *dram            = pi->ri->rdram.dram;
    uint8_t *mem              = flashram->data;
@@ -152,14 +153,14 @@ void dma_read_flashram(struct pi_controller *pi)
       case FLASHRAM_MODE_STATUS:
          dram[pi->regs[PI_DRAM_ADDR_REG]/4]   = (uint32_t)(flashram->status >> 32);
          dram[pi->regs[PI_DRAM_ADDR_REG]/4+1] = (uint32_t)(flashram->status);
+         savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, pi->regs[PI_DRAM_ADDR_REG] & ~UINT32_C(3), 8);
          break;
       case FLASHRAM_MODE_READ:
          length = (pi->regs[PI_WR_LEN_REG] & 0xffffff) + 1;
          dram_addr = pi->regs[PI_DRAM_ADDR_REG];
          cart_addr = ((pi->regs[PI_CART_ADDR_REG]-0x08000000)&0xffff)*2;
 
-         for (i = 0; i < length; ++i)
-            ((uint8_t*)dram)[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
+         dma_copy((uint8_t*)dram, dram_addr, mem, cart_addr, length);
          break;
       default:
          DebugMessage(M64MSG_WARNING, "unknown dma_read_flashram: %x", flashram->mode);
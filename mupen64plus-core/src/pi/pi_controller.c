@@ -24,6 +24,7 @@
 #define M64P_CORE_PROTOTYPES 1
 #include "../api/callbacks.h"
 #include "../api/m64p_types.h"
+#include "../main/device.h"
 #include "../main/main.h"
 #include "../memory/memory.h"
 #include "../r4300/cp0.h"
@@ -56,7 +57,7 @@ static void dma_pi_read(struct pi_controller *pi)
          i -= 0x400;
          length = (i + length) > 0x100 ? (0x100 - i) : length;
          rom_address = (pi->regs[PI_CART_ADDR_REG] - 0x05000400) & 0x3fffff;
-         rom = g_dd.sec_buf;
+         rom = g_dev.dd.sec_buf;
       }
       else
       {
@@ -72,8 +73,7 @@ static void dma_pi_read(struct pi_controller *pi)
       dram_address = pi->regs[PI_DRAM_ADDR_REG];
       dram = (uint8_t*)pi->ri->rdram.dram;
 
-      for (i = 0; i < length; ++i)
-         rom[(rom_address + i) ^ S8] = dram[(dram_address + i) ^ S8];
+      dma_copy(rom, rom_address, dram, dram_address, length);
    }
    else if (pi->regs[PI_CART_ADDR_REG] >= 0x08000000
          && pi->regs[PI_CART_ADDR_REG] < 0x08010000)
@@ -133,14 +133,14 @@ static void dma_pi_write(struct pi_controller *pi)
             i -= 0x400;
             length = (i + length) > 0x100 ? (0x100 - i) : length;
             rom_address = (pi->regs[PI_CART_ADDR_REG] - 0x05000400) & 0x3fffff;
-            rom = g_dd.sec_buf;
+            rom = g_dev.dd.sec_buf;
          }
          else if (pi->regs[PI_CART_ADDR_REG] == 0x05000000)
          {
             /* C2 BUFFER */
             rom_address = (pi->regs[PI_CART_ADDR_REG] - 0x05000000) & 0x3fffff;
             length      = (i + length) > 0x400 ? (0x400 - i) : length;
-            rom         = g_dd.c2_buf;
+            rom         = g_dev.dd.c2_buf;
          }
          else
          {
@@ -157,8 +157,7 @@ static void dma_pi_write(struct pi_controller *pi)
          dram_address = pi->regs[PI_DRAM_ADDR_REG];
          dram = (uint8_t*)pi->ri->rdram.dram;
 
-         for (i = 0; i < length; ++i)
-            dram[(dram_address + i) ^ S8] = rom[(rom_address + i) ^ S8];
+         dma_copy(dram, dram_address, rom, rom_address, length);
 
          invalidate_r4300_cached_code(0x80000000 + dram_address, length);
          invalidate_r4300_cached_code(0xa0000000 + dram_address, length);
@@ -239,8 +238,7 @@ static void dma_pi_write(struct pi_controller *pi)
       rom = pi->cart_rom.rom;
    }
 
-   for (i = 0; i < length; ++i)
-      dram[(dram_address + i) ^ S8] = rom[(rom_address + i) ^ S8];
+   dma_copy(dram, dram_address, rom, rom_address, length);
 
    invalidate_r4300_cached_code(0x80000000 + dram_address, length);
    invalidate_r4300_cached_code(0xa0000000 + dram_address, length);
@@ -303,12 +301,12 @@ int write_pi_regs(void* opaque, uint32_t address,
       {
          if (value == 0x05000000)
          {
-            g_dd.regs[ASIC_CMD_STATUS] &= ~0x1C000000;
+            g_dev.dd.regs[ASIC_CMD_STATUS] &= ~0x1C000000;
             dd_pi_test();
          }
          else if (value == 0x05000400)
          {
-            g_dd.regs[ASIC_CMD_STATUS] &= ~0x4C000000;
+            g_dev.dd.regs[ASIC_CMD_STATUS] &= ~0x4C000000;
             dd_pi_test();
          }
          break;
@@ -352,6 +350,6 @@ void pi_end_of_dma_event(struct pi_controller* pi)
 
    if ((pi->regs[PI_CART_ADDR_REG] == 0x05000000) || (pi->regs[PI_CART_ADDR_REG] == 0x05000400))
    {
-      dd_update_bm(&g_dd);
+      dd_update_bm(&g_dev.dd);
    }
 }
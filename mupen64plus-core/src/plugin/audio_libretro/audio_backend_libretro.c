@@ -22,11 +22,14 @@
 #include "api/m64p_types.h"
 #include "api/libretro.h"
 #include "ai/ai_controller.h"
+#include "main/device.h"
 #include "main/main.h"
 #include "main/rom.h"
 #include "plugin/plugin.h"
 #include "ri/ri_controller.h"
 
+#include "libretro_perf.h"
+
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -97,10 +100,10 @@ void init_audio_libretro(unsigned max_audio_frames)
 void set_audio_format_via_libretro(void* user_data,
       unsigned int frequency, unsigned int bits)
 {
-   uint32_t saved_ai_dacrate = g_ai.regs[AI_DACRATE_REG];
+   uint32_t saved_ai_dacrate = g_dev.ai.regs[AI_DACRATE_REG];
 
    /* notify plugin of the new frequency (can't do the same for bits) */
-   g_ai.regs[AI_DACRATE_REG] = (ROM_PARAMS.aidacrate / frequency) - 1;
+   g_dev.ai.regs[AI_DACRATE_REG] = (ROM_PARAMS.aidacrate / frequency) - 1;
 
    GameFreq        = frequency;
    BytesPerSecond  = frequency * 4;
@@ -112,7 +115,7 @@ void set_audio_format_via_libretro(void* user_data,
 #endif
 
    /* restore original registers values */
-   g_ai.regs[AI_DACRATE_REG] = saved_ai_dacrate;
+   g_dev.ai.regs[AI_DACRATE_REG] = saved_ai_dacrate;
 }
 
 /* Abuse core & audio plugin implementation details to obtain the desired effect. */
@@ -128,13 +131,13 @@ void push_audio_samples_via_libretro(void* user_data, const void* buffer, size_t
    uint8_t *p        = (uint8_t*)buffer;
 
    /* save registers values */
-   uint32_t saved_ai_length = g_ai.regs[AI_LEN_REG];
-   uint32_t saved_ai_dram = g_ai.regs[AI_DRAM_ADDR_REG];
+   uint32_t saved_ai_length = g_dev.ai.regs[AI_LEN_REG];
+   uint32_t saved_ai_dram = g_dev.ai.regs[AI_DRAM_ADDR_REG];
 
    /* notify plugin of new samples to play.
-    * Exploit the fact that buffer points in g_rdram to retreive dram_addr_reg value */
-   g_ai.regs[AI_DRAM_ADDR_REG] = (uint8_t*)buffer - (uint8_t*)g_rdram;
-   g_ai.regs[AI_LEN_REG] = size;
+    * Exploit the fact that buffer points in g_dev.rdram to retreive dram_addr_reg value */
+   g_dev.ai.regs[AI_DRAM_ADDR_REG] = (uint8_t*)buffer - (uint8_t*)g_dev.rdram;
+   g_dev.ai.regs[AI_LEN_REG] = size;
 
    for (i = 0; i < size; i += 4)
    {
@@ -165,9 +168,11 @@ audio_batch:
    data.input_frames = frames;
    data.ratio        = ratio;
 
+   perf_counter_start(PERF_AUDIO_RESAMPLE);
    convert_s16_to_float(audio_in_buffer_float, raw_data, frames * 2, 1.0f);
    resampler->process(resampler_audio_data, &data);
    convert_float_to_s16(audio_out_buffer_s16, audio_out_buffer_float, data.output_frames * 2);
+   perf_counter_stop(PERF_AUDIO_RESAMPLE);
 
    out                    = audio_out_buffer_s16;
 
@@ -185,6 +190,6 @@ audio_batch:
    }
 
    /* restore original registers vlaues */
-   g_ai.regs[AI_LEN_REG]       = saved_ai_length;
-   g_ai.regs[AI_DRAM_ADDR_REG] = saved_ai_dram;
+   g_dev.ai.regs[AI_LEN_REG]       = saved_ai_length;
+   g_dev.ai.regs[AI_DRAM_ADDR_REG] = saved_ai_dram;
 }
@@ -41,6 +41,7 @@ extern struct retro_rumble_interface rumble;
 extern int pad_pak_types[4];
 extern int pad_present[4];
 extern int astick_deadzone;
+extern int rewind_button;
 
 extern m64p_rom_header ROM_HEADER;
 
@@ -328,6 +329,9 @@ static void inputGetKeys_reuse(int16_t analogX, int16_t analogY, int Control, BU
 
    if (input_cb(Control, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_SELECT) && --timeout <= 0)
       inputInitiateCallback((const char*)ROM_HEADER.Name);
+
+   if (input_cb(Control, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_L3))
+      rewind_button = 1;
 }
 
 
@@ -0,0 +1,179 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - block_profiler.c                                        *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2016 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#if defined(PROFILE_BLOCKS)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block_profiler.h"
+
+#include "api/callbacks.h"
+#include "api/m64p_config.h"
+#include "api/m64p_types.h"
+#include "cp0_private.h"
+#include "main/util.h"
+#include "r4300.h"
+
+#define PROFILE_SLOTS (1 << 16)
+
+struct profile_block
+{
+   uint32_t addr;
+   uint32_t used;
+   uint64_t count;
+   uint64_t cycles;
+};
+
+static struct profile_block table[PROFILE_SLOTS];
+static struct profile_block *current;
+static uint32_t current_start;
+static unsigned int used_slots;
+static uint64_t dropped;
+
+static struct profile_block *find_block(uint32_t addr)
+{
+   uint32_t s = (addr >> 2) * UINT32_C(0x9E3779B1) & (PROFILE_SLOTS - 1);
+
+   while (table[s].used)
+   {
+      if (table[s].addr == addr)
+         return &table[s];
+      s = (s + 1) & (PROFILE_SLOTS - 1);
+   }
+
+   /* keep a free slot so that the probe above always terminates */
+   if (used_slots >= PROFILE_SLOTS - 1)
+      return NULL;
+
+   used_slots++;
+   table[s].used = 1;
+   table[s].addr = addr;
+   return &table[s];
+}
+
+void block_profiler_reset(void)
+{
+   memset(table, 0, sizeof(table));
+   current = NULL;
+   used_slots = 0;
+   dropped = 0;
+}
+
+void block_profiler_enter(uint32_t addr)
+{
+   uint32_t now = g_cp0_regs[CP0_COUNT_REG];
+
+   /* cycles since the previous taken jump belong to its target */
+   if (current != NULL)
+      current->cycles += (uint32_t)(now - current_start);
+
+   current = find_block(addr);
+   current_start = now;
+
+   if (current != NULL)
+      current->count++;
+   else
+      dropped++;
+}
+
+void block_profiler_enter_last(void)
+{
+   block_profiler_enter(last_addr);
+}
+
+static int by_cycles(const void *a, const void *b)
+{
+   const struct profile_block *x = (const struct profile_block *)a;
+   const struct profile_block *y = (const struct profile_block *)b;
+
+   if (x->cycles != y->cycles)
+      return x->cycles < y->cycles ? 1 : -1;
+   return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static FILE *open_output(const char *md5, const char *suffix)
+{
+   const char *dir = ConfigGetUserCachePath();
+   char *filename, *path;
+   FILE *f;
+
+   if (dir == NULL || (filename = formatstr("%s.blocks.%s", md5, suffix)) == NULL)
+      return NULL;
+   path = combinepath(dir, filename);
+   free(filename);
+   if (path == NULL)
+      return NULL;
+
+   f = fopen(path, "w");
+   if (f == NULL)
+      DebugMessage(M64MSG_WARNING, "Couldn't open block profile %s for writing", path);
+   else
+      DebugMessage(M64MSG_INFO, "Writing block profile to %s", path);
+   free(path);
+   return f;
+}
+
+void block_profiler_dump(const char *md5)
+{
+   struct profile_block *sorted;
+   FILE *folded, *csv;
+   unsigned int i, n = 0;
+
+   if (md5 == NULL || md5[0] == '\0' || used_slots == 0)
+      return;
+
+   sorted = (struct profile_block *) malloc(used_slots * sizeof(*sorted));
+   if (sorted == NULL)
+      return;
+   for (i = 0; i < PROFILE_SLOTS; i++)
+      if (table[i].used)
+         sorted[n++] = table[i];
+   qsort(sorted, n, sizeof(*sorted), by_cycles);
+
+   /* flamegraph.pl input: one "rom;block cycles" line per block */
+   if ((folded = open_output(md5, "folded")) != NULL)
+   {
+      for (i = 0; i < n; i++)
+         if (sorted[i].cycles)
+            fprintf(folded, "%s;0x%08X %llu\n", md5, (unsigned int)sorted[i].addr,
+                  (unsigned long long)sorted[i].cycles);
+      fclose(folded);
+   }
+
+   if ((csv = open_output(md5, "csv")) != NULL)
+   {
+      fprintf(csv, "md5,pc,count,cycles\n");
+      for (i = 0; i < n; i++)
+         fprintf(csv, "%s,0x%08X,%llu,%llu\n", md5, (unsigned int)sorted[i].addr,
+               (unsigned long long)sorted[i].count, (unsigned long long)sorted[i].cycles);
+      fclose(csv);
+   }
+
+   if (dropped)
+      DebugMessage(M64MSG_WARNING, "Block profile table full, %llu entries not recorded",
+            (unsigned long long)dropped);
+
+   free(sorted);
+}
+
+#endif /* PROFILE_BLOCKS */
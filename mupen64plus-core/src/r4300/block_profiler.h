@@ -0,0 +1,44 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - block_profiler.h                                        *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2016 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_R4300_BLOCK_PROFILER_H
+#define M64P_R4300_BLOCK_PROFILER_H
+
+#include <stdint.h>
+
+/* Counts how often each jump target is entered and how many COUNT
+ * cycles run until the next taken jump, then writes the totals for the
+ * ROM as a folded stack file and as CSV. Build with -DPROFILE_BLOCKS. */
+
+#if defined(PROFILE_BLOCKS)
+void block_profiler_reset(void);
+void block_profiler_enter(uint32_t addr);
+/* Same, for the target the dynarec just stored in last_addr. */
+void block_profiler_enter_last(void);
+/* Writes <cache dir>/<md5>.blocks.folded and <md5>.blocks.csv */
+void block_profiler_dump(const char *md5);
+#else
+#define block_profiler_reset()
+#define block_profiler_enter(addr)
+#define block_profiler_dump(md5)
+#endif
+
+#endif /* M64P_R4300_BLOCK_PROFILER_H */
@@ -29,18 +29,22 @@
 #include "api/callbacks.h"
 #include "api/debugger.h"
 #include "api/m64p_types.h"
+#include "block_profiler.h"
 #include "cached_interp.h"
 #include "cp0_private.h"
 #include "cp1_private.h"
 #include "exception.h"
+#include "idle_loop.h"
 #include "interupt.h"
 #include "macros.h"
+#include "main/device.h"
 #include "main/main.h"
 #include "memory/memory.h"
 #include "ops.h"
 #include "r4300.h"
 #include "recomp.h"
 #include "tlb.h"
+#include "translation_cache.h"
 
 #ifdef DBG
 #include "debugger/dbg_debugger.h"
@@ -87,6 +91,7 @@ uint32_t jump_to_address;
          delay_slot=0; \
          if (take_jump && !skip_jump) \
          { \
+            block_profiler_enter(jump_target); \
             PC=actual->block+((jump_target-actual->start)>>2); \
          } \
       } \
@@ -118,6 +123,7 @@ uint32_t jump_to_address;
          delay_slot=0; \
          if (take_jump && !skip_jump) \
          { \
+            block_profiler_enter(jump_target); \
             jump_to(jump_target); \
          } \
       } \
@@ -132,22 +138,26 @@ uint32_t jump_to_address;
    static void name##_IDLE(void) \
    { \
       const int take_jump = (condition); \
+      const uint32_t jump_target = (destination); \
       int skip; \
       if (cop1 && check_cop1_unusable()) return; \
       if (take_jump) \
       { \
          cp0_update_count(); \
          skip = next_interupt - g_cp0_regs[CP0_COUNT_REG]; \
-         if (skip > 3) g_cp0_regs[CP0_COUNT_REG] += (skip & UINT32_C(0xFFFFFFFC)); \
-         else name(); \
+         if (skip > 3 && (jump_target == PCADDR \
+                  || idle_loop_is_waiting(jump_target, PCADDR))) \
+         { \
+            g_cp0_regs[CP0_COUNT_REG] += (skip & UINT32_C(0xFFFFFFFC)); \
+            if (jump_target == PCADDR) return; \
+         } \
       } \
-      else name(); \
+      name(); \
    }
 
 #define CHECK_MEMORY() \
    if (!invalid_code[address>>12]) \
-      if (blocks[address>>12]->block[(address&0xFFF)/4].ops != \
-          current_instruction_table.NOTCOMPILED) \
+      if (block_has_code(blocks[address>>12], (address&0xFFF)/4, (address&0xFFF)/4)) \
          invalid_code[address>>12] = 1;
 
 // two functions are defined from the macros above but never used
@@ -209,7 +219,14 @@ static void NOTCOMPILED(void)
 #endif
 
    if (mem != NULL)
-      recompile_block(mem, blocks[PC->addr >> 12], PC->addr);
+   {
+      translation_cache_enter(blocks[PC->addr >> 12], mem, PC->addr);
+
+      /* the translation cache may already have compiled this address */
+      if (PC->ops == current_instruction_table.NOTCOMPILED
+            || PC->ops == current_instruction_table.NOTCOMPILED2)
+         recompile_block(mem, blocks[PC->addr >> 12], PC->addr);
+   }
    else
       DebugMessage(M64MSG_ERROR, "not compiled exception");
 
@@ -230,6 +247,237 @@ static void NOTCOMPILED2(void)
    NOTCOMPILED();
 }
 
+// -----------------------------------------------------------
+// Superinstructions
+// -----------------------------------------------------------
+/* Common pairs of dependent instructions executed with a single dispatch:
+ * - LUI and an ADDIU/ORI of its result, loading a 32-bit constant;
+ * - LUI and a load/store using it as base, accessing a fixed address;
+ * - SLT* and a BEQ/BNE testing its result.
+ * The second instruction keeps its own entry so jumps into the pair still
+ * work, and isn't run when the first one was in a delay slot. */
+#define DECLARE_PAIR(first, second) \
+   static void first##_##second(void) \
+   { \
+      first(); \
+      if (!delay_slot) \
+         second(); \
+   }
+
+DECLARE_PAIR(LUI, ADDIU)
+DECLARE_PAIR(LUI, ORI)
+DECLARE_PAIR(LUI, LB)
+DECLARE_PAIR(LUI, LBU)
+DECLARE_PAIR(LUI, LH)
+DECLARE_PAIR(LUI, LHU)
+DECLARE_PAIR(LUI, LW)
+DECLARE_PAIR(LUI, SB)
+DECLARE_PAIR(LUI, SH)
+DECLARE_PAIR(LUI, SW)
+DECLARE_PAIR(SLT, BEQ)
+DECLARE_PAIR(SLT, BNE)
+DECLARE_PAIR(SLTU, BEQ)
+DECLARE_PAIR(SLTU, BNE)
+DECLARE_PAIR(SLTI, BEQ)
+DECLARE_PAIR(SLTI, BNE)
+DECLARE_PAIR(SLTIU, BEQ)
+DECLARE_PAIR(SLTIU, BNE)
+
+#define FUSE(first, second) \
+   if (inst->ops == cached_interpreter_table.first \
+         && next->ops == cached_interpreter_table.second) \
+   { \
+      inst->ops = first##_##second; \
+      continue; \
+   }
+
+void fuse_superinstructions(precomp_instr *first, precomp_instr *end)
+{
+#ifndef DBG
+   precomp_instr *inst;
+
+   for (inst = first; inst + 1 < end; inst++)
+   {
+      const precomp_instr *next = inst + 1;
+
+      if (inst->ops == cached_interpreter_table.LUI)
+      {
+         if (next->f.i.rs != inst->f.i.rt)
+            continue;
+         FUSE(LUI, ADDIU) FUSE(LUI, ORI)
+         FUSE(LUI, LB) FUSE(LUI, LBU) FUSE(LUI, LH) FUSE(LUI, LHU) FUSE(LUI, LW)
+         FUSE(LUI, SB) FUSE(LUI, SH) FUSE(LUI, SW)
+      }
+      else if (inst->ops == cached_interpreter_table.SLT
+            || inst->ops == cached_interpreter_table.SLTU)
+      {
+         if (next->f.i.rs != inst->f.r.rd && next->f.i.rt != inst->f.r.rd)
+            continue;
+         FUSE(SLT, BEQ) FUSE(SLT, BNE) FUSE(SLTU, BEQ) FUSE(SLTU, BNE)
+      }
+      else if (inst->ops == cached_interpreter_table.SLTI
+            || inst->ops == cached_interpreter_table.SLTIU)
+      {
+         if (next->f.i.rs != inst->f.i.rt && next->f.i.rt != inst->f.i.rt)
+            continue;
+         FUSE(SLTI, BEQ) FUSE(SLTI, BNE) FUSE(SLTIU, BEQ) FUSE(SLTIU, BNE)
+      }
+   }
+#endif
+}
+
+#undef FUSE
+#undef DECLARE_PAIR
+
+// -----------------------------------------------------------
+// Threaded dispatch
+// -----------------------------------------------------------
+/* CORE_CACHED_THREADED runs the cached interpreter's precomp_instr blocks
+ * like r4300_step() does, it only changes how the next instruction is
+ * dispatched. pure_interp.c is left alone: it decodes every word on each
+ * execution, which is what makes it the reference core.
+ *
+ * Instructions run inline by the threaded dispatch, in dispatch order.
+ * Their index is kept in precomp_instr.local_addr, 0 meaning a call
+ * through ops like the cached interpreter does. */
+#define THREADED_INLINE_OPS(X) \
+   X(NOP) X(ADDIU) X(SLTI) X(SLTIU) X(ANDI) X(ORI) X(XORI) X(LUI) \
+   X(SLL) X(SRL) X(SRA) X(ADDU) X(SUBU) X(AND) X(OR) X(XOR) X(NOR) \
+   X(SLT) X(SLTU)
+
+static void (*const threaded_inline_ops[])(void) = {
+   NULL,
+#define X(name) name,
+   THREADED_INLINE_OPS(X)
+#undef X
+};
+
+void cached_threaded_annotate(precomp_instr *first, precomp_instr *end)
+{
+   const unsigned int count = sizeof(threaded_inline_ops) / sizeof(threaded_inline_ops[0]);
+   precomp_instr *inst;
+   unsigned int i;
+
+   for (inst = first; inst < end; inst++)
+   {
+      inst->local_addr = 0;
+      for (i = 1; i < count; i++)
+      {
+         if (inst->ops == threaded_inline_ops[i])
+         {
+            inst->local_addr = i;
+            break;
+         }
+      }
+   }
+}
+
+/* Same execution as r4300_step(), but dispatching with computed gotos
+ * so that simple ALU instructions need neither a call nor a return.
+ * Only calls through ops can set stop, so it is checked after those. */
+void cached_interpreter_threaded(void)
+{
+#if defined(__GNUC__) && !defined(DBG)
+   static void *const labels[] = {
+      &&fallback,
+#define X(name) &&op_##name,
+      THREADED_INLINE_OPS(X)
+#undef X
+   };
+#define DISPATCH() goto *labels[PC->local_addr]
+
+   if (stop)
+      return;
+   DISPATCH();
+
+fallback:
+   PC->ops();
+   if (stop)
+      return;
+   DISPATCH();
+
+op_NOP:
+   ADD_TO_PC(1);
+   DISPATCH();
+op_ADDIU:
+   irt = SE32(irs32 + iimmediate);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SLTI:
+   irt = irs < iimmediate;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SLTIU:
+   irt = (uint64_t) irs < (uint64_t) ((int64_t) iimmediate);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_ANDI:
+   irt = irs & (uint16_t) iimmediate;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_ORI:
+   irt = irs | (uint16_t) iimmediate;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_XORI:
+   irt = irs ^ (uint16_t) iimmediate;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_LUI:
+   irt = SE32(iimmediate << 16);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SLL:
+   rrd = SE32((uint32_t) rrt32 << rsa);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SRL:
+   rrd = SE32((uint32_t) rrt32 >> rsa);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SRA:
+   rrd = SE32((int32_t) rrt32 >> rsa);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_ADDU:
+   rrd = SE32(rrs32 + rrt32);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SUBU:
+   rrd = SE32(rrs32 - rrt32);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_AND:
+   rrd = rrs & rrt;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_OR:
+   rrd = rrs | rrt;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_XOR:
+   rrd = rrs ^ rrt;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_NOR:
+   rrd = ~(rrs | rrt);
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SLT:
+   rrd = rrs < rrt;
+   ADD_TO_PC(1);
+   DISPATCH();
+op_SLTU:
+   rrd = (uint64_t) rrs < (uint64_t) rrt;
+   ADD_TO_PC(1);
+   DISPATCH();
+
+#undef DISPATCH
+#else
+   r4300_step();
+#endif
+}
+
 // -----------------------------------------------------------
 // Cached interpreter instruction table
 // -----------------------------------------------------------
@@ -546,18 +794,20 @@ void jump_to_func(void)
    actual = blocks[addr>>12];
    if (invalid_code[addr>>12])
    {
-      if (!blocks[addr>>12])
+      if (!blocks[addr>>12] && !(actual = new_block(addr)))
       {
-         blocks[addr>>12] = (precomp_block *) malloc(sizeof(precomp_block));
-         actual = blocks[addr>>12];
-         blocks[addr>>12]->code = NULL;
-         blocks[addr>>12]->block = NULL;
-         blocks[addr>>12]->jumps_table = NULL;
-         blocks[addr>>12]->riprel_table = NULL;
+         stop = 1;
+         return;
       }
       blocks[addr>>12]->start = addr & ~0xFFF;
       blocks[addr>>12]->end = (addr & ~0xFFF) + 0x1000;
       init_block(blocks[addr>>12]);
+      /* out of memory, init_block() has already said so */
+      if (!actual->block)
+      {
+         stop = 1;
+         return;
+      }
    }
    PC=actual->block+((addr-actual->start)>>2);
 
@@ -565,68 +815,152 @@ void jump_to_func(void)
 }
 #undef addr
 
-void init_blocks(void)
+/* precomp_blocks and the cached interpreter's instruction arrays are
+ * carved out of chunked arenas. Blocks are never released one by one,
+ * only all together by free_blocks(). */
+#define BLOCK_CHUNK_COUNT 256
+#define INSTR_CHUNK_SIZE  (4 * 1024 * 1024)
+
+struct block_chunk
+{
+   struct block_chunk *next;
+   unsigned int used;
+   precomp_block blocks[BLOCK_CHUNK_COUNT];
+};
+
+struct instr_chunk
+{
+   struct instr_chunk *next;
+   size_t used;
+   size_t size;
+};
+
+#define INSTR_CHUNK_HEADER ((sizeof(struct instr_chunk) + 15) & ~(size_t)15)
+
+static struct block_chunk *block_chunks = NULL;
+static struct instr_chunk *instr_chunks = NULL;
+
+precomp_block *new_block(uint32_t addr)
 {
-   int i;
-   for (i=0; i<0x100000; i++)
+   struct block_chunk *chunk = block_chunks;
+   precomp_block *block;
+
+   if (!chunk || chunk->used == BLOCK_CHUNK_COUNT)
    {
-      invalid_code[i] = 1;
-      blocks[i] = NULL;
+      chunk = (struct block_chunk *) malloc(sizeof(struct block_chunk));
+      if (!chunk)
+      {
+         DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate code blocks.");
+         return NULL;
+      }
+      chunk->next = block_chunks;
+      chunk->used = 0;
+      block_chunks = chunk;
    }
+
+   block = &chunk->blocks[chunk->used++];
+   block->code = NULL;
+   block->block = NULL;
+   block->jumps_table = NULL;
+   block->riprel_table = NULL;
+   block->links_in = NULL;
+   block->links_out = NULL;
+   block->tcache_hash_valid = 0;
+   block->start = addr & ~UINT32_C(0xFFF);
+   block->end = (addr & ~UINT32_C(0xFFF)) + UINT32_C(0x1000);
+
+   blocks[addr>>12] = block;
+   return block;
+}
+
+void *alloc_block_instructions(size_t size)
+{
+   struct instr_chunk *chunk = instr_chunks;
+   void *mem;
+
+   /* keep every array aligned like malloc() would */
+   size = (size + 15) & ~(size_t)15;
+
+   if (!chunk || chunk->size - chunk->used < size)
+   {
+      size_t chunk_size = size > INSTR_CHUNK_SIZE ? size : INSTR_CHUNK_SIZE;
+
+      chunk = (struct instr_chunk *) malloc(INSTR_CHUNK_HEADER + chunk_size);
+      if (!chunk)
+         return NULL;
+      chunk->next = instr_chunks;
+      chunk->used = 0;
+      chunk->size = chunk_size;
+      instr_chunks = chunk;
+   }
+
+   mem = (unsigned char *)chunk + INSTR_CHUNK_HEADER + chunk->used;
+   chunk->used += size;
+   return mem;
+}
+
+void init_blocks(void)
+{
+   memset(invalid_code, 1, sizeof(invalid_code));
+   memset(blocks, 0, sizeof(blocks));
 }
 
 void free_blocks(void)
 {
-   int i;
-   for (i=0; i<0x100000; i++)
+   unsigned int i;
+
+   while (block_chunks)
    {
-      if (blocks[i])
-      {
-         free_block(blocks[i]);
-         free(blocks[i]);
-         blocks[i] = NULL;
-      }
+      struct block_chunk *chunk = block_chunks;
+
+      for (i = 0; i < chunk->used; i++)
+         free_block(&chunk->blocks[i]);
+
+      block_chunks = chunk->next;
+      free(chunk);
    }
+
+   while (instr_chunks)
+   {
+      struct instr_chunk *chunk = instr_chunks;
+      instr_chunks = chunk->next;
+      free(chunk);
+   }
+
+   memset(blocks, 0, sizeof(blocks));
+   free_code_cache();
 }
 
 void invalidate_cached_code_hacktarux(uint32_t address, size_t size)
 {
-   size_t i;
-   uint32_t addr;
-   uint32_t addr_max;
+   uint32_t page;
+   uint32_t first_page;
+   uint32_t last_page;
+   uint32_t last;
 
    if (size == 0)
    {
       /* invalidate everthing */
       memset(invalid_code, 1, 0x100000);
+      return;
    }
-   else
+
+   /* invalidate pages holding compiled code in [address, address+size) */
+   last       = address + (uint32_t)size - 1;
+   first_page = address >> 12;
+   last_page  = last >> 12;
+
+   for (page = first_page; page <= last_page; page++)
    {
-      /* invalidate blocks (if necessary) */
-      addr_max = address+size;
+      unsigned int first_word = (page == first_page) ? (address & 0xfff) / 4 : 0;
+      unsigned int last_word  = (page == last_page) ? (last & 0xfff) / 4 : 0x3ff;
 
-      for(addr = address; addr < addr_max; addr += 4)
-      {
-         i = (addr >> 12);
+      if (invalid_code[page])
+         continue;
 
-         if (invalid_code[i] == 0)
-         {
-            if (blocks[i] == NULL
-                  || blocks[i]->block[(addr & 0xfff) / 4].ops != current_instruction_table.NOTCOMPILED)
-            {
-               invalid_code[i] = 1;
-               /* go directly to next i */
-               addr &= ~0xfff;
-               addr |= 0xffc;
-            }
-         }
-         else
-         {
-            /* go directly to next i */
-            addr &= ~0xfff;
-            addr |= 0xffc;
-         }
-      }
+      if (blocks[page] == NULL
+            || block_has_code(blocks[page], first_word, last_word))
+         invalid_code[page] = 1;
    }
 }
 
@@ -37,8 +37,22 @@ extern const cpu_instruction_table cached_interpreter_table;
 
 void init_blocks(void);
 void free_blocks(void);
+
+/* Allocates the block for the page holding addr and stores it in blocks[].
+ * Never returns NULL: running out of memory here is fatal. */
+precomp_block *new_block(uint32_t addr);
+/* Instruction arrays of the cached interpreter, released by free_blocks(). */
+void *alloc_block_instructions(size_t size);
 void jump_to_func(void);
 
+/* Replaces common instruction pairs in [first, end) by superinstructions. */
+void fuse_superinstructions(precomp_instr *first, precomp_instr *end);
+
+/* Records in [first, end) which instructions the threaded dispatch
+ * (CORE_CACHED_THREADED) runs inline; must follow any change of their ops. */
+void cached_threaded_annotate(precomp_instr *first, precomp_instr *end);
+void cached_interpreter_threaded(void);
+
 void invalidate_cached_code_hacktarux(uint32_t address, size_t size);
 
 /* Jumps to the given address. This is for the cached interpreter / dynarec. */
@@ -21,6 +21,7 @@
 
 #include <stdint.h>
 
+#include "fpu.h"
 #include "new_dynarec/new_dynarec.h"
 
 #if NEW_DYNAREC != NEW_DYNAREC_ARM
@@ -44,6 +45,10 @@ int64_t reg_cop1_fgr_64[32];
  * using 32-bit stores. */
 uint32_t rounding_mode = UINT32_C(0x33F);
 
+/* FCR31 rounding mode the host FPU was last switched to by
+ * set_rounding() or the x86_64 dynarec's CTC1, -1 if unknown. */
+int host_rounding = -1;
+
 
 int64_t* r4300_cp1_regs(void)
 {
@@ -170,6 +175,25 @@ void set_fpr_pointers(uint32_t newStatus)
    }
 }
 
+/* Switches the host back to the C default, round to nearest. */
+void reset_host_rounding(void)
+{
+#ifndef VITA
+   fesetround(FE_TONEAREST);
+#endif
+   host_rounding = -1;
+}
+
+/* The host mode is thread state shared with the frontend and the
+ * plugins, so it has to be re-applied after running their code. The
+ * x86_64 dynarec's SSE2 arithmetic relies on it being right at all
+ * times, it never calls set_rounding() itself. */
+void restore_host_rounding(void)
+{
+   host_rounding = -1;
+   set_rounding();
+}
+
 /* XXX: This shouldn't really be here, but rounding_mode is used by the
  * Hacktarux JIT and updated by CTC1 and saved states. Figure out a better
  * place for this. */
@@ -190,4 +214,7 @@ void update_x86_rounding_mode(uint32_t FCR31)
          rounding_mode = UINT32_C(0x73F);
          break;
    }
+
+   /* callers have just set FCR31 */
+   set_rounding();
 }
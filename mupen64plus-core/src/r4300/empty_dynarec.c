@@ -564,6 +564,10 @@ void genbeq_idle()
 {
 }
 
+void genidle_loop()
+{
+}
+
 void genbnel()
 {
 }
@@ -1038,6 +1042,21 @@ void dyna_jump()
 {
 }
 
+precomp_block *link_source = NULL;
+unsigned int link_site;
+
+void dyna_link_jump(void)
+{
+}
+
+void dyna_unlink_block(precomp_block *block)
+{
+}
+
+void dyna_unlink_incoming(precomp_block *block)
+{
+}
+
 void dyna_stop()
 {
 }
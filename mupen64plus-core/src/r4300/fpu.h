@@ -58,10 +58,17 @@
 #define FCR31_CMP_BIT UINT32_C(0x800000)
 
 
+/* Writing the host control register (MXCSR, FPCR, x87 CW) is costly and
+ * FCR31 rarely changes, so it is only done when the mode differs from
+ * the one applied last. */
 M64P_FPU_INLINE void set_rounding(void)
 {
    /* TODO skogaby: fix this for real */
 #ifndef VITA
+   if ((int)(FCR31 & 3) == host_rounding)
+      return;
+   host_rounding = FCR31 & 3;
+
    switch(FCR31 & 3)
    {
       case 0: /* Round to nearest, or to even if equidistant */
@@ -317,6 +317,34 @@ static INLINE void cmp_reg64_imm8(int reg64, unsigned char imm8)
    put8(imm8);
 }
 
+static INLINE void test_reg64_reg64(int reg1, int reg2)
+{
+   put8(0x48);
+   put8(0x85);
+   put8((reg2 << 3) | reg1 | 0xC0);
+}
+
+static INLINE void cmp_m8rel_imm8(unsigned char *m8, unsigned char imm8)
+{
+   int offset = rel_r15_offset(m8, "cmp_m8rel_imm8");
+
+   put8(0x41);
+   put8(0x80);
+   put8(0xBF);
+   put32(offset);
+   put8(imm8);
+}
+
+/* jmp qword [rip+0] followed by the 64-bit destination, which can be
+ * rewritten later without re-encoding the instruction */
+static INLINE void jmp_abs64(uint64_t addr)
+{
+   put8(0xFF);
+   put8(0x25);
+   put32(0);
+   put64(addr);
+}
+
 static INLINE void mov_rax_memoffs64(uint64_t *memoffs64)
 {
    put8(0x48);
@@ -382,6 +410,64 @@ static INLINE void cmp_xreg64_m64rel(int xreg64, uint64_t *m64)
    put8(0x87 | ((xreg64 & 7) << 3));
    put32(offset);
 }
+
+static INLINE void or_m32rel_xreg32(unsigned int *m32, unsigned int xreg32)
+{
+   int offset = rel_r15_offset(m32, "or_m32rel_xreg32");
+
+   put8(0x41 | ((xreg32 & 8) >> 1));
+   put8(0x09);
+   put8(0x87 | ((xreg32 & 7) << 3));
+   put32(offset);
+}
+
+static INLINE void ldmxcsr_m32rel(unsigned int *m32)
+{
+   int offset = rel_r15_offset(m32, "ldmxcsr_m32rel");
+
+   put8(0x41);
+   put8(0x0F);
+   put8(0xAE);
+   put8(0x97);
+   put32(offset);
+}
+
+static INLINE void stmxcsr_m32rel(unsigned int *m32)
+{
+   int offset = rel_r15_offset(m32, "stmxcsr_m32rel");
+
+   put8(0x41);
+   put8(0x0F);
+   put8(0xAE);
+   put8(0x9F);
+   put32(offset);
+}
+
+/* scalar SSE2 operations between xmm0-7 and [reg64], like the x87 ones
+ * above only for rax-rdi (but rsp and rbp) */
+static INLINE void sse_xmm_preg64(unsigned char prefix, unsigned char opcode, int xmm, int reg64)
+{
+   put8(prefix);
+   put8(0x0F);
+   put8(opcode);
+   put8((xmm << 3) | reg64);
+}
+
+static INLINE void movss_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF3, 0x10, xmm, reg64); }
+static INLINE void movss_preg64_xmm(int reg64, int xmm)  { sse_xmm_preg64(0xF3, 0x11, xmm, reg64); }
+static INLINE void addss_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF3, 0x58, xmm, reg64); }
+static INLINE void mulss_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF3, 0x59, xmm, reg64); }
+static INLINE void subss_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF3, 0x5C, xmm, reg64); }
+static INLINE void divss_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF3, 0x5E, xmm, reg64); }
+static INLINE void sqrtss_xmm_preg64(int xmm, int reg64) { sse_xmm_preg64(0xF3, 0x51, xmm, reg64); }
+
+static INLINE void movsd_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF2, 0x10, xmm, reg64); }
+static INLINE void movsd_preg64_xmm(int reg64, int xmm)  { sse_xmm_preg64(0xF2, 0x11, xmm, reg64); }
+static INLINE void addsd_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF2, 0x58, xmm, reg64); }
+static INLINE void mulsd_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF2, 0x59, xmm, reg64); }
+static INLINE void subsd_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF2, 0x5C, xmm, reg64); }
+static INLINE void divsd_xmm_preg64(int xmm, int reg64)  { sse_xmm_preg64(0xF2, 0x5E, xmm, reg64); }
+static INLINE void sqrtsd_xmm_preg64(int xmm, int reg64) { sse_xmm_preg64(0xF2, 0x51, xmm, reg64); }
 #else
 static INLINE void or_reg32_reg32(unsigned int reg1, unsigned int reg2)
 {
@@ -566,13 +652,6 @@ static INLINE void sbb_reg32_reg32(int reg1, int reg2)
    put8((reg2 << 3) | reg1 | 0xC0);
 }
 
-static INLINE void sub_reg32_imm32(int reg32, unsigned int imm32)
-{
-   put8(0x81);
-   put8(0xE8 + reg32);
-   put32(imm32);
-}
-
 static INLINE void mov_m32_reg32(unsigned int *m32, unsigned int reg32)
 {
    put8(0x89);
@@ -776,6 +855,13 @@ static INLINE void sub_reg64_reg64(int reg1, int reg2)
    put8((reg2 << 3) | reg1 | 0xC0);
 }
 
+static INLINE void sub_reg32_imm32(int reg32, unsigned int imm32)
+{
+   put8(0x81);
+   put8(0xE8 + reg32);
+   put32(imm32);
+}
+
 static INLINE void sub_reg64_imm32(int reg64, unsigned int imm32)
 {
    put8(0x48);
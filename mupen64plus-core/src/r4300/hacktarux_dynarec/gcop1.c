@@ -41,6 +41,11 @@ const uint16_t round_mode = 0x33F;
 const uint16_t ceil_mode  = 0xB3F;
 const uint16_t floor_mode = 0x73F;
 
+#ifdef __x86_64__
+/* MXCSR as read and written back by CTC1 */
+static unsigned int mxcsr;
+#endif
+
 void genmfc1(void)
 {
 #ifdef INTERPRET_MFC1
@@ -183,6 +188,18 @@ void genctc1(void)
    mov_m32rel_imm32((unsigned int*)&rounding_mode, 0x73F); // 11
    
    fldcw_m16rel((uint16_t*)&rounding_mode);
+
+   /* The single and double arithmetic uses SSE2, set MXCSR.RC as well:
+    * mode 0 to 3 maps to RC 0, 3, 2, 1. Both host modes now match FCR31,
+    * which set_rounding() can rely on. */
+   mov_m32rel_xreg32((unsigned int*)&host_rounding, EAX);
+   neg_reg32(EAX);
+   and_eax_imm32(3);
+   shl_reg32_imm8(EAX, 13);
+   stmxcsr_m32rel(&mxcsr);
+   and_m32rel_imm32(&mxcsr, ~UINT32_C(0x6000));
+   or_m32rel_xreg32(&mxcsr, EAX);
+   ldmxcsr_m32rel(&mxcsr);
 #else
    mov_eax_memoffs32((unsigned int*)dst->f.r.rt);
    mov_memoffs32_eax((unsigned int*)&FCR31);
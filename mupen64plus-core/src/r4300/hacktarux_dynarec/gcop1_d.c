@@ -38,11 +38,11 @@ void genadd_d(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fs]));
-   fld_preg64_qword(RAX);
+   movsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.ft]));
-   fadd_preg64_qword(RAX);
+   addsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fd]));
-   fstp_preg64_qword(RAX);
+   movsd_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg32_qword(EAX);
@@ -62,11 +62,11 @@ void gensub_d(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fs]));
-   fld_preg64_qword(RAX);
+   movsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.ft]));
-   fsub_preg64_qword(RAX);
+   subsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fd]));
-   fstp_preg64_qword(RAX);
+   movsd_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg32_qword(EAX);
@@ -86,11 +86,11 @@ void genmul_d(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fs]));
-   fld_preg64_qword(RAX);
+   movsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.ft]));
-   fmul_preg64_qword(RAX);
+   mulsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fd]));
-   fstp_preg64_qword(RAX);
+   movsd_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg32_qword(EAX);
@@ -110,11 +110,11 @@ void gendiv_d(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fs]));
-   fld_preg64_qword(RAX);
+   movsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.ft]));
-   fdiv_preg64_qword(RAX);
+   divsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fd]));
-   fstp_preg64_qword(RAX);
+   movsd_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg32_qword(EAX);
@@ -134,10 +134,9 @@ void gensqrt_d(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fs]));
-   fld_preg64_qword(RAX);
-   fsqrt();
+   sqrtsd_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_double[dst->f.cf.fd]));
-   fstp_preg64_qword(RAX);
+   movsd_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg32_qword(EAX);
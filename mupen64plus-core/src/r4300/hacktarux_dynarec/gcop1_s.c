@@ -41,11 +41,11 @@ void genadd_s(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fs]));
-   fld_preg64_dword(RAX);
+   movss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.ft]));
-   fadd_preg64_dword(RAX);
+   addss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fd]));
-   fstp_preg64_dword(RAX);
+   movss_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg32_dword(EAX);
@@ -65,11 +65,11 @@ void gensub_s(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fs]));
-   fld_preg64_dword(RAX);
+   movss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.ft]));
-   fsub_preg64_dword(RAX);
+   subss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fd]));
-   fstp_preg64_dword(RAX);
+   movss_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg32_dword(EAX);
@@ -89,11 +89,11 @@ void genmul_s(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fs]));
-   fld_preg64_dword(RAX);
+   movss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.ft]));
-   fmul_preg64_dword(RAX);
+   mulss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fd]));
-   fstp_preg64_dword(RAX);
+   movss_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg32_dword(EAX);
@@ -113,11 +113,11 @@ void gendiv_s(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fs]));
-   fld_preg64_dword(RAX);
+   movss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.ft]));
-   fdiv_preg64_dword(RAX);
+   divss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fd]));
-   fstp_preg64_dword(RAX);
+   movss_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg32_dword(EAX);
@@ -137,10 +137,9 @@ void gensqrt_s(void)
    gencheck_cop1_unusable();
 #ifdef __x86_64__
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fs]));
-   fld_preg64_dword(RAX);
-   fsqrt();
+   sqrtss_xmm_preg64(0, RAX);
    mov_xreg64_m64rel(RAX, (uint64_t *)(&reg_cop1_simple[dst->f.cf.fd]));
-   fstp_preg64_dword(RAX);
+   movss_preg64_xmm(RAX, 0);
 #else
    mov_eax_memoffs32((unsigned int *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg32_dword(EAX);
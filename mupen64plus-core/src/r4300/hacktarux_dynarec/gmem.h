@@ -0,0 +1,118 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - gmem.h                                                  *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2007 Richard Goedeken (Richard42)                       *
+ *   Copyright (C) 2002 Hacktarux                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __GMEM_H__
+#define __GMEM_H__
+
+#include "assemble.h"
+
+/* Points the 8-bit relative jump emitted just before code offset from
+ * at the current code offset. */
+static INLINE void gen_rdram_test_land(unsigned int from)
+{
+   (*inst_pointer)[from - 1] = (unsigned char)(code_length - from);
+}
+
+/* Emits the test deciding whether a load or store may access g_dev.rdram
+ * directly: ZF is left set if it may. With fast_memory, a direct-mapped
+ * RDRAM address is enough, except within the range that has held
+ * framebuffers, where the handler of the 64KB region is checked like when
+ * fast_memory is off. The address is in both tmp and addr; tmp is trashed. */
+#ifdef __x86_64__
+static INLINE void gen_rdram_test(int tmp, int addr, int table, int scratch, void (*rdram_handler)(void))
+{
+   unsigned int not_rdram = 0, in_range = 0, done = 0;
+
+   if (fast_memory)
+   {
+      and_reg32_imm32(tmp, 0xDF800000);
+      cmp_reg32_imm32(tmp, 0x80000000);
+      if (fast_memory_fb_end <= fast_memory_fb_start)
+         return;
+      jne_rj(0);
+      not_rdram = code_length;
+
+      mov_reg32_reg32(tmp, addr);
+      and_reg32_imm32(tmp, 0x7FFFFF);
+      sub_reg32_imm32(tmp, fast_memory_fb_start);
+      cmp_reg32_imm32(tmp, fast_memory_fb_end - fast_memory_fb_start);
+      jb_rj(0);
+      in_range = code_length;
+      cmp_reg32_reg32(tmp, tmp);
+      jmp_imm_short(0);
+      done = code_length;
+
+      gen_rdram_test_land(in_range);
+      mov_reg32_reg32(tmp, addr);
+   }
+   mov_reg64_imm64(scratch, (uint64_t) rdram_handler);
+   shr_reg32_imm8(tmp, 16);
+   mov_reg64_preg64x8preg64(tmp, tmp, table);
+   cmp_reg64_reg64(tmp, scratch);
+
+   if (done)
+   {
+      gen_rdram_test_land(not_rdram);
+      gen_rdram_test_land(done);
+   }
+}
+#else
+/* The address is in both EAX and EBX; EAX is trashed. */
+static INLINE void gen_rdram_test(unsigned int table, unsigned int rdram_handler)
+{
+   unsigned int not_rdram = 0, in_range = 0, done = 0;
+
+   if (fast_memory)
+   {
+      and_eax_imm32(0xDF800000);
+      cmp_eax_imm32(0x80000000);
+      if (fast_memory_fb_end <= fast_memory_fb_start)
+         return;
+      jne_rj(0);
+      not_rdram = code_length;
+
+      mov_reg32_reg32(EAX, EBX);
+      and_eax_imm32(0x7FFFFF);
+      sub_eax_imm32(fast_memory_fb_start);
+      cmp_eax_imm32(fast_memory_fb_end - fast_memory_fb_start);
+      jb_rj(0);
+      in_range = code_length;
+      cmp_reg32_reg32(EAX, EAX);
+      jmp_imm_short(0);
+      done = code_length;
+
+      gen_rdram_test_land(in_range);
+      mov_reg32_reg32(EAX, EBX);
+   }
+   shr_reg32_imm8(EAX, 16);
+   mov_reg32_preg32x4pimm32(EAX, EAX, table);
+   cmp_reg32_imm32(EAX, rdram_handler);
+
+   if (done)
+   {
+      gen_rdram_test_land(not_rdram);
+      gen_rdram_test_land(done);
+   }
+}
+#endif
+
+#endif /* __GMEM_H__ */
@@ -21,13 +21,16 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include "assemble.h"
+#include "gmem.h"
 #include "regcache.h"
 #include "interpret.h"
 
 #include "api/debugger.h"
+#include "main/device.h"
 #include "main/main.h"
 #include "memory/memory.h"
 #include "r4300/r4300.h"
+#include "r4300/block_profiler.h"
 #include "r4300/cached_interp.h"
 #include "r4300/cp0_private.h"
 #include "r4300/cp1_private.h"
@@ -79,6 +82,21 @@ static void genupdate_count(unsigned int addr)
 #endif
 }
 
+/* Reports the jump target just stored in last_addr to the block
+ * profiler. The register cache must be empty. */
+void genprofile_block(void)
+{
+#if defined(PROFILE_BLOCKS)
+#ifdef __x86_64__
+   mov_reg64_imm64(RAX, (uint64_t) block_profiler_enter_last);
+   call_reg64(RAX);
+#else
+   mov_reg32_imm32(EAX, (unsigned int) block_profiler_enter_last);
+   call_reg32(EAX);
+#endif
+#endif
+}
+
 static void gencheck_interupt(uint64_t instr_structure)
 {
 #ifdef __x86_64__
@@ -103,6 +121,60 @@ static void gencheck_interupt(uint64_t instr_structure)
 #endif
 }
 
+#ifdef __x86_64__
+/* Leaves the block for naddr. Direct-mapped targets get a site that
+ * dyna_link_jump() can later patch into a jump straight to the target's
+ * code; the run time checks send it back through jump_to_func() whenever
+ * the target page got invalidated or an exception is pending. The
+ * offsets of the patched immediates are the LINK_* constants in rjump.c. */
+static void genlink_out(unsigned int naddr)
+{
+   unsigned int site, slow[4];
+   int i;
+
+   if (naddr < 0x80000000 || naddr >= 0xC0000000)
+   {
+      mov_m32rel_imm32(&jump_to_address, naddr);
+      mov_reg64_imm64(RAX, (uint64_t) (dst+1));
+      mov_m64rel_xreg64((uint64_t *)(&PC), RAX);
+      mov_reg64_imm64(RAX, (uint64_t) jump_to_func);
+      call_reg64(RAX);
+      return;
+   }
+
+   site = code_length;
+   mov_reg64_imm64(RAX, 0); /* target block, 0 while unlinked */
+   test_reg64_reg64(RAX, RAX);
+   je_rj(0);
+   slow[0] = code_length;
+   cmp_m32rel_imm32((unsigned int *)(&skip_jump), 0);
+   jne_rj(0);
+   slow[1] = code_length;
+   cmp_m8rel_imm8((unsigned char *)&invalid_code[naddr>>12], 0);
+   jne_rj(0);
+   slow[2] = code_length;
+   cmp_m8rel_imm8((unsigned char *)&invalid_code[(naddr^0x20000000)>>12], 0);
+   jne_rj(0);
+   slow[3] = code_length;
+   mov_m64rel_xreg64((uint64_t *)(&actual), RAX);
+   mov_reg64_imm64(RAX, 0); /* target instruction */
+   mov_m64rel_xreg64((uint64_t *)(&PC), RAX);
+   jmp_abs64(0); /* target code */
+
+   for (i = 0; i < 4; i++)
+      (*inst_pointer)[slow[i]-1] = (unsigned char) (code_length - slow[i]);
+
+   mov_reg64_imm64(RAX, (uint64_t) dst_block);
+   mov_m64rel_xreg64((uint64_t *)(&link_source), RAX);
+   mov_m32rel_imm32(&link_site, site);
+   mov_m32rel_imm32(&jump_to_address, naddr);
+   mov_reg64_imm64(RAX, (uint64_t) (dst+1));
+   mov_m64rel_xreg64((uint64_t *)(&PC), RAX);
+   mov_reg64_imm64(RAX, (uint64_t) dyna_link_jump);
+   call_reg64(RAX);
+}
+#endif
+
 static void gencheck_interupt_out(unsigned int addr)
 {
 #ifdef __x86_64__
@@ -467,7 +539,7 @@ static void ld_register_alloc(int *pGpr1, int *pGpr2, int *pBase1, int *pBase2)
       lock_register(gpr2);                                       // lock the freed gpr2 it so it doesn't get returned in the lru query
    }
    base1 = lock_register(lru_base_register());                  // get another lru register
-   if (!fast_memory)
+   if (!fast_memory || fast_memory_fb_end > fast_memory_fb_start)
    {
       base2 = lock_register(lru_base_register());                // and another one if necessary
       unlock_register(base2);
@@ -632,8 +704,10 @@ void genj(void)
 
 #ifdef __x86_64__
    mov_m32rel_imm32((void*)(&last_addr), naddr);
+   genprofile_block();
 #else
    mov_m32_imm32(&last_addr, naddr);
+   genprofile_block();
 #endif
    gencheck_interupt((native_type) &actual->block[(naddr-actual->start)/4]);
    jmp(naddr);
@@ -659,14 +733,12 @@ void genj_out(void)
 
 #ifdef __x86_64__
    mov_m32rel_imm32((void*)(&last_addr), naddr);
+   genprofile_block();
    gencheck_interupt_out(naddr);
-   mov_m32rel_imm32(&jump_to_address, naddr);
-   mov_reg64_imm64(RAX, (uint64_t) (dst+1));
-   mov_m64rel_xreg64((uint64_t *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (uint64_t)jump_to_func);
-   call_reg64(RAX);
+   genlink_out(naddr);
 #else
    mov_m32_imm32(&last_addr, naddr);
+   genprofile_block();
    gencheck_interupt_out(naddr);
    mov_m32_imm32(&jump_to_address, naddr);
    mov_m32_imm32((unsigned int*)(&PC), (unsigned int)(dst+1));
@@ -736,6 +808,7 @@ void genjal(void)
    naddr = ((dst-1)->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
 
    mov_m32rel_imm32((void*)(&last_addr), naddr);
+   genprofile_block();
 #else
    mov_m32_imm32((unsigned int *)(reg + 31), dst->addr + 4);
    if (((dst->addr + 4) & 0x80000000))
@@ -746,6 +819,7 @@ void genjal(void)
    naddr = ((dst-1)->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
 
    mov_m32_imm32(&last_addr, naddr);
+   genprofile_block();
 #endif
    gencheck_interupt((native_type) &actual->block[(naddr-actual->start)/4]);
    jmp(naddr);
@@ -778,12 +852,9 @@ void genjal_out(void)
    naddr = ((dst-1)->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
 
    mov_m32rel_imm32((void*)(&last_addr), naddr);
+   genprofile_block();
    gencheck_interupt_out(naddr);
-   mov_m32rel_imm32(&jump_to_address, naddr);
-   mov_reg64_imm64(RAX, (uint64_t) (dst+1));
-   mov_m64rel_xreg64((uint64_t *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (uint64_t) jump_to_func);
-   call_reg64(RAX);
+   genlink_out(naddr);
 #else
    mov_m32_imm32((unsigned int *)(reg + 31), dst->addr + 4);
    if (((dst->addr + 4) & 0x80000000))
@@ -794,6 +865,7 @@ void genjal_out(void)
    naddr = ((dst-1)->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
 
    mov_m32_imm32(&last_addr, naddr);
+   genprofile_block();
    gencheck_interupt_out(naddr);
    mov_m32_imm32(&jump_to_address, naddr);
    mov_m32_imm32((unsigned int*)(&PC), (unsigned int)(dst+1));
@@ -845,6 +917,7 @@ void gentest(void)
    jump_start_rel32();
 
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt((uint64_t) (dst + (dst-1)->f.i.immediate));
    jmp(dst->addr + (dst-1)->f.i.immediate*4);
 
@@ -858,6 +931,7 @@ void gentest(void)
    jump_start_rel32();
 
    mov_m32_imm32(&last_addr, dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt((unsigned int)(dst + (dst-1)->f.i.immediate));
    jmp(dst->addr + (dst-1)->f.i.immediate*4);
 
@@ -895,12 +969,9 @@ void gentest_out(void)
    jump_start_rel32();
 
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt_out(dst->addr + (dst-1)->f.i.immediate*4);
-   mov_m32rel_imm32(&jump_to_address, dst->addr + (dst-1)->f.i.immediate*4);
-   mov_reg64_imm64(RAX, (uint64_t) (dst+1));
-   mov_m64rel_xreg64((uint64_t *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (uint64_t) jump_to_func);
-   call_reg64(RAX);
+   genlink_out(dst->addr + (dst-1)->f.i.immediate*4);
    jump_end_rel32();
 
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + 4);
@@ -911,6 +982,7 @@ void gentest_out(void)
    jump_start_rel32();
 
    mov_m32_imm32(&last_addr, dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt_out(dst->addr + (dst-1)->f.i.immediate*4);
    mov_m32_imm32(&jump_to_address, dst->addr + (dst-1)->f.i.immediate*4);
    mov_m32_imm32((unsigned int*)(&PC), (unsigned int)(dst+1));
@@ -1001,6 +1073,13 @@ void genbeq_idle(void)
 #endif
 }
 
+/* Polling loops (see idle_loop.h) go through the interpreter's _IDLE
+ * handler, which checks the polled addresses before skipping time. */
+void genidle_loop(void)
+{
+   gencallinterp((native_type)dst->ops, 1);
+}
+
 void genbne(void)
 {
 #ifdef INTERPRET_BNE
@@ -1355,6 +1434,7 @@ void gentestl(void)
 
    gendelayslot();
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt((uint64_t) (dst + (dst-1)->f.i.immediate));
    jmp(dst->addr + (dst-1)->f.i.immediate*4);
 
@@ -1370,6 +1450,7 @@ void gentestl(void)
 
    gendelayslot();
    mov_m32_imm32(&last_addr, dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt((unsigned int)(dst + (dst-1)->f.i.immediate));
    jmp(dst->addr + (dst-1)->f.i.immediate*4);
 
@@ -1410,13 +1491,9 @@ void gentestl_out(void)
 
    gendelayslot();
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt_out(dst->addr + (dst-1)->f.i.immediate*4);
-   mov_m32rel_imm32(&jump_to_address, dst->addr + (dst-1)->f.i.immediate*4);
-
-   mov_reg64_imm64(RAX, (uint64_t) (dst+1));
-   mov_m64rel_xreg64((uint64_t *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (uint64_t) jump_to_func);
-   call_reg64(RAX);
+   genlink_out(dst->addr + (dst-1)->f.i.immediate*4);
 
    jump_end_rel32();
 
@@ -1430,6 +1507,7 @@ void gentestl_out(void)
 
    gendelayslot();
    mov_m32_imm32(&last_addr, dst->addr + (dst-1)->f.i.immediate*4);
+   genprofile_block();
    gencheck_interupt_out(dst->addr + (dst-1)->f.i.immediate*4);
    mov_m32_imm32(&jump_to_address, dst->addr + (dst-1)->f.i.immediate*4);
    mov_m32_imm32((unsigned int*)(&PC), (unsigned int)(dst+1));
@@ -1710,32 +1788,22 @@ void genldl(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmemd);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdramd);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmemd, (unsigned int)read_rdramd);
    je_rj(51);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_imm32((unsigned int *)(&rdword), (unsigned int)dst->f.i.rt); // 10
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmemd); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmemd); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(dst->f.i.rt)); // 5
    mov_reg32_m32(ECX, (unsigned int *)(dst->f.i.rt)+1); // 6
    jmp_imm_short(18); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_reg32_preg32pimm32(EAX, EBX, ((unsigned int)g_rdram)+4); // 6
-   mov_reg32_preg32pimm32(ECX, EBX, ((unsigned int)g_rdram)); // 6
+   mov_reg32_preg32pimm32(EAX, EBX, ((unsigned int)g_dev.rdram)+4); // 6
+   mov_reg32_preg32pimm32(ECX, EBX, ((unsigned int)g_dev.rdram)); // 6
 
    set_64_register_state(EAX, ECX, (unsigned int*)dst->f.i.rt, 1);
 #endif
@@ -1760,19 +1828,8 @@ void genlb(void)
 
    ld_register_alloc(&gpr1, &gpr2, &base1, &base2);
 
-   mov_reg64_imm64(base1, (uint64_t) readmemb);
-   if(fast_memory)
-   {
-      and_reg32_imm32(gpr1, 0xDF800000);
-      cmp_reg32_imm32(gpr1, 0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(base2, (uint64_t) read_rdramb);
-      shr_reg32_imm8(gpr1, 16);
-      mov_reg64_preg64x8preg64(gpr1, gpr1, base1);
-      cmp_reg64_reg64(gpr1, base2);
-   }
+   mov_reg64_imm64(base1, (uint64_t) g_dev.mem.readmemb);
+   gen_rdram_test(gpr1, gpr2, base1, base2, read_rdramb);
    je_rj(0);
    jump_start_rel8();
 
@@ -1788,7 +1845,7 @@ void genlb(void)
    jmp_imm_short(24);
 
    jump_end_rel8();
-   mov_reg64_imm64(base1, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(base1, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(gpr2, 0x7FFFFF); // 6
    xor_reg8_imm8(gpr2, 3); // 4
    movsx_reg32_8preg64preg64(gpr1, gpr2, base1); // 4
@@ -1800,31 +1857,21 @@ void genlb(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmemb);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdramb);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmemb, (unsigned int)read_rdramb);
    je_rj(47);
 
    mov_m32_imm32((unsigned int *)&PC, (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_imm32((unsigned int *)(&rdword), (unsigned int)dst->f.i.rt); // 10
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmemb); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmemb); // 7
    call_reg32(EBX); // 2
    movsx_reg32_m8(EAX, (unsigned char *)dst->f.i.rt); // 7
    jmp_imm_short(16); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 3); // 3
-   movsx_reg32_8preg32pimm32(EAX, EBX, (unsigned int)g_rdram); // 7
+   movsx_reg32_8preg32pimm32(EAX, EBX, (unsigned int)g_dev.rdram); // 7
 
    set_register_state(EAX, (unsigned int*)dst->f.i.rt, 1, 0);
 #endif
@@ -1842,19 +1889,8 @@ void genlh(void)
 
    ld_register_alloc(&gpr1, &gpr2, &base1, &base2);
 
-   mov_reg64_imm64(base1, (uint64_t) readmemh);
-   if(fast_memory)
-   {
-      and_reg32_imm32(gpr1, 0xDF800000);
-      cmp_reg32_imm32(gpr1, 0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(base2, (uint64_t) read_rdramh);
-      shr_reg32_imm8(gpr1, 16);
-      mov_reg64_preg64x8preg64(gpr1, gpr1, base1);
-      cmp_reg64_reg64(gpr1, base2);
-   }
+   mov_reg64_imm64(base1, (uint64_t) g_dev.mem.readmemh);
+   gen_rdram_test(gpr1, gpr2, base1, base2, read_rdramh);
    je_rj(0);
    jump_start_rel8();
 
@@ -1870,7 +1906,7 @@ void genlh(void)
    jmp_imm_short(24);
 
    jump_end_rel8();   
-   mov_reg64_imm64(base1, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(base1, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(gpr2, 0x7FFFFF); // 6
    xor_reg8_imm8(gpr2, 2); // 4
    movsx_reg32_16preg64preg64(gpr1, gpr2, base1); // 4
@@ -1882,31 +1918,21 @@ void genlh(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmemh);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdramh);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmemh, (unsigned int)read_rdramh);
    je_rj(47);
 
    mov_m32_imm32((unsigned int *)&PC, (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_imm32((unsigned int *)(&rdword), (unsigned int)dst->f.i.rt); // 10
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmemh); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmemh); // 7
    call_reg32(EBX); // 2
    movsx_reg32_m16(EAX, (unsigned short *)dst->f.i.rt); // 7
    jmp_imm_short(16); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 2); // 3
-   movsx_reg32_16preg32pimm32(EAX, EBX, (unsigned int)g_rdram); // 7
+   movsx_reg32_16preg32pimm32(EAX, EBX, (unsigned int)g_dev.rdram); // 7
 
    set_register_state(EAX, (unsigned int*)dst->f.i.rt, 1, 0);
 #endif
@@ -1929,22 +1955,11 @@ void genlw(void)
 
    ld_register_alloc(&gpr1, &gpr2, &base1, &base2);
 
-   mov_reg64_imm64(base1, (uint64_t) readmem);
-   if(fast_memory)
-   {
-      and_reg32_imm32(gpr1, 0xDF800000);
-      cmp_reg32_imm32(gpr1, 0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(base2, (uint64_t) read_rdram);
-      shr_reg32_imm8(gpr1, 16);
-      mov_reg64_preg64x8preg64(gpr1, gpr1, base1);
-      cmp_reg64_reg64(gpr1, base2);
-   }
+   mov_reg64_imm64(base1, (uint64_t) g_dev.mem.readmem);
+   gen_rdram_test(gpr1, gpr2, base1, base2, read_rdram);
    jne_rj(21);
 
-   mov_reg64_imm64(base1, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(base1, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(gpr2, 0x7FFFFF); // 6
    mov_reg32_preg64preg64(gpr1, gpr2, base1); // 3
    jmp_imm_short(0); // 2
@@ -1969,30 +1984,20 @@ void genlw(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmem);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdram);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmem, (unsigned int)read_rdram);
    je_rj(45);
 
    mov_m32_imm32((unsigned int *)&PC, (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_imm32((unsigned int *)(&rdword), (unsigned int)dst->f.i.rt); // 10
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmem); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmem); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(dst->f.i.rt)); // 5
    jmp_imm_short(12); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_rdram); // 6
+   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_dev.rdram); // 6
 
    set_register_state(EAX, (unsigned int*)dst->f.i.rt, 1, 0);
 #endif
@@ -2010,19 +2015,8 @@ void genlbu(void)
 
    ld_register_alloc(&gpr1, &gpr2, &base1, &base2);
 
-   mov_reg64_imm64(base1, (uint64_t) readmemb);
-   if(fast_memory)
-   {
-      and_reg32_imm32(gpr1, 0xDF800000);
-      cmp_reg32_imm32(gpr1, 0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(base2, (uint64_t) read_rdramb);
-      shr_reg32_imm8(gpr1, 16);
-      mov_reg64_preg64x8preg64(gpr1, gpr1, base1);
-      cmp_reg64_reg64(gpr1, base2);
-   }
+   mov_reg64_imm64(base1, (uint64_t) g_dev.mem.readmemb);
+   gen_rdram_test(gpr1, gpr2, base1, base2, read_rdramb);
    je_rj(0);
    jump_start_rel8();
 
@@ -2038,7 +2032,7 @@ void genlbu(void)
    jmp_imm_short(23);
 
    jump_end_rel8();
-   mov_reg64_imm64(base1, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(base1, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(gpr2, 0x7FFFFF); // 6
    xor_reg8_imm8(gpr2, 3); // 4
    mov_reg32_preg64preg64(gpr1, gpr2, base1); // 3
@@ -2051,31 +2045,21 @@ void genlbu(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmemb);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdramb);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmemb, (unsigned int)read_rdramb);
    je_rj(46);
 
    mov_m32_imm32((unsigned int *)&PC, (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_imm32((unsigned int *)(&rdword), (unsigned int)dst->f.i.rt); // 10
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmemb); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmemb); // 7
    call_reg32(EBX); // 2
    mov_reg32_m32(EAX, (unsigned int *)dst->f.i.rt); // 6
    jmp_imm_short(15); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 3); // 3
-   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_rdram); // 6
+   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_dev.rdram); // 6
 
    and_eax_imm32(0xFF);
 
@@ -2095,19 +2079,8 @@ void genlhu(void)
 
    ld_register_alloc(&gpr1, &gpr2, &base1, &base2);
 
-   mov_reg64_imm64(base1, (uint64_t) readmemh);
-   if(fast_memory)
-   {
-      and_reg32_imm32(gpr1, 0xDF800000);
-      cmp_reg32_imm32(gpr1, 0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(base2, (uint64_t) read_rdramh);
-      shr_reg32_imm8(gpr1, 16);
-      mov_reg64_preg64x8preg64(gpr1, gpr1, base1);
-      cmp_reg64_reg64(gpr1, base2);
-   }
+   mov_reg64_imm64(base1, (uint64_t) g_dev.mem.readmemh);
+   gen_rdram_test(gpr1, gpr2, base1, base2, read_rdramh);
    je_rj(0);
    jump_start_rel8();
 
@@ -2123,7 +2096,7 @@ void genlhu(void)
    jmp_imm_short(23);
 
    jump_end_rel8();
-   mov_reg64_imm64(base1, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(base1, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(gpr2, 0x7FFFFF); // 6
    xor_reg8_imm8(gpr2, 2); // 4
    mov_reg32_preg64preg64(gpr1, gpr2, base1); // 3
@@ -2136,31 +2109,21 @@ void genlhu(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmemh);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdramh);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmemh, (unsigned int)read_rdramh);
    je_rj(46);
 
    mov_m32_imm32((unsigned int *)&PC, (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_imm32((unsigned int *)(&rdword), (unsigned int)dst->f.i.rt); // 10
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmemh); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmemh); // 7
    call_reg32(EBX); // 2
    mov_reg32_m32(EAX, (unsigned int *)dst->f.i.rt); // 6
    jmp_imm_short(15); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 2); // 3
-   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_rdram); // 6
+   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_dev.rdram); // 6
 
    and_eax_imm32(0xFFFF);
 
@@ -2185,19 +2148,8 @@ void genlwu(void)
 
    ld_register_alloc(&gpr1, &gpr2, &base1, &base2);
 
-   mov_reg64_imm64(base1, (uint64_t) readmem);
-   if(fast_memory)
-   {
-      and_reg32_imm32(gpr1, 0xDF800000);
-      cmp_reg32_imm32(gpr1, 0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(base2, (uint64_t) read_rdram);
-      shr_reg32_imm8(gpr1, 16);
-      mov_reg64_preg64x8preg64(gpr1, gpr1, base1);
-      cmp_reg64_reg64(gpr1, base2);
-   }
+   mov_reg64_imm64(base1, (uint64_t) g_dev.mem.readmem);
+   gen_rdram_test(gpr1, gpr2, base1, base2, read_rdram);
    je_rj(0);
    jump_start_rel8();
 
@@ -2213,7 +2165,7 @@ void genlwu(void)
    jmp_imm_short(19);
 
    jump_end_rel8();
-   mov_reg64_imm64(base1, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(base1, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(gpr2, 0x7FFFFF); // 6
    mov_reg32_preg64preg64(gpr1, gpr2, base1); // 3
 
@@ -2224,30 +2176,20 @@ void genlwu(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmem);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdram);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmem, (unsigned int)read_rdram);
    je_rj(45);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_imm32((unsigned int *)(&rdword), (unsigned int)dst->f.i.rt); // 10
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmem); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmem); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(dst->f.i.rt)); // 5
    jmp_imm_short(12); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_rdram); // 6
+   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_dev.rdram); // 6
 
    xor_reg32_reg32(EBX, EBX);
 
@@ -2268,19 +2210,8 @@ void gensb(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) writememb);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) write_rdramb);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.writememb);
+   gen_rdram_test(EAX, EBX, RSI, RDI, write_rdramb);
    je_rj(49);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2291,13 +2222,16 @@ void gensb(void)
    mov_reg64_preg64x8preg64(RBX, RBX, RSI);  // 4
    call_reg64(RBX); // 2
    mov_xreg32_m32rel(EAX, (unsigned int *)(&address)); // 7
-   jmp_imm_short(25); // 2
+   jmp_imm_short(42); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 3); // 4
    mov_preg64preg64_reg8(RBX, RSI, CL); // 3
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_reg64_imm64(RSI, (uint64_t) &savestates_dirty[SAVESTATE_DIRTY_RDRAM]); // 10
+   mov_preg64preg64_imm8(RBX, RSI, 1); // 4
 
    mov_reg64_imm64(RSI, (uint64_t) invalid_code);
    mov_reg32_reg32(EBX, EAX);
@@ -2325,32 +2259,24 @@ void gensb(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)writememb);
-      cmp_reg32_imm32(EAX, (unsigned int)write_rdramb);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.writememb, (unsigned int)write_rdramb);
    je_rj(41);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m8_reg8((unsigned char *)(&cpu_byte), CL); // 6
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)writememb); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.writememb); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(&address)); // 5
-   jmp_imm_short(17); // 2
+   jmp_imm_short(27); // 2
 
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 3); // 3
-   mov_preg32pimm32_reg8(EBX, (unsigned int)g_rdram, CL); // 6
+   mov_preg32pimm32_reg8(EBX, (unsigned int)g_dev.rdram, CL); // 6
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_preg32pimm32_imm8(EBX, (unsigned int)&savestates_dirty[SAVESTATE_DIRTY_RDRAM], 1); // 7
 
    mov_reg32_reg32(EBX, EAX);
    shr_reg32_imm8(EBX, 12);
@@ -2384,19 +2310,8 @@ void gensh(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) writememh);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) write_rdramh);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.writememh);
+   gen_rdram_test(EAX, EBX, RSI, RDI, write_rdramh);
    je_rj(50);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2407,13 +2322,16 @@ void gensh(void)
    mov_reg64_preg64x8preg64(RBX, RBX, RSI);  // 4
    call_reg64(RBX); // 2
    mov_xreg32_m32rel(EAX, (unsigned int *)(&address)); // 7
-   jmp_imm_short(26); // 2
+   jmp_imm_short(43); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 2); // 4
    mov_preg64preg64_reg16(RBX, RSI, CX); // 4
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_reg64_imm64(RSI, (uint64_t) &savestates_dirty[SAVESTATE_DIRTY_RDRAM]); // 10
+   mov_preg64preg64_imm8(RBX, RSI, 1); // 4
 
    mov_reg64_imm64(RSI, (uint64_t) invalid_code);
    mov_reg32_reg32(EBX, EAX);
@@ -2441,32 +2359,24 @@ void gensh(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)writememh);
-      cmp_reg32_imm32(EAX, (unsigned int)write_rdramh);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.writememh, (unsigned int)write_rdramh);
    je_rj(42);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m16_reg16((unsigned short *)(&cpu_hword), CX); // 7
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)writememh); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.writememh); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(&address)); // 5
-   jmp_imm_short(18); // 2
+   jmp_imm_short(28); // 2
 
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    xor_reg8_imm8(BL, 2); // 3
-   mov_preg32pimm32_reg16(EBX, (unsigned int)g_rdram, CX); // 7
+   mov_preg32pimm32_reg16(EBX, (unsigned int)g_dev.rdram, CX); // 7
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_preg32pimm32_imm8(EBX, (unsigned int)&savestates_dirty[SAVESTATE_DIRTY_RDRAM], 1); // 7
 
    mov_reg32_reg32(EBX, EAX);
    shr_reg32_imm8(EBX, 12);
@@ -2505,19 +2415,8 @@ void gensw(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) writemem);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) write_rdram);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.writemem);
+   gen_rdram_test(EAX, EBX, RSI, RDI, write_rdram);
    je_rj(49);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2528,12 +2427,15 @@ void gensw(void)
    mov_reg64_preg64x8preg64(RBX, RBX, RSI);  // 4
    call_reg64(RBX); // 2
    mov_xreg32_m32rel(EAX, (unsigned int *)(&address)); // 7
-   jmp_imm_short(21); // 2
+   jmp_imm_short(38); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    mov_preg64preg64_reg32(RBX, RSI, ECX); // 3
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_reg64_imm64(RSI, (uint64_t) &savestates_dirty[SAVESTATE_DIRTY_RDRAM]); // 10
+   mov_preg64preg64_imm8(RBX, RSI, 1); // 4
 
    mov_reg64_imm64(RSI, (uint64_t) invalid_code);
    mov_reg32_reg32(EBX, EAX);
@@ -2561,31 +2463,23 @@ void gensw(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)writemem);
-      cmp_reg32_imm32(EAX, (unsigned int)write_rdram);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.writemem, (unsigned int)write_rdram);
    je_rj(41);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_reg32((unsigned int *)(&cpu_word), ECX); // 6
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)writemem); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.writemem); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(&address)); // 5
-   jmp_imm_short(14); // 2
+   jmp_imm_short(24); // 2
 
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_preg32pimm32_reg32(EBX, (unsigned int)g_rdram, ECX); // 6
+   mov_preg32pimm32_reg32(EBX, (unsigned int)g_dev.rdram, ECX); // 6
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_preg32pimm32_imm8(EBX, (unsigned int)&savestates_dirty[SAVESTATE_DIRTY_RDRAM], 1); // 7
 
    mov_reg32_reg32(EBX, EAX);
    shr_reg32_imm8(EBX, 12);
@@ -2652,19 +2546,8 @@ void genlwc1(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) readmem);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) read_rdram);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.readmem);
+   gen_rdram_test(EAX, EBX, RSI, RDI, read_rdram);
    je_rj(49);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2677,7 +2560,7 @@ void genlwc1(void)
    call_reg64(RBX); // 2
    jmp_imm_short(28); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    mov_reg32_preg64preg64(EAX, RBX, RSI); // 3
    mov_xreg64_m64rel(RBX, (uint64_t *)(&reg_cop1_simple[dst->f.lf.ft])); // 7
@@ -2686,17 +2569,7 @@ void genlwc1(void)
    mov_eax_memoffs32((unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmem);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdram);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmem, (unsigned int)read_rdram);
    je_rj(42);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
@@ -2704,12 +2577,12 @@ void genlwc1(void)
    mov_reg32_m32(EDX, (unsigned int*)(&reg_cop1_simple[dst->f.lf.ft])); // 6
    mov_m32_reg32((unsigned int *)(&rdword), EDX); // 6
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmem); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmem); // 7
    call_reg32(EBX); // 2
    jmp_imm_short(20); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_rdram); // 6
+   mov_reg32_preg32pimm32(EAX, EBX, (unsigned int)g_dev.rdram); // 6
    mov_reg32_m32(EBX, (unsigned int*)(&reg_cop1_simple[dst->f.lf.ft])); // 6
    mov_preg32_reg32(EBX, EAX); // 2
 #endif
@@ -2727,19 +2600,8 @@ void genldc1(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) readmemd);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) read_rdramd);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.readmemd);
+   gen_rdram_test(EAX, EBX, RSI, RDI, read_rdramd);
    je_rj(49);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2752,7 +2614,7 @@ void genldc1(void)
    call_reg64(RBX); // 2
    jmp_imm_short(39); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    mov_reg64_preg64preg64(RAX, RBX, RSI); // 4
    mov_xreg64_m64rel(RBX, (uint64_t *)(&reg_cop1_double[dst->f.lf.ft])); // 7
@@ -2763,17 +2625,7 @@ void genldc1(void)
    mov_eax_memoffs32((unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)readmemd);
-      cmp_reg32_imm32(EAX, (unsigned int)read_rdramd);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.readmemd, (unsigned int)read_rdramd);
    je_rj(42);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
@@ -2781,13 +2633,13 @@ void genldc1(void)
    mov_reg32_m32(EDX, (unsigned int*)(&reg_cop1_double[dst->f.lf.ft])); // 6
    mov_m32_reg32((unsigned int *)(&rdword), EDX); // 6
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)readmemd); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.readmemd); // 7
    call_reg32(EBX); // 2
    jmp_imm_short(32); // 2
 
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_reg32_preg32pimm32(EAX, EBX, ((unsigned int)g_rdram)+4); // 6
-   mov_reg32_preg32pimm32(ECX, EBX, ((unsigned int)g_rdram)); // 6
+   mov_reg32_preg32pimm32(EAX, EBX, ((unsigned int)g_dev.rdram)+4); // 6
+   mov_reg32_preg32pimm32(ECX, EBX, ((unsigned int)g_dev.rdram)); // 6
    mov_reg32_m32(EBX, (unsigned int*)(&reg_cop1_double[dst->f.lf.ft])); // 6
    mov_preg32_reg32(EBX, EAX); // 2
    mov_preg32pimm32_reg32(EBX, 4, ECX); // 6
@@ -2805,19 +2657,8 @@ void genld(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) readmemd);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) read_rdramd);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.readmemd);
+   gen_rdram_test(EAX, EBX, RSI, RDI, read_rdramd);
    je_rj(59);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2831,7 +2672,7 @@ void genld(void)
    mov_xreg64_m64rel(RAX, (uint64_t *)(dst->f.i.rt)); // 7
    jmp_imm_short(33); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
 
    mov_reg32_preg64preg64(EAX, RBX, RSI); // 3
@@ -2856,19 +2697,8 @@ void genswc1(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) writemem);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) write_rdram);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.writemem);
+   gen_rdram_test(EAX, EBX, RSI, RDI, write_rdram);
    je_rj(49);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2879,12 +2709,15 @@ void genswc1(void)
    mov_reg64_preg64x8preg64(RBX, RBX, RSI);  // 4
    call_reg64(RBX); // 2
    mov_xreg32_m32rel(EAX, (unsigned int *)(&address)); // 7
-   jmp_imm_short(21); // 2
+   jmp_imm_short(38); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    mov_preg64preg64_reg32(RBX, RSI, ECX); // 3
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_reg64_imm64(RSI, (uint64_t) &savestates_dirty[SAVESTATE_DIRTY_RDRAM]); // 10
+   mov_preg64preg64_imm8(RBX, RSI, 1); // 4
 
    mov_reg64_imm64(RSI, (uint64_t) invalid_code);
    mov_reg32_reg32(EBX, EAX);
@@ -2911,31 +2744,23 @@ void genswc1(void)
    mov_eax_memoffs32((unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)writemem);
-      cmp_reg32_imm32(EAX, (unsigned int)write_rdram);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.writemem, (unsigned int)write_rdram);
    je_rj(41);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
    mov_m32_reg32((unsigned int *)(&address), EBX); // 6
    mov_m32_reg32((unsigned int *)(&cpu_word), ECX); // 6
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)writemem); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.writemem); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(&address)); // 5
-   jmp_imm_short(14); // 2
+   jmp_imm_short(24); // 2
 
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_preg32pimm32_reg32(EBX, (unsigned int)g_rdram, ECX); // 6
+   mov_preg32pimm32_reg32(EBX, (unsigned int)g_dev.rdram, ECX); // 6
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_preg32pimm32_imm8(EBX, (unsigned int)&savestates_dirty[SAVESTATE_DIRTY_RDRAM], 1); // 7
 
    mov_reg32_reg32(EBX, EAX);
    shr_reg32_imm8(EBX, 12);
@@ -2971,19 +2796,8 @@ void gensdc1(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) writememd);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) write_rdramd);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.writememd);
+   gen_rdram_test(EAX, EBX, RSI, RDI, write_rdramd);
    je_rj(56);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -2995,13 +2809,16 @@ void gensdc1(void)
    mov_reg64_preg64x8preg64(RBX, RBX, RSI);  // 4
    call_reg64(RBX); // 2
    mov_xreg32_m32rel(EAX, (unsigned int *)(&address)); // 7
-   jmp_imm_short(28); // 2
+   jmp_imm_short(45); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    mov_preg64preg64pimm32_reg32(RBX, RSI, 4, ECX); // 7
    mov_preg64preg64_reg32(RBX, RSI, EDX); // 3
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_reg64_imm64(RSI, (uint64_t) &savestates_dirty[SAVESTATE_DIRTY_RDRAM]); // 10
+   mov_preg64preg64_imm8(RBX, RSI, 1); // 4
 
    mov_reg64_imm64(RSI, (uint64_t) invalid_code);
    mov_reg32_reg32(EBX, EAX);
@@ -3029,17 +2846,7 @@ void gensdc1(void)
    mov_eax_memoffs32((unsigned int *)(&reg[dst->f.lf.base]));
    add_eax_imm32((int)dst->f.lf.offset);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)writememd);
-      cmp_reg32_imm32(EAX, (unsigned int)write_rdramd);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.writememd, (unsigned int)write_rdramd);
    je_rj(47);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
@@ -3047,15 +2854,17 @@ void gensdc1(void)
    mov_m32_reg32((unsigned int *)(&cpu_dword), ECX); // 6
    mov_m32_reg32((unsigned int *)(&cpu_dword)+1, EDX); // 6
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)writememd); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.writememd); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(&address)); // 5
-   jmp_imm_short(20); // 2
+   jmp_imm_short(30); // 2
 
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_rdram)+4, ECX); // 6
-   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_rdram)+0, EDX); // 6
+   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_dev.rdram)+4, ECX); // 6
+   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_dev.rdram)+0, EDX); // 6
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_preg32pimm32_imm8(EBX, (unsigned int)&savestates_dirty[SAVESTATE_DIRTY_RDRAM], 1); // 7
 
    mov_reg32_reg32(EBX, EAX);
    shr_reg32_imm8(EBX, 12);
@@ -3091,19 +2900,8 @@ void gensd(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   mov_reg64_imm64(RSI, (uint64_t) writememd);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      mov_reg64_imm64(RDI, (uint64_t) write_rdramd);
-      shr_reg32_imm8(EAX, 16);
-      mov_reg64_preg64x8preg64(RAX, RAX, RSI);
-      cmp_reg64_reg64(RAX, RDI);
-   }
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.mem.writememd);
+   gen_rdram_test(EAX, EBX, RSI, RDI, write_rdramd);
    je_rj(56);
 
    mov_reg64_imm64(RAX, (uint64_t) (dst+1)); // 10
@@ -3115,13 +2913,16 @@ void gensd(void)
    mov_reg64_preg64x8preg64(RBX, RBX, RSI);  // 4
    call_reg64(RBX); // 2
    mov_xreg32_m32rel(EAX, (unsigned int *)(&address)); // 7
-   jmp_imm_short(28); // 2
+   jmp_imm_short(45); // 2
 
-   mov_reg64_imm64(RSI, (uint64_t) g_rdram); // 10
+   mov_reg64_imm64(RSI, (uint64_t) g_dev.rdram); // 10
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
    mov_preg64preg64pimm32_reg32(RBX, RSI, 4, ECX); // 7
    mov_preg64preg64_reg32(RBX, RSI, EDX); // 3
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_reg64_imm64(RSI, (uint64_t) &savestates_dirty[SAVESTATE_DIRTY_RDRAM]); // 10
+   mov_preg64preg64_imm8(RBX, RSI, 1); // 4
 
    mov_reg64_imm64(RSI, (uint64_t) invalid_code);
    mov_reg32_reg32(EBX, EAX);
@@ -3151,17 +2952,7 @@ void gensd(void)
    mov_eax_memoffs32((unsigned int *)dst->f.i.rs);
    add_eax_imm32((int)dst->f.i.immediate);
    mov_reg32_reg32(EBX, EAX);
-   if(fast_memory)
-   {
-      and_eax_imm32(0xDF800000);
-      cmp_eax_imm32(0x80000000);
-   }
-   else
-   {
-      shr_reg32_imm8(EAX, 16);
-      mov_reg32_preg32x4pimm32(EAX, EAX, (unsigned int)writememd);
-      cmp_reg32_imm32(EAX, (unsigned int)write_rdramd);
-   }
+   gen_rdram_test((unsigned int)g_dev.mem.writememd, (unsigned int)write_rdramd);
    je_rj(47);
 
    mov_m32_imm32((unsigned int *)(&PC), (unsigned int)(dst+1)); // 10
@@ -3169,15 +2960,17 @@ void gensd(void)
    mov_m32_reg32((unsigned int *)(&cpu_dword), ECX); // 6
    mov_m32_reg32((unsigned int *)(&cpu_dword)+1, EDX); // 6
    shr_reg32_imm8(EBX, 16); // 3
-   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)writememd); // 7
+   mov_reg32_preg32x4pimm32(EBX, EBX, (unsigned int)g_dev.mem.writememd); // 7
    call_reg32(EBX); // 2
    mov_eax_memoffs32((unsigned int *)(&address)); // 5
-   jmp_imm_short(20); // 2
+   jmp_imm_short(30); // 2
 
    mov_reg32_reg32(EAX, EBX); // 2
    and_reg32_imm32(EBX, 0x7FFFFF); // 6
-   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_rdram)+4, ECX); // 6
-   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_rdram)+0, EDX); // 6
+   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_dev.rdram)+4, ECX); // 6
+   mov_preg32pimm32_reg32(EBX, ((unsigned int)g_dev.rdram)+0, EDX); // 6
+   shr_reg32_imm8(EBX, 12); // 3
+   mov_preg32pimm32_imm8(EBX, (unsigned int)&savestates_dirty[SAVESTATE_DIRTY_RDRAM], 1); // 7
 
    mov_reg32_reg32(EBX, EAX);
    shr_reg32_imm8(EBX, 12);
@@ -223,6 +223,7 @@ void genjr(void)
    mov_m32rel_xreg32((unsigned int *)&last_addr, EAX);
 
    gencheck_interupt_reg();
+   genprofile_block();
 
    mov_xreg32_m32rel(EAX, (unsigned int *)&local_rs);
    mov_reg32_reg32(EBX, EAX);
@@ -285,6 +286,7 @@ void genjr(void)
    mov_memoffs32_eax((unsigned int *)&last_addr);
 
    gencheck_interupt_reg();
+   genprofile_block();
 
    mov_eax_memoffs32((unsigned int *)&local_rs);
    mov_reg32_reg32(EBX, EAX);
@@ -356,6 +358,7 @@ void genjalr(void)
    mov_m32rel_xreg32((unsigned int *)&last_addr, EAX);
 
    gencheck_interupt_reg();
+   genprofile_block();
 
    mov_xreg32_m32rel(EAX, (unsigned int *)&local_rs);
    mov_reg32_reg32(EBX, EAX);
@@ -424,6 +427,7 @@ void genjalr(void)
    mov_memoffs32_eax((unsigned int *)&last_addr);
 
    gencheck_interupt_reg();
+   genprofile_block();
 
    mov_eax_memoffs32((unsigned int *)&local_rs);
    mov_reg32_reg32(EBX, EAX);
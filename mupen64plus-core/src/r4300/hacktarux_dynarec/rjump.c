@@ -21,6 +21,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "assemble.h"
 
@@ -74,6 +75,124 @@ void dyna_jump(void)
         *return_address = (native_type)(actual->code + PC->local_addr);
 }
 
+/* A site emitted by genlink_out() that jumps straight into another
+ * block's code. Each link is on the source block's outgoing list and on
+ * the target block's incoming list, so it can be undone from either end. */
+struct block_link
+{
+    precomp_block *source;
+    precomp_block *target;
+    unsigned int site;
+    struct block_link *next_in, **prev_in;
+    struct block_link *next_out, **prev_out;
+};
+
+/* set by a link site right before calling dyna_link_jump() */
+precomp_block *link_source = NULL;
+unsigned int link_site;
+
+/* offsets of the patchable immediates inside a link site */
+#define LINK_BLOCK_IMM 2
+#define LINK_INSTR_IMM 57
+#define LINK_CODE_IMM  78
+
+static void patch_link_site(precomp_block *source, unsigned int site,
+        precomp_block *target, precomp_instr *instr)
+{
+#if defined(__x86_64__)
+    uint64_t block_imm = (uint64_t) target;
+    uint64_t instr_imm = (uint64_t) instr;
+    uint64_t code_imm = target ? (uint64_t) (target->code + instr->local_addr) : 0;
+
+    memcpy(source->code + site + LINK_BLOCK_IMM, &block_imm, 8);
+    memcpy(source->code + site + LINK_INSTR_IMM, &instr_imm, 8);
+    memcpy(source->code + site + LINK_CODE_IMM, &code_imm, 8);
+#endif
+}
+
+static void free_link(struct block_link *link)
+{
+    if ((*link->prev_in = link->next_in) != NULL)
+        link->next_in->prev_in = link->prev_in;
+    if ((*link->prev_out = link->next_out) != NULL)
+        link->next_out->prev_out = link->prev_out;
+    free(link);
+}
+
+void dyna_link_jump(void)
+{
+    precomp_block *source;
+    struct block_link *link;
+    uint32_t target = jump_to_address;
+    unsigned int site = link_site;
+
+    jump_to_func();
+
+    /* cleared if jump_to_func() reinitialized the source block */
+    source = link_source;
+    link_source = NULL;
+
+    if (source == NULL || source->code == NULL || stop || skip_jump)
+        return;
+    if (PC->addr != target || actual == NULL || actual->code == NULL
+            || invalid_code[target>>12] || invalid_code[(target^0x20000000)>>12]
+            || PC->ops == current_instruction_table.NOTCOMPILED
+            || PC->ops == current_instruction_table.NOTCOMPILED2
+            || PC->reg_cache_infos.need_map)
+        return;
+
+    for (link = source->links_out; link != NULL; link = link->next_out)
+    {
+        if (link->site == site)
+        {
+            free_link(link);
+            break;
+        }
+    }
+
+    link = (struct block_link *) malloc(sizeof(*link));
+    if (link == NULL)
+        return;
+
+    link->source = source;
+    link->target = actual;
+    link->site = site;
+    if ((link->next_in = actual->links_in) != NULL)
+        link->next_in->prev_in = &link->next_in;
+    link->prev_in = &actual->links_in;
+    actual->links_in = link;
+    if ((link->next_out = source->links_out) != NULL)
+        link->next_out->prev_out = &link->next_out;
+    link->prev_out = &source->links_out;
+    source->links_out = link;
+
+    patch_link_site(source, site, actual, PC);
+}
+
+void dyna_unlink_incoming(precomp_block *block)
+{
+    while (block->links_in != NULL)
+    {
+        struct block_link *link = block->links_in;
+
+        if (link->source->code != NULL)
+            patch_link_site(link->source, link->site, NULL, NULL);
+        free_link(link);
+    }
+}
+
+void dyna_unlink_block(precomp_block *block)
+{
+    dyna_unlink_incoming(block);
+
+    /* the sites themselves go away with the block's code */
+    while (block->links_out != NULL)
+        free_link(block->links_out);
+
+    if (link_source == block)
+        link_source = NULL;
+}
+
 #if defined(__x86_64__) && defined(_WIN32) && defined(_MSC_VER)
 #else
 void dyna_start(void *code)
@@ -0,0 +1,185 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - idle_loop.c                                              *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2016 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdint.h>
+
+#include "idle_loop.h"
+
+#include "memory/memory.h"
+#include "r4300.h"
+
+#define OP_OF(w)     ((w) >> 26)
+#define RS_OF(w)     (((w) >> 21) & 0x1F)
+#define RT_OF(w)     (((w) >> 16) & 0x1F)
+#define RD_OF(w)     (((w) >> 11) & 0x1F)
+#define FUNCT_OF(w)  ((w) & 0x3F)
+#define IMM16S_OF(w) ((int16_t) (w))
+
+enum idle_insn_kind
+{
+   IDLE_INSN_INVALID,
+   IDLE_INSN_ALU,
+   IDLE_INSN_LOAD,
+   IDLE_INSN_BRANCH
+};
+
+/* Classifies an instruction and returns the registers it reads and
+ * writes as bit masks. Anything not listed here (stores, COP0 accesses
+ * such as reading COUNT, HI/LO, FPU...) makes the loop non-idle. */
+static int decode(uint32_t w, uint32_t *reads, uint32_t *writes)
+{
+   *reads = 0;
+   *writes = 0;
+
+   switch (OP_OF(w))
+   {
+   case 0x00: /* SPECIAL */
+      switch (FUNCT_OF(w))
+      {
+      case 0x00: case 0x02: case 0x03:             /* SLL, SRL, SRA */
+      case 0x38: case 0x3A: case 0x3B:             /* DSLL, DSRL, DSRA */
+      case 0x3C: case 0x3E: case 0x3F:             /* DSLL32, DSRL32, DSRA32 */
+         *reads = UINT32_C(1) << RT_OF(w);
+         *writes = UINT32_C(1) << RD_OF(w);
+         return IDLE_INSN_ALU;
+      case 0x04: case 0x06: case 0x07:             /* SLLV, SRLV, SRAV */
+      case 0x20: case 0x21: case 0x22: case 0x23:  /* ADD, ADDU, SUB, SUBU */
+      case 0x24: case 0x25: case 0x26: case 0x27:  /* AND, OR, XOR, NOR */
+      case 0x2A: case 0x2B:                        /* SLT, SLTU */
+      case 0x2D: case 0x2F:                        /* DADDU, DSUBU */
+         *reads = (UINT32_C(1) << RS_OF(w)) | (UINT32_C(1) << RT_OF(w));
+         *writes = UINT32_C(1) << RD_OF(w);
+         return IDLE_INSN_ALU;
+      }
+      return IDLE_INSN_INVALID;
+
+   case 0x01: /* REGIMM: BLTZ, BGEZ, BLTZL, BGEZL */
+      if (RT_OF(w) > 3)
+         return IDLE_INSN_INVALID;
+      *reads = UINT32_C(1) << RS_OF(w);
+      return IDLE_INSN_BRANCH;
+
+   case 0x04: case 0x05: case 0x14: case 0x15:    /* BEQ, BNE, BEQL, BNEL */
+      *reads = (UINT32_C(1) << RS_OF(w)) | (UINT32_C(1) << RT_OF(w));
+      return IDLE_INSN_BRANCH;
+
+   case 0x06: case 0x07: case 0x16: case 0x17:    /* BLEZ, BGTZ, BLEZL, BGTZL */
+      *reads = UINT32_C(1) << RS_OF(w);
+      return IDLE_INSN_BRANCH;
+
+   case 0x08: case 0x09: case 0x0A: case 0x0B:    /* ADDI, ADDIU, SLTI, SLTIU */
+   case 0x0C: case 0x0D: case 0x0E: case 0x19:    /* ANDI, ORI, XORI, DADDIU */
+      *reads = UINT32_C(1) << RS_OF(w);
+      *writes = UINT32_C(1) << RT_OF(w);
+      return IDLE_INSN_ALU;
+
+   case 0x0F: /* LUI */
+      *writes = UINT32_C(1) << RT_OF(w);
+      return IDLE_INSN_ALU;
+
+   case 0x20: case 0x21: case 0x23: case 0x24:    /* LB, LH, LW, LBU */
+   case 0x25: case 0x27: case 0x37:               /* LHU, LWU, LD */
+      *reads = UINT32_C(1) << RS_OF(w);
+      *writes = UINT32_C(1) << RT_OF(w);
+      return IDLE_INSN_LOAD;
+   }
+
+   return IDLE_INSN_INVALID;
+}
+
+int idle_loop_detect(const uint32_t *code, unsigned int length)
+{
+   uint32_t written = 0, read_first = 0;
+   uint32_t load_bases[IDLE_LOOP_MAX_LENGTH];
+   unsigned int i, j;
+
+   if (length < 2 || length > IDLE_LOOP_MAX_LENGTH)
+      return 0;
+
+   for (i = 0; i < length; i++)
+   {
+      uint32_t reads, writes;
+      int kind = decode(code[i], &reads, &writes);
+
+      /* the only branch is the one closing the loop */
+      if (kind == IDLE_INSN_INVALID
+            || (kind == IDLE_INSN_BRANCH) != (i == length - 2))
+         return 0;
+
+      /* a load's address must be the same on every iteration and still
+       * be in its base register when the branch is reached */
+      load_bases[i] = (kind == IDLE_INSN_LOAD) ? reads : 0;
+      for (j = 0; j < i; j++)
+         if (load_bases[j] & writes & ~UINT32_C(1))
+            return 0;
+
+      read_first |= reads & ~written;
+      written |= writes;
+   }
+
+   /* Each iteration must start from the same registers: nothing that is
+    * read before being set within the loop may be modified by it. */
+   return (read_first & written & ~UINT32_C(1)) == 0;
+}
+
+static int polls_event_driven_address(uint32_t address)
+{
+   uint32_t phys;
+
+   /* TLB mapped addresses would need a lookup, don't bother */
+   if ((address & UINT32_C(0xC0000000)) != UINT32_C(0x80000000))
+      return 0;
+
+   phys = address & UINT32_C(0x1FFFFFFF);
+
+   /* RDRAM, SP, DP and MI registers */
+   if (phys < UINT32_C(0x04400000))
+      return 1;
+
+   /* PI, RI and SI registers; VI and AI are derived from COUNT */
+   if (phys >= UINT32_C(0x04600000) && phys < UINT32_C(0x04900000))
+      return 1;
+
+   /* cartridge ROM */
+   return phys >= UINT32_C(0x10000000) && phys < UINT32_C(0x1FC00000);
+}
+
+int idle_loop_is_waiting(uint32_t start, uint32_t branch_addr)
+{
+   const uint32_t *code = fast_mem_access(start);
+   unsigned int length = (branch_addr - start) / 4 + 2;
+   unsigned int i;
+
+   if (code == NULL || length > IDLE_LOOP_MAX_LENGTH)
+      return 0;
+
+   for (i = 0; i < length; i++)
+   {
+      uint32_t reads, writes;
+
+      if (decode(code[i], &reads, &writes) == IDLE_INSN_LOAD
+            && !polls_event_driven_address(
+               (uint32_t) reg[RS_OF(code[i])] + IMM16S_OF(code[i])))
+         return 0;
+   }
+
+   return 1;
+}
@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - idle_loop.h                                              *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2016 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_R4300_IDLE_LOOP_H
+#define M64P_R4300_IDLE_LOOP_H
+
+#include <stdint.h>
+
+/* Longest loop, delay slot included, that is considered for skipping. */
+#define IDLE_LOOP_MAX_LENGTH 16
+
+/* Polling loops: a short backward branch whose body only loads memory
+ * and computes on the loaded values. Every iteration then does exactly
+ * the same thing until something outside the CPU changes the polled
+ * location, which only happens when an event of the interrupt queue is
+ * processed, so the time up to the next event can be skipped.
+ *
+ * code points to the first instruction of the loop and length counts
+ * the words up to and including the delay slot of the branch. */
+int idle_loop_detect(const uint32_t *code, unsigned int length);
+
+/* Checks, with the current register values, that the loads of the loop
+ * from start to the branch at branch_addr, accepted by idle_loop_detect(),
+ * read RDRAM or registers that only change on events, not e.g. VI_CURRENT
+ * or AI_LEN which follow COUNT. */
+int idle_loop_is_waiting(uint32_t start, uint32_t branch_addr);
+
+#endif /* M64P_R4300_IDLE_LOOP_H */
@@ -34,6 +34,7 @@
 #include "cp0_private.h"
 #include "dd/dd_controller.h"
 #include "exception.h"
+#include "main/device.h"
 #include "main/main.h"
 #include "main/savestates.h"
 #include "mi_controller.h"
@@ -54,132 +55,145 @@ extern int retro_return(bool just_flipping);
 
 int interupt_unsafe_state = 0;
 
-struct interrupt_event
-{
-    int type;
-    unsigned int count;
-};
-
-
 /***************************************************************************
- * Pool of Single Linked List Nodes
+ * Interrupt Queue
  **************************************************************************/
-#define POOL_CAPACITY 16
 
-struct node
+static int node_before(const struct interrupt_node* a, const struct interrupt_node* b)
 {
-    struct interrupt_event data;
-    struct node *next;
-};
-
-struct pool
-{
-    struct node nodes[POOL_CAPACITY];
-    struct node* stack[POOL_CAPACITY];
-    size_t index;
-};
-
-static struct node* alloc_node(struct pool* p);
-static void free_node(struct pool* p, struct node* node);
-static void clear_pool(struct pool* p);
+    if (a->when != b->when)
+        return a->when < b->when;
 
+    return a->seq < b->seq;
+}
 
-/* node allocation/deallocation on a given pool */
-static struct node* alloc_node(struct pool* p)
+static void swap_nodes(struct interrupt_queue* q, size_t i, size_t j)
 {
-    /* return NULL if pool is too small */
-    if (p->index >= POOL_CAPACITY)
-        return NULL;
-
-    return p->stack[p->index++];
+    struct interrupt_node tmp = q->heap[i];
+    q->heap[i] = q->heap[j];
+    q->heap[j] = tmp;
 }
 
-static void free_node(struct pool* p, struct node* node)
+static void sift_up(struct interrupt_queue* q, size_t i)
 {
-    if (p->index == 0 || node == NULL)
-        return;
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
 
-    p->stack[--p->index] = node;
+        if (!node_before(&q->heap[i], &q->heap[parent]))
+            break;
+
+        swap_nodes(q, i, parent);
+        i = parent;
+    }
 }
 
-/* release all nodes */
-static void clear_pool(struct pool* p)
+static void sift_down(struct interrupt_queue* q, size_t i)
 {
-    size_t i;
+    for (;;)
+    {
+        size_t left  = 2 * i + 1;
+        size_t right = left + 1;
+        size_t min   = i;
 
-    for(i = 0; i < POOL_CAPACITY; ++i)
-        p->stack[i] = &p->nodes[i];
+        if (left < q->size && node_before(&q->heap[left], &q->heap[min]))
+            min = left;
+        if (right < q->size && node_before(&q->heap[right], &q->heap[min]))
+            min = right;
 
-    p->index = 0;
-}
+        if (min == i)
+            break;
 
-/***************************************************************************
- * Interrupt Queue
- **************************************************************************/
+        swap_nodes(q, i, min);
+        i = min;
+    }
+}
 
-struct interrupt_queue
+static void remove_node(struct interrupt_queue* q, size_t i)
 {
-    struct pool pool;
-    struct node* first;
-};
+    --q->size;
 
-static struct interrupt_queue q;
+    if (i == q->size)
+        return;
 
+    q->heap[i] = q->heap[q->size];
+    sift_down(q, i);
+    sift_up(q, i);
+}
 
-static void clear_queue(void)
+/* Advance the 64-bit queue clock to the given COUNT value. COUNT only
+ * steps back by a few cycles (see compare_int_handler), hence the signed
+ * difference. */
+static uint64_t queue_clock(struct interrupt_queue* q, uint32_t count)
 {
-    q.first = NULL;
-    clear_pool(&q.pool);
+    q->clock += (int64_t)(int32_t)(count - q->clock_count);
+    q->clock_count = count;
+
+    return q->clock;
 }
 
+static void clear_queue(struct interrupt_queue* q)
+{
+    q->size = 0;
+    q->seq = 0;
+    /* start far enough from 0 that late events never underflow */
+    q->clock = UINT64_C(0x100000000);
+    q->clock_count = g_cp0_regs[CP0_COUNT_REG];
+}
 
-static int SPECIAL_done = 0;
+static void update_next_interupt(const struct interrupt_queue* q)
+{
+    next_interupt = (q->size != 0
+         && (q->heap[0].data.count > g_cp0_regs[CP0_COUNT_REG]
+         || (g_cp0_regs[CP0_COUNT_REG] - q->heap[0].data.count) < UINT32_C(0x80000000)))
+        ? q->heap[0].data.count
+        : 0;
+}
 
-static int before_event(unsigned int evt1, unsigned int evt2, int type2)
+static int find_event(const struct interrupt_queue* q, int type)
 {
-    if(evt1 - g_cp0_regs[CP0_COUNT_REG] < UINT32_C(0x80000000))
+    size_t i;
+    int found = -1;
+
+    /* with duplicates (CHECK_INT) return the one that fires first */
+    for (i = 0; i < q->size; ++i)
     {
-        if(evt2 - g_cp0_regs[CP0_COUNT_REG] < UINT32_C(0x80000000))
-        {
-            if((evt1 - g_cp0_regs[CP0_COUNT_REG]) < (evt2 - g_cp0_regs[CP0_COUNT_REG])) return 1;
-            else return 0;
-        }
-        else
-        {
-            if((g_cp0_regs[CP0_COUNT_REG] - evt2) < UINT32_C(0x10000000))
-            {
-                switch(type2)
-                {
-                    case SPECIAL_INT:
-                        if(SPECIAL_done) return 1;
-                        else return 0;
-                        break;
-                    default:
-                        return 0;
-                }
-            }
-            else return 1;
-        }
+        if (q->heap[i].data.type == type
+                && (found < 0 || node_before(&q->heap[i], &q->heap[found])))
+            found = (int)i;
     }
-    else return 0;
+
+    return found;
 }
 
-void add_interupt_event(int type, unsigned int delay)
+static struct interrupt_node* push_node(struct interrupt_queue* q, int type, unsigned int count)
 {
-    add_interupt_event_count(type, g_cp0_regs[CP0_COUNT_REG] + delay);
+    struct interrupt_node* event;
+
+    if (q->size >= INTERRUPT_QUEUE_CAPACITY)
+    {
+        DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
+        return NULL;
+    }
+
+    event = &q->heap[q->size++];
+    event->data.type = type;
+    event->data.count = count;
+    event->seq = q->seq++;
+
+    return event;
 }
 
-void add_interupt_event_count(int type, unsigned int count)
+/* Queue an event firing when COUNT next reaches count, as seen from
+ * the given current COUNT value. */
+static void insert_event(struct interrupt_queue* q, int type, unsigned int count, uint32_t current)
 {
-    struct node* event;
-    struct node* e;
-    int special;
+    struct interrupt_node* event;
+    uint64_t delay = (uint32_t)(count - current);
+    uint64_t seq;
+    int i = find_event(q, type);
 
-    special = (type == SPECIAL_INT);
-   
-    if(g_cp0_regs[CP0_COUNT_REG] > UINT32_C(0x80000000)) SPECIAL_done = 0;
-   
-    if (get_event(type)) {
+    if (i >= 0 && q->heap[i].data.count != 0) {
         DebugMessage(M64MSG_WARNING, "two events of type 0x%x in interrupt queue", type);
         /* FIXME: hack-fix for freezing in Perfect Dark
          * http://code.google.com/p/mupen64plus/issues/detail?id=553
@@ -188,143 +202,99 @@ void add_interupt_event_count(int type, unsigned int count)
         return;
     }
 
-    event = alloc_node(&q.pool);
+    /* SPECIAL_INT handles the COUNT wrap-around, it always waits for
+     * the next wrap even when queued exactly at count 0 */
+    if (type == SPECIAL_INT && delay == 0)
+        delay = UINT64_C(0x100000000);
+
+    event = push_node(q, type, count);
     if (event == NULL)
-    {
-        DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
         return;
-    }
 
-    event->data.count = count;
-    event->data.type = type;
+    event->when = queue_clock(q, current) + delay;
+    seq = event->seq;
+    sift_up(q, q->size - 1);
 
-    if (q.first == NULL)
-    {
-        q.first = event;
-        event->next = NULL;
-        next_interupt = q.first->data.count;
-    }
-    else if (before_event(count, q.first->data.count, q.first->data.type) && !special)
-    {
-        event->next = q.first;
-        q.first = event;
-        next_interupt = q.first->data.count;
-    }
-    else
-    {
-        for(e = q.first;
-            e->next != NULL &&
-            (!before_event(count, e->next->data.count, e->next->data.type) || special);
-            e = e->next);
+    if (q->heap[0].seq == seq)
+        next_interupt = count;
+}
 
-        if (e->next == NULL)
-        {
-            e->next = event;
-            event->next = NULL;
-        }
-        else
-        {
-            if (!special)
-                for(; e->next != NULL && e->next->data.count == count; e = e->next);
+void add_interupt_event(int type, unsigned int delay)
+{
+    add_interupt_event_count(type, g_cp0_regs[CP0_COUNT_REG] + delay);
+}
 
-            event->next = e->next;
-            e->next = event;
-        }
-    }
+void add_interupt_event_count(int type, unsigned int count)
+{
+    insert_event(&g_dev.r4300.q, type, count, g_cp0_regs[CP0_COUNT_REG]);
 }
 
 static void remove_interupt_event(void)
 {
-    struct node* e;
-
-    e = q.first;
-    q.first = e->next;
-    free_node(&q.pool, e);
+    struct interrupt_queue* q = &g_dev.r4300.q;
 
-    next_interupt = (q.first != NULL
-         && (q.first->data.count > g_cp0_regs[CP0_COUNT_REG]
-         || (g_cp0_regs[CP0_COUNT_REG] - q.first->data.count) < UINT32_C(0x80000000)))
-        ? q.first->data.count
-        : 0;
+    remove_node(q, 0);
+    update_next_interupt(q);
 }
 
 unsigned int get_event(int type)
 {
-    struct node* e = q.first;
-
-    if (e == NULL)
-        return 0;
+    const struct interrupt_queue* q = &g_dev.r4300.q;
+    int i = find_event(q, type);
 
-    if (e->data.type == type)
-        return e->data.count;
-
-    for(; e->next != NULL && e->next->data.type != type; e = e->next);
-
-    return (e->next != NULL)
-        ? e->next->data.count
+    return (i >= 0)
+        ? q->heap[i].data.count
         : 0;
 }
 
 int get_next_event_type(void)
 {
-    return (q.first == NULL)
+    return (g_dev.r4300.q.size == 0)
         ? 0
-        : q.first->data.type;
+        : g_dev.r4300.q.heap[0].data.type;
 }
 
 void remove_event(int type)
 {
-    struct node* to_del;
-    struct node* e = q.first;
-
-    if (e == NULL)
-        return;
+    struct interrupt_queue* q = &g_dev.r4300.q;
+    int i = find_event(q, type);
 
-    if (e->data.type == type)
-    {
-        q.first = e->next;
-        free_node(&q.pool, e);
-    }
-    else
-    {
-        for(; e->next != NULL && e->next->data.type != type; e = e->next);
-
-        if (e->next != NULL)
-        {
-            to_del = e->next;
-            e->next = to_del->next;
-            free_node(&q.pool, to_del);
-        }
-    }
+    if (i >= 0)
+        remove_node(q, (size_t)i);
 }
 
 void translate_event_queue(unsigned int base)
 {
-    struct node* e;
+    struct interrupt_queue* q = &g_dev.r4300.q;
+    size_t i;
 
     remove_event(COMPARE_INT);
     remove_event(SPECIAL_INT);
 
-    for(e = q.first; e != NULL; e = e->next)
+    /* relative distances are kept, so the heap order does not change */
+    for (i = 0; i < q->size; ++i)
     {
-        e->data.count = (e->data.count - g_cp0_regs[CP0_COUNT_REG]) + base;
+        q->heap[i].data.count = (q->heap[i].data.count - g_cp0_regs[CP0_COUNT_REG]) + base;
     }
-    add_interupt_event_count(COMPARE_INT, g_cp0_regs[CP0_COMPARE_REG]);
-    add_interupt_event_count(SPECIAL_INT, 0);
+    queue_clock(q, g_cp0_regs[CP0_COUNT_REG]);
+    q->clock_count = base;
+
+    insert_event(q, COMPARE_INT, g_cp0_regs[CP0_COMPARE_REG], base);
+    insert_event(q, SPECIAL_INT, 0, base);
 }
 
 int save_eventqueue_infos(char *buf)
 {
-    int len;
-    struct node* e;
-
-    len = 0;
+    struct interrupt_queue q = g_dev.r4300.q;
+    int len = 0;
 
-    for(e = q.first; e != NULL; e = e->next)
+    /* events are stored in firing order, drain a copy of the heap */
+    while (q.size != 0)
     {
-        memcpy(buf + len    , &e->data.type , 4);
-        memcpy(buf + len + 4, &e->data.count, 4);
+        memcpy(buf + len    , &q.heap[0].data.type , 4);
+        memcpy(buf + len + 4, &q.heap[0].data.count, 4);
         len += 8;
+        remove_node(&q, 0);
     }
 
     *((unsigned int*)&buf[len]) = 0xFFFFFFFF;
@@ -334,7 +304,7 @@ int save_eventqueue_infos(char *buf)
 void load_eventqueue_infos(char *buf)
 {
     int len = 0;
-    clear_queue();
+    clear_queue(&g_dev.r4300.q);
     while (*((unsigned int*)&buf[len]) != 0xFFFFFFFF)
     {
         int type = *((unsigned int*)&buf[len]);
@@ -346,48 +316,35 @@ void load_eventqueue_infos(char *buf)
 
 void init_interupt(void)
 {
-    SPECIAL_done = 1;
-
-    g_vi.delay = g_vi.next_vi = 5000;
+    g_dev.vi.delay = g_dev.vi.next_vi = 5000;
 
-    clear_queue();
-    add_interupt_event_count(VI_INT, g_vi.next_vi);
+    clear_queue(&g_dev.r4300.q);
+    add_interupt_event_count(VI_INT, g_dev.vi.next_vi);
     add_interupt_event_count(SPECIAL_INT, 0);
 }
 
 void check_interupt(void)
 {
-    struct node* event;
+    struct interrupt_queue* q = &g_dev.r4300.q;
+    struct interrupt_node* event;
 
-    if (g_r4300.mi.regs[MI_INTR_REG] & g_r4300.mi.regs[MI_INTR_MASK_REG])
+    if (g_dev.r4300.mi.regs[MI_INTR_REG] & g_dev.r4300.mi.regs[MI_INTR_MASK_REG])
         g_cp0_regs[CP0_CAUSE_REG] = (g_cp0_regs[CP0_CAUSE_REG] | UINT32_C(0x400)) & UINT32_C(0xFFFFFF83);
     else
         g_cp0_regs[CP0_CAUSE_REG] &= ~UINT32_C(0x400);
     if ((g_cp0_regs[CP0_STATUS_REG] & UINT32_C(7)) != 1) return;
     if (g_cp0_regs[CP0_STATUS_REG] & g_cp0_regs[CP0_CAUSE_REG] & UINT32_C(0xFF00))
     {
-        event = alloc_node(&q.pool);
-
+        event = push_node(q, CHECK_INT, g_cp0_regs[CP0_COUNT_REG]);
         if (event == NULL)
-        {
-            DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
             return;
-        }
-
-        event->data.count = next_interupt = g_cp0_regs[CP0_COUNT_REG];
-        event->data.type = CHECK_INT;
 
-        if (q.first == NULL)
-        {
-            q.first = event;
-            event->next = NULL;
-        }
-        else
-        {
-            event->next = q.first;
-            q.first = event;
+        /* CHECK_INT goes in front of everything, latest one first */
+        event->when = 0;
+        event->seq = ~event->seq;
+        sift_up(q, q->size - 1);
 
-        }
+        next_interupt = g_cp0_regs[CP0_COUNT_REG];
     }
 }
 
@@ -427,7 +384,6 @@ static void special_int_handler(void)
         return;
 
 
-    SPECIAL_done = 1;
     remove_interupt_event();
     add_interupt_event_count(SPECIAL_INT, 0);
 }
@@ -467,7 +423,7 @@ static void nmi_int_handler(void)
     g_gs_vi_counter = 0;
     init_interupt();
     /* clear the audio status register so that subsequent write_ai() calls will work properly */
-    g_ai.regs[AI_STATUS_REG] = 0;
+    g_dev.ai.regs[AI_STATUS_REG] = 0;
     /* set ErrorEPC with the last instruction address */
     g_cp0_regs[CP0_ERROREPC_REG] = PC->addr;
     /* reset the r4300 internal state */
@@ -506,6 +462,18 @@ void gen_interupt(void)
             reset_hard_job = 0;
             return;
         }
+
+        /* Flush the dynarec code cache the same way a hard reset drops
+         * all blocks, then resume at the current instruction. */
+        if (code_cache_full && r4300emu == CORE_DYNAREC
+                && !delay_slot && !dyna_interp)
+        {
+            uint32_t pc = PC->addr;
+
+            free_blocks();
+            init_blocks();
+            generic_jump_to(pc);
+        }
     }
    
     if (skip_jump)
@@ -513,17 +481,14 @@ void gen_interupt(void)
         uint32_t dest = skip_jump;
         skip_jump = 0;
 
-        next_interupt = (q.first->data.count > g_cp0_regs[CP0_COUNT_REG]
-                || (g_cp0_regs[CP0_COUNT_REG] - q.first->data.count) < UINT32_C(0x80000000))
-            ? q.first->data.count
-            : 0;
+        update_next_interupt(&g_dev.r4300.q);
 
         last_addr = dest;
         generic_jump_to(dest);
         return;
     } 
 
-    switch(q.first->data.type)
+    switch(g_dev.r4300.q.heap[0].data.type)
     {
         case SPECIAL_INT:
             special_int_handler();
@@ -531,7 +496,7 @@ void gen_interupt(void)
 
         case VI_INT:
             remove_interupt_event();
-            vi_vertical_interrupt_event(&g_vi);
+            vi_vertical_interrupt_event(&g_dev.vi);
             retro_return(false);
             break;
     
@@ -546,27 +511,27 @@ void gen_interupt(void)
     
         case SI_INT:
             remove_interupt_event();
-            si_end_of_dma_event(&g_si);
+            si_end_of_dma_event(&g_dev.si);
             break;
     
         case PI_INT:
             remove_interupt_event();
-            pi_end_of_dma_event(&g_pi);
+            pi_end_of_dma_event(&g_dev.pi);
             break;
     
         case AI_INT:
             remove_interupt_event();
-            ai_end_of_dma_event(&g_ai);
+            ai_end_of_dma_event(&g_dev.ai);
             break;
 
         case SP_INT:
             remove_interupt_event();
-            rsp_interrupt_event(&g_sp);
+            rsp_interrupt_event(&g_dev.sp);
             break;
     
         case DP_INT:
             remove_interupt_event();
-            rdp_interrupt_event(&g_dp);
+            rdp_interrupt_event(&g_dev.dp);
             break;
 
         case HW2_INT:
@@ -583,7 +548,7 @@ void gen_interupt(void)
             remove_interupt_event();
 
 #if 0
-            if (dd_end_of_dma_event(&g_dd) == 1)
+            if (dd_end_of_dma_event(&g_dev.dd) == 1)
             {
                remove_interupt_event();
                g_cp0_regs[CP0_CAUSE_REG] &= ~0x00000800;
@@ -592,7 +557,7 @@ void gen_interupt(void)
             break;
 
         default:
-            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", q.first->data.type);
+            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", g_dev.r4300.q.heap[0].data.type);
             remove_interupt_event();
             wrapped_exception_general();
             break;
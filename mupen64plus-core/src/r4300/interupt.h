@@ -22,8 +22,38 @@
 #ifndef M64P_R4300_INTERUPT_H
 #define M64P_R4300_INTERUPT_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+struct interrupt_event
+{
+    int type;
+    unsigned int count;
+};
+
+/* Each event type is queued at most once, except CHECK_INT which is
+ * consumed as soon as it is pushed, so this bound is never reached. */
+#define INTERRUPT_QUEUE_CAPACITY 64
+
+struct interrupt_node
+{
+    struct interrupt_event data;
+    uint64_t when;  /* queue clock value at which the event fires */
+    uint64_t seq;   /* insertion order, keeps equal events FIFO */
+};
+
+/* Binary min-heap ordered by (when, seq). The queue clock is COUNT
+ * extended to 64 bits, so ordering does not depend on COUNT wrapping. */
+struct interrupt_queue
+{
+    struct interrupt_node heap[INTERRUPT_QUEUE_CAPACITY];
+    size_t size;
+
+    uint64_t clock;
+    uint32_t clock_count;
+    uint64_t seq;
+};
+
 void init_interupt(void);
 
 // set to avoid savestates/reset if state may be inconsistent
@@ -2893,13 +2893,13 @@ static void do_readstub(int n)
   assert(addr>=0);
   int ftable=0;
   if(type==LOADB_STUB||type==LOADBU_STUB)
-    ftable=(int)readmemb;
+    ftable=(int)g_dev.mem.readmemb;
   if(type==LOADH_STUB||type==LOADHU_STUB)
-    ftable=(int)readmemh;
+    ftable=(int)g_dev.mem.readmemh;
   if(type==LOADW_STUB)
-    ftable=(int)readmem;
+    ftable=(int)g_dev.mem.readmem;
   if(type==LOADD_STUB)
-    ftable=(int)readmemd;
+    ftable=(int)g_dev.mem.readmemd;
   emit_writeword(rs,(int)&address);
   //emit_pusha();
   save_regs(reglist);
@@ -2967,13 +2967,13 @@ static void inline_readstub(int type, int i, u_int addr, signed char regmap[], i
   assert(rs>=0);
   int ftable=0;
   if(type==LOADB_STUB||type==LOADBU_STUB)
-    ftable=(int)readmemb;
+    ftable=(int)g_dev.mem.readmemb;
   if(type==LOADH_STUB||type==LOADHU_STUB)
-    ftable=(int)readmemh;
+    ftable=(int)g_dev.mem.readmemh;
   if(type==LOADW_STUB)
-    ftable=(int)readmem;
+    ftable=(int)g_dev.mem.readmem;
   if(type==LOADD_STUB)
-    ftable=(int)readmemd;
+    ftable=(int)g_dev.mem.readmemd;
   emit_writeword(rs,(int)&address);
   //emit_pusha();
   save_regs(reglist);
@@ -3062,13 +3062,13 @@ static void do_writestub(int n)
   assert(addr>=0);
   int ftable=0;
   if(type==STOREB_STUB)
-    ftable=(int)writememb;
+    ftable=(int)g_dev.mem.writememb;
   if(type==STOREH_STUB)
-    ftable=(int)writememh;
+    ftable=(int)g_dev.mem.writememh;
   if(type==STOREW_STUB)
-    ftable=(int)writemem;
+    ftable=(int)g_dev.mem.writemem;
   if(type==STORED_STUB)
-    ftable=(int)writememd;
+    ftable=(int)g_dev.mem.writememd;
   emit_writeword(rs,(int)&address);
   //emit_shrimm(rs,16,rs);
   //emit_movmem_indexedx4(ftable,rs,rs);
@@ -3129,13 +3129,13 @@ static void inline_writestub(int type, int i, u_int addr, signed char regmap[],
   assert(rt>=0);
   int ftable=0;
   if(type==STOREB_STUB)
-    ftable=(int)writememb;
+    ftable=(int)g_dev.mem.writememb;
   if(type==STOREH_STUB)
-    ftable=(int)writememh;
+    ftable=(int)g_dev.mem.writememh;
   if(type==STOREW_STUB)
-    ftable=(int)writemem;
+    ftable=(int)g_dev.mem.writemem;
   if(type==STORED_STUB)
-    ftable=(int)writememd;
+    ftable=(int)g_dev.mem.writememd;
   emit_writeword(rs,(int)&address);
   //emit_shrimm(rs,16,rs);
   //emit_movmem_indexedx4(ftable,rs,rs);
@@ -3566,7 +3566,7 @@ static void loadlr_assemble_arm(int i,struct regstat *i_regs)
   }
   if (opcode[i]==0x22||opcode[i]==0x26) { // LWL/LWR
     if(!c||memtarget) {
-      //emit_readword_indexed((int)g_rdram-0x80000000,temp2,temp2);
+      //emit_readword_indexed((int)g_dev.rdram-0x80000000,temp2,temp2);
       emit_readword_indexed_tlb(0,temp2,map,temp2);
       if(jaddr) add_stub(LOADW_STUB,jaddr,(int)out,i,temp2,(int)i_regs,ccadj[i],reglist);
     }
@@ -3591,8 +3591,8 @@ static void loadlr_assemble_arm(int i,struct regstat *i_regs)
   if (opcode[i]==0x1A||opcode[i]==0x1B) { // LDL/LDR
     int temp2h=get_reg(i_regs->regmap,FTEMP|64);
     if(!c||memtarget) {
-      //if(th>=0) emit_readword_indexed((int)g_rdram-0x80000000,temp2,temp2h);
-      //emit_readword_indexed((int)g_rdram-0x7FFFFFFC,temp2,temp2);
+      //if(th>=0) emit_readword_indexed((int)g_dev.rdram-0x80000000,temp2,temp2h);
+      //emit_readword_indexed((int)g_dev.rdram-0x7FFFFFFC,temp2,temp2);
       emit_readdword_indexed_tlb(0,temp2,map,temp2h,temp2);
       if(jaddr) add_stub(LOADD_STUB,jaddr,(int)out,i,temp2,(int)i_regs,ccadj[i],reglist);
     }
@@ -4805,7 +4805,7 @@ static void arch_init() {
   jump_table_symbols[18] = (int) cached_interpreter_table.TLBP;
 
   #ifdef RAM_OFFSET
-  ram_offset=((int)g_rdram-(int)0x80000000)>>2;
+  ram_offset=((int)g_dev.rdram-(int)0x80000000)>>2;
   #endif
 
   // Trampolines for jumps >32M
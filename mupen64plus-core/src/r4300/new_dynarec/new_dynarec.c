@@ -47,6 +47,7 @@ int getVMBlock();
 #ifdef __cplusplus
 extern "C" {
 #endif
+#include "../../main/device.h"
 #include "../../main/main.h"
 #include "../../memory/memory.h"
 #include "../../rsp/rsp_core.h"
@@ -1183,15 +1184,15 @@ void invalidate_block(u_int block)
       get_bounds((int)head->addr,&start,&end);
       //DebugMessage(M64MSG_VERBOSE, "start: %x end: %x",start,end);
       if(page<2048&&start>=0x80000000&&end<0x80800000) {
-        if(((start-(u_int)g_rdram)>>12)<=page&&((end-1-(u_int)g_rdram)>>12)>=page) {
-          if((((start-(u_int)g_rdram)>>12)&2047)<first) first=((start-(u_int)g_rdram)>>12)&2047;
-          if((((end-1-(u_int)g_rdram)>>12)&2047)>last) last=((end-1-(u_int)g_rdram)>>12)&2047;
+        if(((start-(u_int)g_dev.rdram)>>12)<=page&&((end-1-(u_int)g_dev.rdram)>>12)>=page) {
+          if((((start-(u_int)g_dev.rdram)>>12)&2047)<first) first=((start-(u_int)g_dev.rdram)>>12)&2047;
+          if((((end-1-(u_int)g_dev.rdram)>>12)&2047)>last) last=((end-1-(u_int)g_dev.rdram)>>12)&2047;
         }
       }
       if(page<2048&&(signed int)start>=(signed int)0xC0000000&&(signed int)end>=(signed int)0xC0000000) {
-        if(((start+memory_map[start>>12]-(u_int)g_rdram)>>12)<=page&&((end-1+memory_map[(end-1)>>12]-(u_int)g_rdram)>>12)>=page) {
-          if((((start+memory_map[start>>12]-(u_int)g_rdram)>>12)&2047)<first) first=((start+memory_map[start>>12]-(u_int)g_rdram)>>12)&2047;
-          if((((end-1+memory_map[(end-1)>>12]-(u_int)g_rdram)>>12)&2047)>last) last=((end-1+memory_map[(end-1)>>12]-(u_int)g_rdram)>>12)&2047;
+        if(((start+memory_map[start>>12]-(u_int)g_dev.rdram)>>12)<=page&&((end-1+memory_map[(end-1)>>12]-(u_int)g_dev.rdram)>>12)>=page) {
+          if((((start+memory_map[start>>12]-(u_int)g_dev.rdram)>>12)&2047)<first) first=((start+memory_map[start>>12]-(u_int)g_dev.rdram)>>12)&2047;
+          if((((end-1+memory_map[(end-1)>>12]-(u_int)g_dev.rdram)>>12)&2047)>last) last=((end-1+memory_map[(end-1)>>12]-(u_int)g_dev.rdram)>>12)&2047;
         }
       }
     }
@@ -1219,12 +1220,12 @@ void invalidate_block(u_int block)
   if(tlb_LUT_w[block]) {
     assert(tlb_LUT_r[block]==tlb_LUT_w[block]);
     // CHECK: Is this right?
-    memory_map[block]=((tlb_LUT_w[block]&0xFFFFF000)-(block<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+    memory_map[block]=((tlb_LUT_w[block]&0xFFFFF000)-(block<<12)+(unsigned int)g_dev.rdram-0x80000000)>>2;
     u_int real_block=tlb_LUT_w[block]>>12;
     invalid_code[real_block]=1;
-    if(real_block>=0x80000&&real_block<0x80800) memory_map[real_block]=((u_int)g_rdram-0x80000000)>>2;
+    if(real_block>=0x80000&&real_block<0x80800) memory_map[real_block]=((u_int)g_dev.rdram-0x80000000)>>2;
   }
-  else if(block>=0x80000&&block<0x80800) memory_map[block]=((u_int)g_rdram-0x80000000)>>2;
+  else if(block>=0x80000&&block<0x80800) memory_map[block]=((u_int)g_dev.rdram-0x80000000)>>2;
   #ifdef USE_MINI_HT
   memset(mini_ht,-1,sizeof(mini_ht));
   #endif
@@ -1282,7 +1283,7 @@ void invalidate_all_pages(void)
   // TLB
   for(page=0;page<0x100000;page++) {
     if(tlb_LUT_r[page]) {
-      memory_map[page]=((tlb_LUT_r[page]&0xFFFFF000)-(page<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+      memory_map[page]=((tlb_LUT_r[page]&0xFFFFF000)-(page<<12)+(unsigned int)g_dev.rdram-0x80000000)>>2;
       if(!tlb_LUT_w[page]||!invalid_code[page])
         memory_map[page]|=0x40000000; // Write protect
     }
@@ -1323,8 +1324,8 @@ void clean_blocks(u_int page)
           u_int i;
           u_int inv=0;
           get_bounds((int)head->addr,&start,&end);
-          if(start-(u_int)g_rdram<0x800000) {
-            for(i=(start-(u_int)g_rdram+0x80000000)>>12;i<=(end-1-(u_int)g_rdram+0x80000000)>>12;i++) {
+          if(start-(u_int)g_dev.rdram<0x800000) {
+            for(i=(start-(u_int)g_dev.rdram+0x80000000)>>12;i<=(end-1-(u_int)g_dev.rdram+0x80000000)>>12;i++) {
               inv|=invalid_code[i];
             }
           }
@@ -2063,7 +2064,7 @@ static int mchecksum()
     unsigned int temp=sum;
     sum<<=1;
     sum|=(~temp)>>31;
-    sum^=((u_int *)g_rdram)[i];
+    sum^=((u_int *)g_dev.rdram)[i];
   }
   return sum;
 }
@@ -2873,7 +2874,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         {
           //emit_xorimm(addr,3,tl);
           //gen_tlb_addr_r(tl,map);
-          //emit_movsbl_indexed((int)g_rdram-0x80000000,tl,tl);
+          //emit_movsbl_indexed((int)g_dev.rdram-0x80000000,tl,tl);
           int x=0;
           if(!c) emit_xorimm(addr,3,tl);
           else x=((constmap[i][s]+offset)^3)-(constmap[i][s]+offset);
@@ -2908,7 +2909,7 @@ static void load_assemble(int i,struct regstat *i_regs)
             #ifdef RAM_OFFSET
             emit_movswl_indexed(x,tl,tl);
             #else
-            emit_movswl_indexed((int)g_rdram-0x80000000+x,tl,tl);
+            emit_movswl_indexed((int)g_dev.rdram-0x80000000+x,tl,tl);
             #endif
           }
         }
@@ -2922,7 +2923,7 @@ static void load_assemble(int i,struct regstat *i_regs)
   if (opcode[i]==0x23) { // LW
     if(!c||memtarget) {
       if(!dummy) {
-        //emit_readword_indexed((int)g_rdram-0x80000000,addr,tl);
+        //emit_readword_indexed((int)g_dev.rdram-0x80000000,addr,tl);
         #ifdef HOST_IMM_ADDR32
         if(c)
           emit_readword_tlb(constmap[i][s]+offset,map,tl);
@@ -2947,7 +2948,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         {
           //emit_xorimm(addr,3,tl);
           //gen_tlb_addr_r(tl,map);
-          //emit_movzbl_indexed((int)g_rdram-0x80000000,tl,tl);
+          //emit_movzbl_indexed((int)g_dev.rdram-0x80000000,tl,tl);
           int x=0;
           if(!c) emit_xorimm(addr,3,tl);
           else x=((constmap[i][s]+offset)^3)-(constmap[i][s]+offset);
@@ -2982,7 +2983,7 @@ static void load_assemble(int i,struct regstat *i_regs)
             #ifdef RAM_OFFSET
             emit_movzwl_indexed(x,tl,tl);
             #else
-            emit_movzwl_indexed((int)g_rdram-0x80000000+x,tl,tl);
+            emit_movzwl_indexed((int)g_dev.rdram-0x80000000+x,tl,tl);
             #endif
           }
         }
@@ -2997,7 +2998,7 @@ static void load_assemble(int i,struct regstat *i_regs)
     assert(th>=0);
     if(!c||memtarget) {
       if(!dummy) {
-        //emit_readword_indexed((int)g_rdram-0x80000000,addr,tl);
+        //emit_readword_indexed((int)g_dev.rdram-0x80000000,addr,tl);
         #ifdef HOST_IMM_ADDR32
         if(c)
           emit_readword_tlb(constmap[i][s]+offset,map,tl);
@@ -3017,8 +3018,8 @@ static void load_assemble(int i,struct regstat *i_regs)
     if(!c||memtarget) {
       if(!dummy) {
         //gen_tlb_addr_r(tl,map);
-        //if(th>=0) emit_readword_indexed((int)g_rdram-0x80000000,addr,th);
-        //emit_readword_indexed((int)g_rdram-0x7FFFFFFC,addr,tl);
+        //if(th>=0) emit_readword_indexed((int)g_dev.rdram-0x80000000,addr,th);
+        //emit_readword_indexed((int)g_dev.rdram-0x7FFFFFFC,addr,tl);
         #ifdef HOST_IMM_ADDR32
         if(c)
           emit_readdword_tlb(constmap[i][s]+offset,map,th,tl);
@@ -3146,7 +3147,7 @@ static void store_assemble(int i,struct regstat *i_regs)
       if(!c) emit_xorimm(addr,3,temp);
       else x=((constmap[i][s]+offset)^3)-(constmap[i][s]+offset);
       //gen_tlb_addr_w(temp,map);
-      //emit_writebyte_indexed(tl,(int)g_rdram-0x80000000,temp);
+      //emit_writebyte_indexed(tl,(int)g_dev.rdram-0x80000000,temp);
       emit_writebyte_indexed_tlb(tl,x,temp,map,temp);
     }
     type=STOREB_STUB;
@@ -3163,13 +3164,13 @@ static void store_assemble(int i,struct regstat *i_regs)
         gen_tlb_addr_w(temp,map);
         emit_writehword_indexed(tl,x,temp);
       }else
-        emit_writehword_indexed(tl,(int)g_rdram-0x80000000+x,temp);
+        emit_writehword_indexed(tl,(int)g_dev.rdram-0x80000000+x,temp);
     }
     type=STOREH_STUB;
   }
   if (opcode[i]==0x2B) { // SW
     if(!c||memtarget)
-      //emit_writeword_indexed(tl,(int)g_rdram-0x80000000,addr);
+      //emit_writeword_indexed(tl,(int)g_dev.rdram-0x80000000,addr);
       emit_writeword_indexed_tlb(tl,0,addr,map,temp);
     type=STOREW_STUB;
   }
@@ -3177,13 +3178,13 @@ static void store_assemble(int i,struct regstat *i_regs)
     if(!c||memtarget) {
       if(rs2[i]) {
         assert(th>=0);
-        //emit_writeword_indexed(th,(int)g_rdram-0x80000000,addr);
-        //emit_writeword_indexed(tl,(int)g_rdram-0x7FFFFFFC,addr);
+        //emit_writeword_indexed(th,(int)g_dev.rdram-0x80000000,addr);
+        //emit_writeword_indexed(tl,(int)g_dev.rdram-0x7FFFFFFC,addr);
         emit_writedword_indexed_tlb(th,tl,0,addr,map,temp);
       }else{
         // Store zero
-        //emit_writeword_indexed(tl,(int)g_rdram-0x80000000,temp);
-        //emit_writeword_indexed(tl,(int)g_rdram-0x7FFFFFFC,temp);
+        //emit_writeword_indexed(tl,(int)g_dev.rdram-0x80000000,temp);
+        //emit_writeword_indexed(tl,(int)g_dev.rdram-0x7FFFFFFC,temp);
         emit_writedword_indexed_tlb(tl,tl,0,addr,map,temp);
       }
     }
@@ -3307,8 +3308,8 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     if(map<0) emit_loadreg(ROREG,map=HOST_TEMPREG);
     gen_tlb_addr_w(temp,map);
     #else
-    if((u_int)g_rdram!=0x80000000) 
-      emit_addimm_no_flags((u_int)g_rdram-(u_int)0x80000000,temp);
+    if((u_int)g_dev.rdram!=0x80000000) 
+      emit_addimm_no_flags((u_int)g_dev.rdram-(u_int)0x80000000,temp);
     #endif
   }else{ // using tlb
     int map=get_reg(i_regs->regmap,TLREG);
@@ -3469,7 +3470,7 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     if(map<0) map=HOST_TEMPREG;
     gen_orig_addr_w(temp,map);
     #else
-    emit_addimm_no_flags((u_int)0x80000000-(u_int)g_rdram,temp);
+    emit_addimm_no_flags((u_int)0x80000000-(u_int)g_dev.rdram,temp);
     #endif
     #if defined(HOST_IMM8)
     int ir=get_reg(i_regs->regmap,INVCP);
@@ -3615,7 +3616,7 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
   if (opcode[i]==0x31) { // LWC1
     //if(s>=0&&!c&&!offset) emit_mov(s,tl);
     //gen_tlb_addr_r(ar,map);
-    //emit_readword_indexed((int)g_rdram-0x80000000,tl,tl);
+    //emit_readword_indexed((int)g_dev.rdram-0x80000000,tl,tl);
     #ifdef HOST_IMM_ADDR32
     if(c) emit_readword_tlb(constmap[i][s]+offset,map,tl);
     else
@@ -3627,8 +3628,8 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     assert(th>=0);
     //if(s>=0&&!c&&!offset) emit_mov(s,tl);
     //gen_tlb_addr_r(ar,map);
-    //emit_readword_indexed((int)g_rdram-0x80000000,tl,th);
-    //emit_readword_indexed((int)g_rdram-0x7FFFFFFC,tl,tl);
+    //emit_readword_indexed((int)g_dev.rdram-0x80000000,tl,th);
+    //emit_readword_indexed((int)g_dev.rdram-0x7FFFFFFC,tl,tl);
     #ifdef HOST_IMM_ADDR32
     if(c) emit_readdword_tlb(constmap[i][s]+offset,map,th,tl);
     else
@@ -3637,14 +3638,14 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     type=LOADD_STUB;
   }
   if (opcode[i]==0x39) { // SWC1
-    //emit_writeword_indexed(tl,(int)g_rdram-0x80000000,temp);
+    //emit_writeword_indexed(tl,(int)g_dev.rdram-0x80000000,temp);
     emit_writeword_indexed_tlb(tl,0,offset||c||s<0?temp:s,map,temp);
     type=STOREW_STUB;
   }
   if (opcode[i]==0x3D) { // SDC1
     assert(th>=0);
-    //emit_writeword_indexed(th,(int)g_rdram-0x80000000,temp);
-    //emit_writeword_indexed(tl,(int)g_rdram-0x7FFFFFFC,temp);
+    //emit_writeword_indexed(th,(int)g_dev.rdram-0x80000000,temp);
+    //emit_writeword_indexed(tl,(int)g_dev.rdram-0x7FFFFFFC,temp);
     emit_writedword_indexed_tlb(th,tl,0,offset||c||s<0?temp:s,map,temp);
     type=STORED_STUB;
   }
@@ -4016,14 +4017,14 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
             if (opcode[i]==0x22||opcode[i]==0x26) { // LWL/LWR
               #ifdef RAM_OFFSET
               if((signed int)constmap[i][rs]+offset<(signed int)0x80800000) 
-                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFFC)+(int)g_rdram-0x80000000,ra);
+                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFFC)+(int)g_dev.rdram-0x80000000,ra);
               else
               #endif
               emit_movimm((constmap[i][rs]+offset)&0xFFFFFFFC,ra);
             }else if (opcode[i]==0x1a||opcode[i]==0x1b) { // LDL/LDR
               #ifdef RAM_OFFSET
               if((signed int)constmap[i][rs]+offset<(signed int)0x80800000) 
-                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFF8)+(int)g_rdram-0x80000000,ra);
+                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFF8)+(int)g_dev.rdram-0x80000000,ra);
               else
               #endif
               emit_movimm((constmap[i][rs]+offset)&0xFFFFFFF8,ra);
@@ -4034,7 +4035,7 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
               #endif
               #ifdef RAM_OFFSET
               if((itype[i]==LOAD||opcode[i]==0x31||opcode[i]==0x35)&&(signed int)constmap[i][rs]+offset<(signed int)0x80800000) 
-                emit_movimm(constmap[i][rs]+offset+(int)g_rdram-0x80000000,ra);
+                emit_movimm(constmap[i][rs]+offset+(int)g_dev.rdram-0x80000000,ra);
               else
               #endif
               emit_movimm(constmap[i][rs]+offset,ra);
@@ -4090,14 +4091,14 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
         if (opcode[i+1]==0x22||opcode[i+1]==0x26) { // LWL/LWR
           #ifdef RAM_OFFSET
           if((signed int)constmap[i+1][rs]+offset<(signed int)0x80800000) 
-            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFFC)+(int)g_rdram-0x80000000,ra);
+            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFFC)+(int)g_dev.rdram-0x80000000,ra);
           else
           #endif
           emit_movimm((constmap[i+1][rs]+offset)&0xFFFFFFFC,ra);
         }else if (opcode[i+1]==0x1a||opcode[i+1]==0x1b) { // LDL/LDR
           #ifdef RAM_OFFSET
           if((signed int)constmap[i+1][rs]+offset<(signed int)0x80800000) 
-            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFF8)+(int)g_rdram-0x80000000,ra);
+            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFF8)+(int)g_dev.rdram-0x80000000,ra);
           else
           #endif
           emit_movimm((constmap[i+1][rs]+offset)&0xFFFFFFF8,ra);
@@ -4108,7 +4109,7 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
           #endif
           #ifdef RAM_OFFSET
           if((itype[i+1]==LOAD||opcode[i+1]==0x31||opcode[i+1]==0x35)&&(signed int)constmap[i+1][rs]+offset<(signed int)0x80800000) 
-            emit_movimm(constmap[i+1][rs]+offset+(int)g_rdram-0x80000000,ra);
+            emit_movimm(constmap[i+1][rs]+offset+(int)g_dev.rdram-0x80000000,ra);
           else
           #endif
           emit_movimm(constmap[i+1][rs]+offset,ra);
@@ -4152,7 +4153,7 @@ static int get_final_value(int hr, int i, int *value)
           #endif
           #ifdef RAM_OFFSET
           if((signed int)constmap[i][hr]+imm[i+2]<(signed int)0x80800000)
-            *value=constmap[i][hr]+imm[i+2]+(int)g_rdram-0x80000000;
+            *value=constmap[i][hr]+imm[i+2]+(int)g_dev.rdram-0x80000000;
           else
           #endif
           // Precompute load address
@@ -4167,7 +4168,7 @@ static int get_final_value(int hr, int i, int *value)
         #endif
         #ifdef RAM_OFFSET
         if((signed int)constmap[i][hr]+imm[i+1]<(signed int)0x80800000)
-          *value=constmap[i][hr]+imm[i+1]+(int)g_rdram-0x80000000;
+          *value=constmap[i][hr]+imm[i+1]+(int)g_dev.rdram-0x80000000;
         else
         #endif
         // Precompute load address
@@ -7620,10 +7621,10 @@ void new_dynarec_init(void)
 {
   DebugMessage(M64MSG_INFO, "Init new dynarec");
 
-#if defined(VITA)
-  sceKernelOpenVMDomain();
-  SceUID block = sceKernelAllocMemBlockForVM("code", 1 << TARGET_SIZE_2);
-  sceKernelGetMemBlockBase(block, &base_addr);
+#if defined(VITA)
+  sceKernelOpenVMDomain();
+  SceUID block = sceKernelAllocMemBlockForVM("code", 1 << TARGET_SIZE_2);
+  sceKernelGetMemBlockBase(block, &base_addr);
   sceKernelCloseVMDomain();
 #elif NEW_DYNAREC == NEW_DYNAREC_ARM
   if ((base_addr = mmap ((u_char *)BASE_ADDR, 1<<TARGET_SIZE_2,
@@ -7666,35 +7667,38 @@ void new_dynarec_init(void)
   for(n=0;n<524288;n++) // 0 .. 0x7FFFFFFF
     memory_map[n]=-1;
   for(n=524288;n<526336;n++) // 0x80000000 .. 0x807FFFFF
-    memory_map[n]=((u_int)g_rdram-0x80000000)>>2;
+    memory_map[n]=((u_int)g_dev.rdram-0x80000000)>>2;
   for(n=526336;n<1048576;n++) // 0x80800000 .. 0xFFFFFFFF
     memory_map[n]=-1;
   for(n=0;n<0x8000;n++) { // 0 .. 0x7FFFFFFF
-    writemem[n] = write_nomem_new;
-    writememb[n] = write_nomemb_new;
-    writememh[n] = write_nomemh_new;
-    writememd[n] = write_nomemd_new;
-    readmem[n] = read_nomem_new;
-    readmemb[n] = read_nomemb_new;
-    readmemh[n] = read_nomemh_new;
-    readmemd[n] = read_nomemd_new;
+    g_dev.mem.writemem[n] = write_nomem_new;
+    g_dev.mem.writememb[n] = write_nomemb_new;
+    g_dev.mem.writememh[n] = write_nomemh_new;
+    g_dev.mem.writememd[n] = write_nomemd_new;
+    g_dev.mem.readmem[n] = read_nomem_new;
+    g_dev.mem.readmemb[n] = read_nomemb_new;
+    g_dev.mem.readmemh[n] = read_nomemh_new;
+    g_dev.mem.readmemd[n] = read_nomemd_new;
   }
   for(n=0x8000;n<0x8080;n++) { // 0x80000000 .. 0x807FFFFF
-    writemem[n] = write_rdram_new;
-    writememb[n] = write_rdramb_new;
-    writememh[n] = write_rdramh_new;
-    writememd[n] = write_rdramd_new;
+    g_dev.mem.writemem[n] = write_rdram_new;
+    g_dev.mem.writememb[n] = write_rdramb_new;
+    g_dev.mem.writememh[n] = write_rdramh_new;
+    g_dev.mem.writememd[n] = write_rdramd_new;
   }
   for(n=0xC000;n<0x10000;n++) { // 0xC0000000 .. 0xFFFFFFFF
-    writemem[n] = write_nomem_new;
-    writememb[n] = write_nomemb_new;
-    writememh[n] = write_nomemh_new;
-    writememd[n] = write_nomemd_new;
-    readmem[n] = read_nomem_new;
-    readmemb[n] = read_nomemb_new;
-    readmemh[n] = read_nomemh_new;
-    readmemd[n] = read_nomemd_new;
-  }
+    g_dev.mem.writemem[n] = write_nomem_new;
+    g_dev.mem.writememb[n] = write_nomemb_new;
+    g_dev.mem.writememh[n] = write_nomemh_new;
+    g_dev.mem.writememd[n] = write_nomemd_new;
+    g_dev.mem.readmem[n] = read_nomem_new;
+    g_dev.mem.readmemb[n] = read_nomemb_new;
+    g_dev.mem.readmemh[n] = read_nomemh_new;
+    g_dev.mem.readmemd[n] = read_nomemd_new;
+  }
+  // RDRAM writes must now go through write_rdram*_new
+  for(n=0;n<0x10000;n++)
+    update_host_pages(n);
   tlb_hacks();
   arch_init();
 }
@@ -7803,17 +7807,17 @@ int new_recompile_block(int addr)
   start = (u_int)addr&~3;
   //assert(((u_int)addr&1)==0);
   if ((int)addr >= 0xa4000000 && (int)addr < 0xa4001000) {
-    source = (u_int *)((u_int)g_sp.mem+start-0xa4000000);
+    source = (u_int *)((u_int)g_dev.sp.mem+start-0xa4000000);
     pagelimit = 0xa4001000;
   }
   else if ((int)addr >= 0x80000000 && (int)addr < 0x80800000) {
-    source = (u_int *)((u_int)g_rdram+start-0x80000000);
+    source = (u_int *)((u_int)g_dev.rdram+start-0x80000000);
     pagelimit = 0x80800000;
   }
   else if ((signed int)addr >= (signed int)0xC0000000) {
     //DebugMessage(M64MSG_VERBOSE, "addr=%x mm=%x",(u_int)addr,(memory_map[start>>12]<<2));
     //if(tlb_LUT_r[start>>12])
-      //source = (u_int *)(((int)g_rdram)+(tlb_LUT_r[start>>12]&0xFFFFF000)+(((int)addr)&0xFFF)-0x80000000);
+      //source = (u_int *)(((int)g_dev.rdram)+(tlb_LUT_r[start>>12]&0xFFFFF000)+(((int)addr)&0xFFF)-0x80000000);
     if((signed int)memory_map[start>>12]>=0) {
       source = (u_int *)((u_int)(start+(memory_map[start>>12]<<2)));
       pagelimit=(start+4096)&0xFFFFF000;
@@ -11002,7 +11006,7 @@ int new_recompile_block(int addr)
     memory_map[i]|=0x40000000;
     if((signed int)start>=(signed int)0xC0000000) {
       assert(using_tlb);
-      j=(((u_int)i<<12)+(memory_map[i]<<2)-(u_int)g_rdram+(u_int)0x80000000)>>12;
+      j=(((u_int)i<<12)+(memory_map[i]<<2)-(u_int)g_dev.rdram+(u_int)0x80000000)>>12;
       invalid_code[j]=0;
       memory_map[j]|=0x40000000;
       //DebugMessage(M64MSG_VERBOSE, "write protect physical page: %x (virtual %x)",j<<12,start);
@@ -11100,7 +11104,7 @@ void TLBWI_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_dev.rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
           memory_map[i]|=0x40000000; // Write protect
@@ -11121,7 +11125,7 @@ void TLBWI_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_dev.rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
           memory_map[i]|=0x40000000; // Write protect
@@ -11172,7 +11176,7 @@ void TLBWR_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_dev.rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
           memory_map[i]|=0x40000000; // Write protect
@@ -11193,7 +11197,7 @@ void TLBWR_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_dev.rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
           memory_map[i]|=0x40000000; // Write protect
@@ -1988,7 +1988,7 @@ static void emit_readword_indexed(int addr, int rs, int rt)
 }
 static void emit_readword_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_readword(addr+(int)g_rdram-0x80000000, rt);
+  if(map<0) emit_readword(addr+(int)g_dev.rdram-0x80000000, rt);
   else
   {
     assem_debug("mov (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -2000,7 +2000,7 @@ static void emit_readword_tlb(int addr, int map, int rt)
 }
 static void emit_readword_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_readword_indexed(addr+(int)g_rdram-0x80000000, rs, rt);
+  if(map<0) emit_readword_indexed(addr+(int)g_dev.rdram-0x80000000, rs, rt);
   else {
     assem_debug("mov %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -2033,8 +2033,8 @@ static void emit_movmem_indexedx4(int addr, int rs, int rt)
 static void emit_readdword_tlb(int addr, int map, int rh, int rl)
 {
   if(map<0) {
-    if(rh>=0) emit_readword(addr+(int)g_rdram-0x80000000, rh);
-    emit_readword(addr+(int)g_rdram-0x7FFFFFFC, rl);
+    if(rh>=0) emit_readword(addr+(int)g_dev.rdram-0x80000000, rh);
+    emit_readword(addr+(int)g_dev.rdram-0x7FFFFFFC, rl);
   }
   else {
     if(rh>=0) emit_movmem_indexedx4(addr, map, rh);
@@ -2065,7 +2065,7 @@ static void emit_movsbl_indexed(int addr, int rs, int rt)
 }
 static void emit_movsbl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movsbl(addr+(int)g_rdram-0x80000000, rt);
+  if(map<0) emit_movsbl(addr+(int)g_dev.rdram-0x80000000, rt);
   else
   {
     assem_debug("movsbl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -2078,7 +2078,7 @@ static void emit_movsbl_tlb(int addr, int map, int rt)
 }
 static void emit_movsbl_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_movsbl_indexed(addr+(int)g_rdram-0x80000000, rs, rt);
+  if(map<0) emit_movsbl_indexed(addr+(int)g_dev.rdram-0x80000000, rs, rt);
   else {
     assem_debug("movsbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -2119,7 +2119,7 @@ static void emit_movswl_indexed(int addr, int rs, int rt)
 }
 static void emit_movswl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movswl(addr+(int)g_rdram-0x80000000, rt);
+  if(map<0) emit_movswl(addr+(int)g_dev.rdram-0x80000000, rt);
   else
   {
     assem_debug("movswl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -2148,7 +2148,7 @@ static void emit_movzbl_indexed(int addr, int rs, int rt)
 }
 static void emit_movzbl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movzbl(addr+(int)g_rdram-0x80000000, rt);
+  if(map<0) emit_movzbl(addr+(int)g_dev.rdram-0x80000000, rt);
   else
   {
     assem_debug("movzbl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -2161,7 +2161,7 @@ static void emit_movzbl_tlb(int addr, int map, int rt)
 }
 static void emit_movzbl_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_movzbl_indexed(addr+(int)g_rdram-0x80000000, rs, rt);
+  if(map<0) emit_movzbl_indexed(addr+(int)g_dev.rdram-0x80000000, rs, rt);
   else {
     assem_debug("movzbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -2202,7 +2202,7 @@ static void emit_movzwl_indexed(int addr, int rs, int rt)
 }
 static void emit_movzwl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movzwl(addr+(int)g_rdram-0x80000000, rt);
+  if(map<0) emit_movzwl(addr+(int)g_dev.rdram-0x80000000, rt);
   else
   {
     assem_debug("movzwl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -2259,7 +2259,7 @@ static void emit_writeword_indexed(int rt, int addr, int rs)
 }
 static void emit_writeword_indexed_tlb(int rt, int addr, int rs, int map, int temp)
 {
-  if(map<0) emit_writeword_indexed(rt, addr+(int)g_rdram-0x80000000, rs);
+  if(map<0) emit_writeword_indexed(rt, addr+(int)g_dev.rdram-0x80000000, rs);
   else {
     assem_debug("mov %%%s,%x(%%%s,%%%s,1)",regname[rt],addr,regname[rs],regname[map]);
     assert(rs!=ESP);
@@ -2349,7 +2349,7 @@ static void emit_writebyte_indexed(int rt, int addr, int rs)
 }
 static void emit_writebyte_indexed_tlb(int rt, int addr, int rs, int map, int temp)
 {
-  if(map<0) emit_writebyte_indexed(rt, addr+(int)g_rdram-0x80000000, rs);
+  if(map<0) emit_writebyte_indexed(rt, addr+(int)g_dev.rdram-0x80000000, rs);
   else
   if(rt<4) {
     assem_debug("movb %%%cl,%x(%%%s,%%%s,1)",regname[rt][1],addr,regname[rs],regname[map]);
@@ -2826,13 +2826,13 @@ static void do_readstub(int n)
   assert(addr>=0);
   int ftable=0;
   if(type==LOADB_STUB||type==LOADBU_STUB)
-    ftable=(int)readmemb;
+    ftable=(int)g_dev.mem.readmemb;
   if(type==LOADH_STUB||type==LOADHU_STUB)
-    ftable=(int)readmemh;
+    ftable=(int)g_dev.mem.readmemh;
   if(type==LOADW_STUB)
-    ftable=(int)readmem;
+    ftable=(int)g_dev.mem.readmem;
   if(type==LOADD_STUB)
-    ftable=(int)readmemd;
+    ftable=(int)g_dev.mem.readmemd;
   emit_writeword(rs,(int)&address);
   emit_shrimm(rs,16,addr);
   emit_movmem_indexedx4(ftable,addr,addr);
@@ -2910,13 +2910,13 @@ static void inline_readstub(int type, int i, u_int addr, signed char regmap[], i
   assert(rs>=0);
   int ftable=0;
   if(type==LOADB_STUB||type==LOADBU_STUB)
-    ftable=(int)readmemb;
+    ftable=(int)g_dev.mem.readmemb;
   if(type==LOADH_STUB||type==LOADHU_STUB)
-    ftable=(int)readmemh;
+    ftable=(int)g_dev.mem.readmemh;
   if(type==LOADW_STUB)
-    ftable=(int)readmem;
+    ftable=(int)g_dev.mem.readmem;
   if(type==LOADD_STUB)
-    ftable=(int)readmemd;
+    ftable=(int)g_dev.mem.readmemd;
   #ifdef HOST_IMM_ADDR32
   emit_writeword_imm(addr,(int)&address);
   #else
@@ -3019,13 +3019,13 @@ static void do_writestub(int n)
   assert(addr>=0);
   int ftable=0;
   if(type==STOREB_STUB)
-    ftable=(int)writememb;
+    ftable=(int)g_dev.mem.writememb;
   if(type==STOREH_STUB)
-    ftable=(int)writememh;
+    ftable=(int)g_dev.mem.writememh;
   if(type==STOREW_STUB)
-    ftable=(int)writemem;
+    ftable=(int)g_dev.mem.writemem;
   if(type==STORED_STUB)
-    ftable=(int)writememd;
+    ftable=(int)g_dev.mem.writememd;
   emit_writeword(rs,(int)&address);
   emit_shrimm(rs,16,addr);
   emit_movmem_indexedx4(ftable,addr,addr);
@@ -3095,13 +3095,13 @@ static void inline_writestub(int type, int i, u_int addr, signed char regmap[],
   assert(rt>=0);
   int ftable=0;
   if(type==STOREB_STUB)
-    ftable=(int)writememb;
+    ftable=(int)g_dev.mem.writememb;
   if(type==STOREH_STUB)
-    ftable=(int)writememh;
+    ftable=(int)g_dev.mem.writememh;
   if(type==STOREW_STUB)
-    ftable=(int)writemem;
+    ftable=(int)g_dev.mem.writemem;
   if(type==STORED_STUB)
-    ftable=(int)writememd;
+    ftable=(int)g_dev.mem.writememd;
   emit_writeword(rs,(int)&address);
   if(type==STOREB_STUB)
     emit_writebyte(rt,(int)&cpu_byte);
@@ -3516,7 +3516,7 @@ static void loadlr_assemble_x86(int i,struct regstat *i_regs)
   }
   if (opcode[i]==0x22||opcode[i]==0x26) { // LWL/LWR
     if(!c||memtarget) {
-      //emit_readword_indexed((int)g_rdram-0x80000000,temp2,temp2);
+      //emit_readword_indexed((int)g_dev.rdram-0x80000000,temp2,temp2);
       emit_readword_indexed_tlb(0,temp2,map,temp2);
       if(jaddr) add_stub(LOADW_STUB,jaddr,(int)out,i,temp2,(int)i_regs,ccadj[i],reglist);
     }
@@ -3589,8 +3589,8 @@ static void loadlr_assemble_x86(int i,struct regstat *i_regs)
         emit_storereg(rs1[i]|64,get_reg(i_regs->regmap,rs1[i]|64));
     int temp2h=get_reg(i_regs->regmap,FTEMP|64);
     if(!c||memtarget) {
-      //if(th>=0) emit_readword_indexed((int)g_rdram-0x80000000,temp2,temp2h);
-      //emit_readword_indexed((int)g_rdram-0x7FFFFFFC,temp2,temp2);
+      //if(th>=0) emit_readword_indexed((int)g_dev.rdram-0x80000000,temp2,temp2h);
+      //emit_readword_indexed((int)g_dev.rdram-0x7FFFFFFC,temp2,temp2);
       emit_readdword_indexed_tlb(0,temp2,map,temp2h,temp2);
       if(jaddr) add_stub(LOADD_STUB,jaddr,(int)out,i,temp2,(int)i_regs,ccadj[i],reglist);
     }
@@ -20,6 +20,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdint.h>
+#include <string.h>
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -27,13 +28,16 @@
 #include "api/callbacks.h"
 #include "api/debugger.h"
 #include "api/m64p_types.h"
+#include "block_profiler.h"
 /* TLBWrite requires invalid_code and blocks from cached_interp.h, but only if
  * (at run time) the active core is not the Pure Interpreter. */
 #include "cached_interp.h"
 #include "cp0_private.h"
 #include "cp1_private.h"
 #include "exception.h"
+#include "idle_loop.h"
 #include "interupt.h"
+#include "main/device.h"
 #include "main/main.h"
 #include "memory/memory.h"
 #include "osal/preproc.h"
@@ -72,6 +76,7 @@ static void InterpretOpcode(void);
         delay_slot=0; \
         if (take_jump && !skip_jump) \
         { \
+          block_profiler_enter(jump_target); \
           interp_PC.addr = jump_target; \
         } \
       } \
@@ -86,16 +91,21 @@ static void InterpretOpcode(void);
    static void name##_IDLE(uint32_t op) \
    { \
       const int take_jump = (condition); \
+      const uint32_t jump_target = (destination); \
       int skip; \
       if (cop1 && check_cop1_unusable()) return; \
       if (take_jump) \
       { \
          cp0_update_count(); \
          skip = next_interupt - g_cp0_regs[CP0_COUNT_REG]; \
-         if (skip > 3) g_cp0_regs[CP0_COUNT_REG] += (skip & UINT32_C(0xFFFFFFFC)); \
-         else name(op); \
+         if (skip > 3 && (jump_target == PCADDR \
+                  || idle_loop_is_waiting(jump_target, PCADDR))) \
+         { \
+            g_cp0_regs[CP0_COUNT_REG] += (skip & UINT32_C(0xFFFFFFFC)); \
+            if (jump_target == PCADDR) return; \
+         } \
       } \
-      else name(op); \
+      name(op); \
    }
 #define CHECK_MEMORY()
 
@@ -126,6 +136,52 @@ static void InterpretOpcode(void);
 	 && ((addr) & UINT32_C(0x0FFFFFFF)) != UINT32_C(0x0FFFFFFC) \
 	 && *fast_mem_access((addr) + 4) == 0)
 
+/* Decisions of is_relative_polling_loop() by branch address. The words
+ * of the loop are kept with them, so that modified code is decoded again;
+ * comparing them costs much less than idle_loop_detect(). */
+#define POLLING_LOOP_CACHE_SIZE 64
+
+static struct
+{
+	uint32_t addr;
+	unsigned int length;
+	int polling;
+	uint32_t code[IDLE_LOOP_MAX_LENGTH];
+} polling_loop_cache[POLLING_LOOP_CACHE_SIZE];
+
+/* Determines whether a relative jump goes back a few instructions to the
+ * start of a polling loop, see idle_loop_detect(). The loop and its delay
+ * slot must lie in a single page. */
+static int is_relative_polling_loop(uint32_t op, uint32_t addr)
+{
+	uint32_t start = addr + 4 + IMM16S_OF(op) * 4;
+	unsigned int length = 1 - IMM16S_OF(op);
+	const uint32_t *code;
+	size_t entry;
+
+	if (IMM16S_OF(op) >= -1 || IMM16S_OF(op) <= -IDLE_LOOP_MAX_LENGTH
+	    || (start & ~UINT32_C(0xFFF)) != ((addr + 4) & ~UINT32_C(0xFFF)))
+		return 0;
+
+	code = fast_mem_access(start);
+	if (code == NULL)
+		return 0;
+
+	entry = (addr >> 2) & (POLLING_LOOP_CACHE_SIZE - 1);
+	if (polling_loop_cache[entry].addr != addr
+	    || polling_loop_cache[entry].length != length
+	    || memcmp(polling_loop_cache[entry].code, code, length * 4) != 0)
+	{
+		polling_loop_cache[entry].addr = addr;
+		polling_loop_cache[entry].length = length;
+		memcpy(polling_loop_cache[entry].code, code, length * 4);
+		polling_loop_cache[entry].polling = idle_loop_detect(code, length);
+	}
+	return polling_loop_cache[entry].polling;
+}
+
+#define IS_RELATIVE_POLLING_LOOP(op, addr) is_relative_polling_loop(op, addr)
+
 #define SE8(a) ((int64_t) ((int8_t) (a)))
 #define SE16(a) ((int64_t) ((int16_t) (a)))
 #define SE32(a) ((int64_t) ((int32_t) (a)))
@@ -344,19 +400,23 @@ void InterpretOpcode()
 	case 1: /* REGIMM prefix */
 		switch ((op >> 16) & 0x1F) {
 		case 0: /* REGIMM opcode 0: BLTZ */
-			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BLTZ_IDLE(op);
+			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+			    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BLTZ_IDLE(op);
 			else                                     BLTZ(op);
 			break;
 		case 1: /* REGIMM opcode 1: BGEZ */
-			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BGEZ_IDLE(op);
+			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+			    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BGEZ_IDLE(op);
 			else                                     BGEZ(op);
 			break;
 		case 2: /* REGIMM opcode 2: BLTZL */
-			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BLTZL_IDLE(op);
+			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+			    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BLTZL_IDLE(op);
 			else                                     BLTZL(op);
 			break;
 		case 3: /* REGIMM opcode 3: BGEZL */
-			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BGEZL_IDLE(op);
+			if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+			    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BGEZL_IDLE(op);
 			else                                     BGEZL(op);
 			break;
 		case 8: /* REGIMM opcode 8: TGEI (Not implemented) */
@@ -398,19 +458,23 @@ void InterpretOpcode()
 		else                                     JAL(op);
 		break;
 	case 4: /* Major opcode 4: BEQ */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BEQ_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BEQ_IDLE(op);
 		else                                     BEQ(op);
 		break;
 	case 5: /* Major opcode 5: BNE */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BNE_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BNE_IDLE(op);
 		else                                     BNE(op);
 		break;
 	case 6: /* Major opcode 6: BLEZ */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BLEZ_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BLEZ_IDLE(op);
 		else                                     BLEZ(op);
 		break;
 	case 7: /* Major opcode 7: BGTZ */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BGTZ_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BGTZ_IDLE(op);
 		else                                     BGTZ(op);
 		break;
 	case 8: /* Major opcode 8: ADDI */
@@ -621,19 +685,23 @@ void InterpretOpcode()
 		} /* switch ((op >> 21) & 0x1F) for the Coprocessor 1 prefix */
 		break;
 	case 20: /* Major opcode 20: BEQL */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BEQL_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BEQL_IDLE(op);
 		else                                     BEQL(op);
 		break;
 	case 21: /* Major opcode 21: BNEL */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BNEL_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BNEL_IDLE(op);
 		else                                     BNEL(op);
 		break;
 	case 22: /* Major opcode 22: BLEZL */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BLEZL_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BLEZL_IDLE(op);
 		else                                     BLEZL(op);
 		break;
 	case 23: /* Major opcode 23: BGTZL */
-		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)) BGTZL_IDLE(op);
+		if (IS_RELATIVE_IDLE_LOOP(op, PC->addr)
+		    || IS_RELATIVE_POLLING_LOOP(op, PC->addr)) BGTZL_IDLE(op);
 		else                                     BGTZL(op);
 		break;
 	case 24: /* Major opcode 24: DADDI */
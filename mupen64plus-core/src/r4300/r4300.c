@@ -27,12 +27,15 @@
 #include "api/callbacks.h"
 #include "api/debugger.h"
 #include "api/m64p_types.h"
+#include "block_profiler.h"
 #include "cached_interp.h"
 #include "cp0_private.h"
 #include "cp1_private.h"
 #include "interupt.h"
+#include "main/device.h"
 #include "main/main.h"
 #include "main/rom.h"
+#include "main/savestates.h"
 #include "memory/memory.h"
 #include "mi_controller.h"
 #include "new_dynarec/new_dynarec.h"
@@ -46,6 +49,7 @@
 #include "rsp/rsp_core.h"
 #include "si/si_controller.h"
 #include "tlb.h"
+#include "translation_cache.h"
 #include "vi/vi_controller.h"
 
 #ifdef DBG
@@ -127,6 +131,9 @@ void r4300_reset_hard(void)
         tlb_LUT_r[i] = 0;
         tlb_LUT_w[i] = 0;
     }
+    savestates_mark_dirty(SAVESTATE_DIRTY_TLB_LUT_R, 0, 0x100000 * 4);
+    savestates_mark_dirty(SAVESTATE_DIRTY_TLB_LUT_W, 0, 0x100000 * 4);
+    tlb_cache_flush();
     llbit=0;
     hi=0;
     lo=0;
@@ -186,50 +193,50 @@ void r4300_reset_soft(void)
     g_cp0_regs[CP0_STATUS_REG] = 0x34000000;
     g_cp0_regs[CP0_CONFIG_REG] = 0x0006e463;
 
-    g_sp.regs[SP_STATUS_REG] = 1;
-    g_sp.regs2[SP_PC_REG] = 0;
+    g_dev.sp.regs[SP_STATUS_REG] = 1;
+    g_dev.sp.regs2[SP_PC_REG] = 0;
 
-    g_pi.regs[PI_BSD_DOM1_LAT_REG] = (bsd_dom1_config      ) & 0xff;
-    g_pi.regs[PI_BSD_DOM1_PWD_REG] = (bsd_dom1_config >>  8) & 0xff;
-    g_pi.regs[PI_BSD_DOM1_PGS_REG] = (bsd_dom1_config >> 16) & 0x0f;
-    g_pi.regs[PI_BSD_DOM1_RLS_REG] = (bsd_dom1_config >> 20) & 0x03;
-    g_pi.regs[PI_STATUS_REG] = 0;
+    g_dev.pi.regs[PI_BSD_DOM1_LAT_REG] = (bsd_dom1_config      ) & 0xff;
+    g_dev.pi.regs[PI_BSD_DOM1_PWD_REG] = (bsd_dom1_config >>  8) & 0xff;
+    g_dev.pi.regs[PI_BSD_DOM1_PGS_REG] = (bsd_dom1_config >> 16) & 0x0f;
+    g_dev.pi.regs[PI_BSD_DOM1_RLS_REG] = (bsd_dom1_config >> 20) & 0x03;
+    g_dev.pi.regs[PI_STATUS_REG] = 0;
 
-    g_ai.regs[AI_DRAM_ADDR_REG] = 0;
-    g_ai.regs[AI_LEN_REG] = 0;
+    g_dev.ai.regs[AI_DRAM_ADDR_REG] = 0;
+    g_dev.ai.regs[AI_LEN_REG] = 0;
 
-    g_vi.regs[VI_V_INTR_REG] = 1023;
-    g_vi.regs[VI_CURRENT_REG] = 0;
-    g_vi.regs[VI_H_START_REG] = 0;
+    g_dev.vi.regs[VI_V_INTR_REG] = 1023;
+    g_dev.vi.regs[VI_CURRENT_REG] = 0;
+    g_dev.vi.regs[VI_H_START_REG] = 0;
 
-    g_r4300.mi.regs[MI_INTR_REG] &= ~(MI_INTR_PI | MI_INTR_VI | MI_INTR_AI | MI_INTR_SP);
+    g_dev.r4300.mi.regs[MI_INTR_REG] &= ~(MI_INTR_PI | MI_INTR_VI | MI_INTR_AI | MI_INTR_SP);
 
     if ((g_ddrom != NULL) && (g_ddrom_size != 0) && (g_rom == NULL) && (g_rom_size == 0))
     {
       //64DD IPL
-      memcpy((unsigned char*)g_sp.mem+0x40, g_ddrom+0x40, 0xfc0);
+      memcpy((unsigned char*)g_dev.sp.mem+0x40, g_ddrom+0x40, 0xfc0);
     }
     else
     {
       //N64 ROM
-      memcpy((unsigned char*)g_sp.mem+0x40, g_rom+0x40, 0xfc0);
+      memcpy((unsigned char*)g_dev.sp.mem+0x40, g_rom+0x40, 0xfc0);
     }
 
     reg[19] = rom_type;     /* s3 */
     reg[20] = tv_type;      /* s4 */
     reg[21] = reset_type;   /* s5 */
-    reg[22] = g_si.pif.cic.seed;/* s6 */
+    reg[22] = g_dev.si.pif.cic.seed;/* s6 */
     reg[23] = s7;           /* s7 */
 
     /* required by CIC x105 */
-    g_sp.mem[0x1000/4] = 0x3c0dbfc0;
-    g_sp.mem[0x1004/4] = 0x8da807fc;
-    g_sp.mem[0x1008/4] = 0x25ad07c0;
-    g_sp.mem[0x100c/4] = 0x31080080;
-    g_sp.mem[0x1010/4] = 0x5500fffc;
-    g_sp.mem[0x1014/4] = 0x3c0dbfc0;
-    g_sp.mem[0x1018/4] = 0x8da80024;
-    g_sp.mem[0x101c/4] = 0x3c0bb000;
+    g_dev.sp.mem[0x1000/4] = 0x3c0dbfc0;
+    g_dev.sp.mem[0x1004/4] = 0x8da807fc;
+    g_dev.sp.mem[0x1008/4] = 0x25ad07c0;
+    g_dev.sp.mem[0x100c/4] = 0x31080080;
+    g_dev.sp.mem[0x1010/4] = 0x5500fffc;
+    g_dev.sp.mem[0x1014/4] = 0x3c0dbfc0;
+    g_dev.sp.mem[0x1018/4] = 0x8da80024;
+    g_dev.sp.mem[0x101c/4] = 0x3c0bb000;
 
     /* required by CIC x105 */
     reg[11] = INT64_C(0xffffffffa4000040); /* t3 */
@@ -247,7 +254,7 @@ static void dynarec_setup_code(void)
    jump_to(UINT32_C(0xa4000040));
 
    // Prevent segfault on failed jump_to
-   if (!actual->block || !actual->code)
+   if (!actual || !actual->block || !actual->code)
       dyna_stop();
 }
 #endif
@@ -263,6 +270,7 @@ void r4300_execute(void)
     last_addr = 0xa4000040;
     next_interupt = 624999;
     init_interupt();
+    block_profiler_reset();
 
     if (r4300emu == CORE_PURE_INTERPRETER)
     {
@@ -271,11 +279,15 @@ void r4300_execute(void)
         pure_interpreter();
     }
 #if defined(DYNAREC)
-    else if (r4300emu >= 2)
+    else if (r4300emu >= 2 && r4300emu != CORE_CACHED_THREADED)
     {
         DebugMessage(M64MSG_INFO, "Starting R4300 emulator: Dynamic Recompiler");
         r4300emu = CORE_DYNAREC;
         init_blocks();
+#ifndef NEW_DYNAREC
+        if (translation_cache_enabled)
+            translation_cache_open(ROM_SETTINGS.MD5);
+#endif
 
 #ifdef NEW_DYNAREC
         new_dynarec_init();
@@ -285,27 +297,40 @@ void r4300_execute(void)
         dyna_start(dynarec_setup_code);
         PC++;
 #endif
+        translation_cache_close();
         free_blocks();
     }
 #endif
-    else /* if (r4300emu == CORE_INTERPRETER) */
+    else /* if (r4300emu == CORE_INTERPRETER || r4300emu == CORE_CACHED_THREADED) */
     {
-        DebugMessage(M64MSG_INFO, "Starting R4300 emulator: Cached Interpreter");
-        r4300emu = CORE_INTERPRETER;
+        if (r4300emu == CORE_CACHED_THREADED)
+            DebugMessage(M64MSG_INFO, "Starting R4300 emulator: Cached Interpreter (threaded dispatch)");
+        else
+        {
+            DebugMessage(M64MSG_INFO, "Starting R4300 emulator: Cached Interpreter");
+            r4300emu = CORE_INTERPRETER;
+        }
         init_blocks();
+        if (translation_cache_enabled)
+            translation_cache_open(ROM_SETTINGS.MD5);
         jump_to(UINT32_C(0xa4000040));
 
         /* Prevent segfault on failed jump_to */
-        if (!actual->block)
-            return;
-
-        last_addr = PC->addr;
+        if (actual && actual->block)
+        {
+            last_addr = PC->addr;
 
-        r4300_step();
+            if (r4300emu == CORE_CACHED_THREADED)
+                cached_interpreter_threaded();
+            else
+                r4300_step();
+        }
 
+        translation_cache_close();
         free_blocks();
     }
 
+    block_profiler_dump(ROM_SETTINGS.MD5);
     DebugMessage(M64MSG_INFO, "R4300 emulator finished.");
 }
 
@@ -53,6 +53,7 @@ void r4300_step(void);
 #define CORE_PURE_INTERPRETER 0
 #define CORE_INTERPRETER      1
 #define CORE_DYNAREC          2
+#define CORE_CACHED_THREADED  4 /* cached interpreter, threaded dispatch */
 
 #endif /* M64P_R4300_R4300_H */
 
@@ -26,6 +26,7 @@
 #include "new_dynarec/new_dynarec.h"
 #include "r4300.h"
 #include "recomp.h"
+#include "translation_cache.h"
 
 void init_r4300(struct r4300_core* r4300)
 {
@@ -90,19 +91,23 @@ void invalidate_r4300_cached_code(uint32_t address, size_t size)
 }
 
 /* XXX: not really a good interface but it gets the job done... */
-void savestates_load_set_pc(uint32_t pc)
+void savestates_load_set_pc(uint32_t pc, int invalidate_all)
 {
 #ifdef NEW_DYNAREC
     if (r4300emu == CORE_DYNAREC)
     {
         pcaddr = pc;
         pending_exception = 1;
-        invalidate_all_pages();
+        if (invalidate_all)
+            invalidate_all_pages();
     }
     else
 #endif
     {
+        if (invalidate_all)
+            invalidate_r4300_cached_code(0,0);
+        if (r4300emu != CORE_PURE_INTERPRETER)
+            translation_cache_warm_rdram();
         generic_jump_to(pc);
-        invalidate_r4300_cached_code(0,0);
     }
 }
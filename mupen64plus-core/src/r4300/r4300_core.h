@@ -34,6 +34,8 @@
 struct r4300_core
 {
     struct mi_controller mi;
+
+    struct interrupt_queue q;
 };
 
 void init_r4300(struct r4300_core* r4300);
@@ -62,6 +64,8 @@ void invalidate_r4300_cached_code(uint32_t address, size_t size);
  * Use this for common code which can be executed from any r4300 emulator. */
 void generic_jump_to(uint32_t address);
 
-void savestates_load_set_pc(uint32_t pc);
+/* Resume execution at pc after a savestate load. With invalidate_all == 0
+ * the caller is responsible for invalidating the code it overwrote. */
+void savestates_load_set_pc(uint32_t pc, int invalidate_all);
 
 #endif
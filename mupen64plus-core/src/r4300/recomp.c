@@ -39,6 +39,7 @@
 #include "api/m64p_types.h"
 #include "cached_interp.h"
 #include "cp0_private.h"
+#include "idle_loop.h"
 #include "main/profile.h"
 #include "memory/memory.h"
 #include "ops.h"
@@ -49,6 +50,10 @@
 
 static void *malloc_exec(size_t size);
 static void free_exec(void *ptr, size_t length);
+static int in_code_cache(const void *ptr);
+static void *alloc_code(size_t size);
+static void trim_code(precomp_block *block);
+static void free_code(void *ptr, size_t length);
 
 /* global variables : */
 precomp_instr *dst           = NULL; /* destination structure for the recompiled instruction */
@@ -59,6 +64,23 @@ int code_length;                     /* current real recompiled code length */
 int max_code_length;                 /* current recompiled code's buffer length */
 uint32_t src;                        /* the current recompiled instruction */
 int fast_memory;
+/* RDRAM offsets [start, end) that have held framebuffers; recompiled code
+ * checks the region handler of accesses in that range, see fb.c */
+uint32_t fast_memory_fb_start;
+uint32_t fast_memory_fb_end;
+size_t code_cache_limit = 64 * 1024 * 1024; /* size of the dynarec code cache */
+int code_cache_full;                 /* the code cache must be flushed */
+
+/* The dynarec emits all of its code into one executable region, handing
+ * out per-block buffers by bumping code_cache_used. Buffers are only
+ * reclaimed all at once, when free_blocks() flushes the whole cache. */
+static unsigned char *code_cache = NULL;
+static size_t code_cache_size;
+static size_t code_cache_used;
+static unsigned int code_cache_flushes;
+static int code_cache_failed;
+
+#define CODE_ALIGN(size) (((size) + 15) & ~(size_t)15)
 
 static void (*recomp_func)(void); /* pointer to the dynarec's generator
                                    * function for the latest decoded opcode */
@@ -67,6 +89,21 @@ static const uint32_t *SRC  = NULL;  /* currently recompiled instruction in the
 static int delay_slot_compiled = 0;
 static int check_nop;                /* next instruction is NOP ? */
 
+/* Backward branch to the start of a polling loop within the block? */
+static int is_polling_loop(uint32_t target)
+{
+   uint32_t length;
+
+   /* the loop and the delay slot after the branch must be in the block */
+   if (target >= dst->addr || target < dst_block->start
+         || dst->addr + 4 >= dst_block->end)
+      return 0;
+
+   length = (dst->addr - target) / 4 + 2;
+   return length <= IDLE_LOOP_MAX_LENGTH
+      && idle_loop_detect(SRC - (length - 2), length);
+}
+
 static void RSV(void)
 {
    dst->ops = current_instruction_table.RESERVED;
@@ -552,6 +589,11 @@ static void RBLTZ(void)
       dst->ops = current_instruction_table.BLTZ_OUT;
       recomp_func = genbltz_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BLTZ_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBGEZ(void)
@@ -574,6 +616,11 @@ static void RBGEZ(void)
       dst->ops = current_instruction_table.BGEZ_OUT;
       recomp_func = genbgez_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BGEZ_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBLTZL(void)
@@ -596,6 +643,11 @@ static void RBLTZL(void)
       dst->ops = current_instruction_table.BLTZL_OUT;
       recomp_func = genbltzl_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BLTZL_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBGEZL(void)
@@ -618,6 +670,11 @@ static void RBGEZL(void)
       dst->ops = current_instruction_table.BGEZL_OUT;
       recomp_func = genbgezl_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BGEZL_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RTGEI(void)
@@ -1679,6 +1736,11 @@ static void RBEQ(void)
       dst->ops = current_instruction_table.BEQ_OUT;
       recomp_func = genbeq_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BEQ_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBNE(void)
@@ -1701,6 +1763,11 @@ static void RBNE(void)
       dst->ops = current_instruction_table.BNE_OUT;
       recomp_func = genbne_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BNE_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBLEZ(void)
@@ -1723,6 +1790,11 @@ static void RBLEZ(void)
       dst->ops = current_instruction_table.BLEZ_OUT;
       recomp_func = genblez_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BLEZ_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBGTZ(void)
@@ -1745,6 +1817,11 @@ static void RBGTZ(void)
       dst->ops = current_instruction_table.BGTZ_OUT;
       recomp_func = genbgtz_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BGTZ_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RADDI(void)
@@ -1841,6 +1918,11 @@ static void RBEQL(void)
       dst->ops = current_instruction_table.BEQL_OUT;
       recomp_func = genbeql_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BEQL_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBNEL(void)
@@ -1863,6 +1945,11 @@ static void RBNEL(void)
       dst->ops = current_instruction_table.BNEL_OUT;
       recomp_func = genbnel_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BNEL_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBLEZL(void)
@@ -1885,6 +1972,11 @@ static void RBLEZL(void)
       dst->ops = current_instruction_table.BLEZL_OUT;
       recomp_func = genblezl_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BLEZL_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RBGTZL(void)
@@ -1907,6 +1999,11 @@ static void RBGTZL(void)
       dst->ops = current_instruction_table.BGTZL_OUT;
       recomp_func = genbgtzl_out;
    }
+   else if (is_polling_loop(target))
+   {
+      dst->ops = current_instruction_table.BGTZL_IDLE;
+      recomp_func = genidle_loop;
+   }
 }
 
 static void RDADDI(void)
@@ -2169,6 +2266,8 @@ void init_block(precomp_block *block)
 #endif
 
   length = get_block_length(block);
+  memset(block->code_map, 0, sizeof(block->code_map));
+  block->tcache_hash_valid = 0;
    
   if (!block->block)
   {
@@ -2181,7 +2280,7 @@ void init_block(precomp_block *block)
         }
     }
     else {
-        block->block = (precomp_instr *) malloc(memsize);
+        block->block = (precomp_instr *) alloc_block_instructions(memsize);
         if (!block->block) {
             DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate memory for cached interpreter.");
             return;
@@ -2194,10 +2293,12 @@ void init_block(precomp_block *block)
 
   if (r4300emu == CORE_DYNAREC)
   {
+    /* the code is about to be rewritten from scratch */
+    dyna_unlink_block(block);
     if (!block->code)
     {
       max_code_length = 32768;
-      block->code = (unsigned char *) malloc_exec(max_code_length);
+      block->code = (unsigned char *) alloc_code(max_code_length);
     }
     else
     {
@@ -2254,7 +2355,10 @@ void init_block(precomp_block *block)
     block->code_length = code_length;
     block->max_code_length = max_code_length;
     free_assembler(&block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number);
+    trim_code(block);
   }
+  else if (r4300emu == CORE_CACHED_THREADED)
+    cached_threaded_annotate(block->block, block->block + length);
    
   /* here we're marking the block as a valid code even if it's not compiled
    * yet as the game should have already set up the code correctly.
@@ -2262,68 +2366,62 @@ void init_block(precomp_block *block)
   invalid_code[block->start>>12] = 0;
   if (block->end < UINT32_C(0x80000000) || block->start >= UINT32_C(0xc0000000))
   { 
+    /* a mirror that couldn't get a block stays invalid, so that the
+     * next jump to it tries again */
     uint32_t paddr = virtual_to_physical_address(block->start, 2);
-    invalid_code[paddr>>12] = 0;
-    if (!blocks[paddr>>12])
+    if (blocks[paddr>>12] || new_block(paddr))
     {
-      blocks[paddr>>12] = (precomp_block *) malloc(sizeof(precomp_block));
-      blocks[paddr>>12]->code = NULL;
-      blocks[paddr>>12]->block = NULL;
-      blocks[paddr>>12]->jumps_table = NULL;
-      blocks[paddr>>12]->riprel_table = NULL;
-      blocks[paddr>>12]->start = paddr & ~UINT32_C(0xFFF);
-      blocks[paddr>>12]->end = (paddr & ~UINT32_C(0xFFF)) + UINT32_C(0x1000);
+      invalid_code[paddr>>12] = 0;
+      init_block(blocks[paddr>>12]);
     }
-    init_block(blocks[paddr>>12]);
     
     paddr += block->end - block->start - 4;
-    invalid_code[paddr>>12] = 0;
-    if (!blocks[paddr>>12])
+    if (blocks[paddr>>12] || new_block(paddr))
     {
-      blocks[paddr>>12] = (precomp_block *) malloc(sizeof(precomp_block));
-      blocks[paddr>>12]->code = NULL;
-      blocks[paddr>>12]->block = NULL;
-      blocks[paddr>>12]->jumps_table = NULL;
-      blocks[paddr>>12]->riprel_table = NULL;
-      blocks[paddr>>12]->start = paddr & ~UINT32_C(0xFFF);
-      blocks[paddr>>12]->end = (paddr & ~UINT32_C(0xFFF)) + UINT32_C(0x1000);
+      invalid_code[paddr>>12] = 0;
+      init_block(blocks[paddr>>12]);
     }
-    init_block(blocks[paddr>>12]);
   }
   else
   {
     uint32_t alt_addr = block->start ^ UINT32_C(0x20000000);
 
-    if (invalid_code[alt_addr>>12])
-    {
-      if (!blocks[alt_addr>>12])
-      {
-        blocks[alt_addr>>12] = (precomp_block *) malloc(sizeof(precomp_block));
-        blocks[alt_addr>>12]->code = NULL;
-        blocks[alt_addr>>12]->block = NULL;
-        blocks[alt_addr>>12]->jumps_table = NULL;
-        blocks[alt_addr>>12]->riprel_table = NULL;
-        blocks[alt_addr>>12]->start = alt_addr & ~UINT32_C(0xFFF);
-        blocks[alt_addr>>12]->end = (alt_addr & ~UINT32_C(0xFFF)) + UINT32_C(0x1000);
-      }
+    if (invalid_code[alt_addr>>12] && (blocks[alt_addr>>12] || new_block(alt_addr)))
       init_block(blocks[alt_addr>>12]);
-    }
   }
   timed_section_end(TIMED_SECTION_COMPILER);
 }
 
+/* Returns non-zero if any word in [first, last] of the page was compiled. */
+int block_has_code(const precomp_block *block, unsigned int first, unsigned int last)
+{
+  unsigned int w = first >> 5;
+  unsigned int w_last = last >> 5;
+  uint32_t mask = ~UINT32_C(0) << (first & 31);
+
+  for (; w < w_last; w++, mask = ~UINT32_C(0))
+    if (block->code_map[w] & mask)
+      return 1;
+
+  mask &= ~UINT32_C(0) >> (31 - (last & 31));
+  return (block->code_map[w] & mask) != 0;
+}
+
 void free_block(precomp_block *block)
 {
     size_t memsize = get_block_memsize(block);
 
     if (block->block) {
+        /* the cached interpreter's arrays go away with the block arena */
         if (r4300emu == CORE_DYNAREC)
             free_exec(block->block, memsize);
-        else
-            free(block->block);
         block->block = NULL;
     }
-    if (block->code) { free_exec(block->code, block->max_code_length); block->code = NULL; }
+    if (block->code) {
+        dyna_unlink_block(block);
+        free_code(block->code, block->max_code_length);
+        block->code = NULL;
+    }
     if (block->jumps_table) { free(block->jumps_table); block->jumps_table = NULL; }
     if (block->riprel_table) { free(block->riprel_table); block->riprel_table = NULL; }
 }
@@ -2335,6 +2433,7 @@ void recompile_block(const uint32_t *source, precomp_block *block, uint32_t func
 {
    uint32_t i;
    int length, finished=0;
+   unsigned char *old_code = block->code;
    timed_section_start(TIMED_SECTION_COMPILER);
    length = (block->end-block->start)/4;
    dst_block = block;
@@ -2358,7 +2457,10 @@ void recompile_block(const uint32_t *source, precomp_block *block, uint32_t func
           uint32_t address2 =
            virtual_to_physical_address(block->start + i*4, 0);
          if(blocks[address2>>12]->block[(address2&UINT32_C(0xFFF))/4].ops == current_instruction_table.NOTCOMPILED)
+         {
            blocks[address2>>12]->block[(address2&UINT32_C(0xFFF))/4].ops = current_instruction_table.NOTCOMPILED2;
+           block_mark_code(blocks[address2>>12], (address2&UINT32_C(0xFFF))/4);
+         }
       }
     
     SRC = source + i;
@@ -2372,6 +2474,8 @@ void recompile_block(const uint32_t *source, precomp_block *block, uint32_t func
     recomp_ops[((src >> 26) & 0x3F)]();
     if (r4300emu == CORE_DYNAREC) recomp_func();
     dst = block->block + i;
+    if (i < 0x1000 / 4 && dst->ops != current_instruction_table.NOTCOMPILED)
+      block_mark_code(block, i);
 
     /*if ((dst+1)->ops != NOTCOMPILED && !delay_slot_compiled &&
         i < length)
@@ -2399,6 +2503,13 @@ void recompile_block(const uint32_t *source, precomp_block *block, uint32_t func
       finished = 1;
      }
 
+   if (r4300emu == CORE_INTERPRETER)
+     {
+    /* also look at the pair ending at the first compiled instruction */
+    uint32_t first = (func & 0xFFF) / 4;
+    fuse_superinstructions(block->block + (first ? first - 1 : 0), block->block + i);
+     }
+
    if (i >= length)
      {
     dst = block->block + i;
@@ -2428,6 +2539,16 @@ void recompile_block(const uint32_t *source, precomp_block *block, uint32_t func
     block->code_length = code_length;
     block->max_code_length = max_code_length;
     free_assembler(&block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number);
+    /* growing the buffer may have moved it, leaving linked sites
+     * pointing at the old copy */
+    if (block->code != old_code)
+      dyna_unlink_incoming(block);
+    trim_code(block);
+     }
+   else if (r4300emu == CORE_CACHED_THREADED)
+     {
+    uint32_t first = (func & 0xFFF) / 4;
+    cached_threaded_annotate(block->block + first, block->block + i);
      }
 #ifdef CORE_DBG
    DebugMessage(M64MSG_INFO, "block recompiled (%" PRIX32 "-%" PRIX32 ")", func, block->start+i*4);
@@ -2569,11 +2690,26 @@ static void *malloc_exec(size_t size)
 }
 
 /**********************************************************************
- ************* reallocate memory with executable bit set **************
+ ************* reallocate a code buffer from the code cache ***********
  **********************************************************************/
 void *realloc_exec(void *ptr, size_t oldsize, size_t newsize)
 {
-   void* block = malloc_exec(newsize);
+   void* block;
+
+   /* the most recent buffer can simply grow in place */
+   if (in_code_cache(ptr))
+   {
+      size_t offset = (unsigned char *)ptr - code_cache;
+
+      if (offset + CODE_ALIGN(oldsize) == code_cache_used
+            && offset + CODE_ALIGN(newsize) <= code_cache_size)
+      {
+         code_cache_used = offset + CODE_ALIGN(newsize);
+         return ptr;
+      }
+   }
+
+   block = alloc_code(newsize);
    if (block != NULL)
    {
       size_t copysize;
@@ -2583,10 +2719,90 @@ void *realloc_exec(void *ptr, size_t oldsize, size_t newsize)
          copysize = newsize;
       memcpy(block, ptr, copysize);
    }
-   free_exec(ptr, oldsize);
+   free_code(ptr, oldsize);
    return block;
 }
 
+/**********************************************************************
+ ************************ dynarec code cache **************************
+ **********************************************************************/
+static int in_code_cache(const void *ptr)
+{
+   return code_cache && (const unsigned char *)ptr >= code_cache
+      && (const unsigned char *)ptr < code_cache + code_cache_size;
+}
+
+static void *alloc_code(size_t size)
+{
+   if (!code_cache && !code_cache_failed)
+   {
+      code_cache_size = code_cache_limit;
+      code_cache = (unsigned char *) malloc_exec(code_cache_size);
+      code_cache_used = 0;
+      code_cache_failed = (code_cache == NULL);
+   }
+
+   if (!code_cache)
+      return malloc_exec(size);
+
+   if (code_cache_size - code_cache_used >= CODE_ALIGN(size))
+   {
+      void *ptr = code_cache + code_cache_used;
+      code_cache_used += CODE_ALIGN(size);
+      return ptr;
+   }
+
+   /* Keep going with a separate mapping until the cache can be flushed
+    * at a point where no recompiled code is running. */
+   if (!code_cache_full)
+      DebugMessage(M64MSG_INFO, "Dynarec code cache full (%u KB), flush scheduled",
+            (unsigned int)(code_cache_size >> 10));
+   code_cache_full = 1;
+   return malloc_exec(size);
+}
+
+/* Gives the unused tail of a block's buffer back to the cache. Blocks are
+ * allocated generously and compiled right away, so the block is usually
+ * still the last one in the cache; if it needs more room later it grows
+ * through realloc_exec(). */
+static void trim_code(precomp_block *block)
+{
+   size_t size = CODE_ALIGN(block->max_code_length);
+   /* the assembler needs code_length < max_code_length */
+   size_t keep = CODE_ALIGN(block->code_length + 1);
+
+   if (keep >= size || !in_code_cache(block->code)
+         || block->code + size != code_cache + code_cache_used)
+      return;
+
+   code_cache_used -= size - keep;
+   block->max_code_length = keep;
+}
+static void free_code(void *ptr, size_t length)
+{
+   if (!in_code_cache(ptr))
+      free_exec(ptr, length);
+}
+
+void free_code_cache(void)
+{
+   if (code_cache)
+      free_exec(code_cache, code_cache_size);
+   if (code_cache_full)
+      code_cache_flushes++;
+   code_cache = NULL;
+   code_cache_used = 0;
+   code_cache_full = 0;
+   code_cache_failed = 0;
+}
+
+void get_code_cache_stats(struct code_cache_stats *stats)
+{
+   stats->size = code_cache ? code_cache_size : code_cache_limit;
+   stats->used = code_cache_used;
+   stats->flushes = code_cache_flushes;
+}
+
 /**********************************************************************
  **************** frees memory with executable bit set ****************
  **********************************************************************/
@@ -68,10 +68,13 @@ typedef struct _precomp_instr
       } cf;
      } f;
    uint32_t addr; /* word-aligned instruction address in r4300 address space */
-   unsigned int local_addr; /* byte offset to start of corresponding x86_64 instructions, from start of code block */
+   unsigned int local_addr; /* byte offset to start of corresponding x86_64 instructions, from start of code block
+                               (cached threaded dispatch: index of the inline handler, see cached_threaded_annotate) */
    reg_cache_struct reg_cache_infos;
 } precomp_instr;
 
+struct block_link;
+
 typedef struct _precomp_block
 {
    precomp_instr *block;
@@ -86,20 +89,51 @@ typedef struct _precomp_block
    int riprel_number;
    //unsigned char md5[16];
    unsigned int adler32;
+   /* one bit per word of the page, set once the word has been compiled */
+   uint32_t code_map[0x1000 / 4 / 32];
+   /* dynarec jumps chained directly into / out of this block's code */
+   struct block_link *links_in;
+   struct block_link *links_out;
+   /* translation cache hash of the page contents, dropped by init_block() */
+   uint32_t tcache_hash;
+   int tcache_hash_valid;
 } precomp_block;
 
+#define block_mark_code(b, i) \
+   ((b)->code_map[(i) >> 5] |= UINT32_C(1) << ((i) & 31))
+
+int block_has_code(const precomp_block *block, unsigned int first, unsigned int last);
+
 void recompile_block(const uint32_t *source, precomp_block *block, uint32_t func);
 void init_block(precomp_block *block);
 void free_block(precomp_block *block);
 void recompile_opcode(void);
 void dyna_jump(void);
+void dyna_link_jump(void);
+extern precomp_block *link_source;
+extern unsigned int link_site;
+void dyna_unlink_block(precomp_block *block);
+void dyna_unlink_incoming(precomp_block *block);
 void dyna_start(void *code);
 void dyna_stop(void);
 void *realloc_exec(void *ptr, size_t oldsize, size_t newsize);
 
+struct code_cache_stats
+{
+   size_t size;
+   size_t used;
+   unsigned int flushes;
+};
+
+/* Releases the dynarec code cache; only valid once all blocks are freed. */
+void free_code_cache(void);
+void get_code_cache_stats(struct code_cache_stats *stats);
+
 extern precomp_instr *dst; /* precomp_instr structure for instruction being recompiled */
 
 extern int no_compiled_jump;
+extern size_t code_cache_limit;
+extern int code_cache_full;
 
 #ifdef DYNAREC
 #include "hacktarux_dynarec/assemble.h"
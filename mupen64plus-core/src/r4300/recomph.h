@@ -29,6 +29,8 @@ extern int max_code_length;
 extern unsigned char **inst_pointer;
 extern precomp_block* dst_block;
 extern int fast_memory;
+extern uint32_t fast_memory_fb_start;
+extern uint32_t fast_memory_fb_end;
 extern uint32_t src;   /* opcode of r4300 instruction being recompiled */
 
 void passe2(precomp_instr *dest, int start, int end, precomp_block* block);
@@ -139,6 +141,7 @@ void genc_le_d(void);
 void genbgezal_idle(void);
 void genj_idle(void);
 void genbeq_idle(void);
+void genidle_loop(void);
 void genlh(void);
 void genmov_d(void);
 void genc_lt_d(void);
@@ -280,6 +283,7 @@ void gensdr(void);
 void genlink_subblock(void);
 void gendelayslot(void);
 void gencheck_interupt_reg(void);
+void genprofile_block(void);
 void gentest(void);
 void gentest_out(void);
 void gentest_idle(void);
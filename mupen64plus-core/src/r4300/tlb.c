@@ -23,33 +23,81 @@
 
 #include "api/m64p_types.h"
 #include "exception.h"
+#include "main/device.h"
 #include "main/rom.h"
+#include "main/savestates.h"
 
 tlb tlb_e[32];
 
 uint32_t tlb_LUT_r[0x100000];
 uint32_t tlb_LUT_w[0x100000];
 
+/* The LUTs are 4MB each, so lookups for scattered pages mostly miss the
+ * host's data cache. Recent translations are kept in these small tables
+ * instead, which also spares the LUT walk on every mapped load/store. */
+struct tlb_cache_entry tlb_cache[2][TLB_CACHE_SIZE];
+
+void tlb_cache_flush(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < TLB_CACHE_SIZE; i++)
+    {
+        tlb_cache[0][i].vpage = UINT32_C(0xFFFFFFFF);
+        tlb_cache[1][i].vpage = UINT32_C(0xFFFFFFFF);
+    }
+}
+
+static uint32_t tlb_cache_fill(uint32_t addresse, int w, uint32_t lut)
+{
+    struct tlb_cache_entry *e = &tlb_cache[w == 1][(addresse >> 12) & (TLB_CACHE_SIZE - 1)];
+    uint32_t phys = lut & UINT32_C(0x1FFFF000);
+
+    e->vpage = addresse >> 12;
+    e->paddr = lut & UINT32_C(0xFFFFF000);
+    e->host = (phys < g_dev.ri.rdram.dram_size)
+        ? g_dev.ri.rdram.dram + phys / 4 : NULL;
+
+    return e->paddr | (addresse & UINT32_C(0xFFF));
+}
+
+/* Marks the lookup table entries of [start, end) for incremental savestates */
+static void mark_lut(unsigned int area, unsigned int start, unsigned int end)
+{
+    if (start < end)
+        savestates_mark_dirty(area, (start >> 12) * 4, (((end - 1) >> 12) - (start >> 12) + 1) * 4);
+}
+
 void tlb_unmap(tlb *entry)
 {
     unsigned int i;
 
+    tlb_cache_flush();
+
     if (entry->v_even)
     {
+        mark_lut(SAVESTATE_DIRTY_TLB_LUT_R, entry->start_even, entry->end_even);
         for (i=entry->start_even; i<entry->end_even; i += 0x1000)
             tlb_LUT_r[i>>12] = 0;
         if (entry->d_even)
+        {
+            mark_lut(SAVESTATE_DIRTY_TLB_LUT_W, entry->start_even, entry->end_even);
             for (i=entry->start_even; i<entry->end_even; i += 0x1000)
                 tlb_LUT_w[i>>12] = 0;
+        }
     }
 
     if (entry->v_odd)
     {
+        mark_lut(SAVESTATE_DIRTY_TLB_LUT_R, entry->start_odd, entry->end_odd);
         for (i=entry->start_odd; i<entry->end_odd; i += 0x1000)
             tlb_LUT_r[i>>12] = 0;
         if (entry->d_odd)
+        {
+            mark_lut(SAVESTATE_DIRTY_TLB_LUT_W, entry->start_odd, entry->end_odd);
             for (i=entry->start_odd; i<entry->end_odd; i += 0x1000)
                 tlb_LUT_w[i>>12] = 0;
+        }
     }
 }
 
@@ -57,17 +105,23 @@ void tlb_map(tlb *entry)
 {
     unsigned int i;
 
+    tlb_cache_flush();
+
     if (entry->v_even)
     {
         if (entry->start_even < entry->end_even &&
             !(entry->start_even >= 0x80000000 && entry->end_even < 0xC0000000) &&
             entry->phys_even < 0x20000000)
         {
+            mark_lut(SAVESTATE_DIRTY_TLB_LUT_R, entry->start_even, entry->end_even);
             for (i=entry->start_even;i<entry->end_even;i+=0x1000)
                 tlb_LUT_r[i>>12] = UINT32_C(0x80000000) | (entry->phys_even + (i - entry->start_even) + 0xFFF);
             if (entry->d_even)
+            {
+                mark_lut(SAVESTATE_DIRTY_TLB_LUT_W, entry->start_even, entry->end_even);
                 for (i=entry->start_even;i<entry->end_even;i+=0x1000)
                     tlb_LUT_w[i>>12] = UINT32_C(0x80000000) | (entry->phys_even + (i - entry->start_even) + 0xFFF);
+            }
         }
     }
 
@@ -77,17 +131,27 @@ void tlb_map(tlb *entry)
             !(entry->start_odd >= 0x80000000 && entry->end_odd < 0xC0000000) &&
             entry->phys_odd < 0x20000000)
         {
+            mark_lut(SAVESTATE_DIRTY_TLB_LUT_R, entry->start_odd, entry->end_odd);
             for (i=entry->start_odd;i<entry->end_odd;i+=0x1000)
                 tlb_LUT_r[i>>12] = UINT32_C(0x80000000) | (entry->phys_odd + (i - entry->start_odd) + 0xFFF);
             if (entry->d_odd)
+            {
+                mark_lut(SAVESTATE_DIRTY_TLB_LUT_W, entry->start_odd, entry->end_odd);
                 for (i=entry->start_odd;i<entry->end_odd;i+=0x1000)
                     tlb_LUT_w[i>>12] = UINT32_C(0x80000000) | (entry->phys_odd + (i - entry->start_odd) + 0xFFF);
+            }
         }
     }
 }
 
 uint32_t virtual_to_physical_address(uint32_t addresse, int w)
 {
+    const struct tlb_cache_entry *e = tlb_cache_find(addresse, w);
+
+    /* only LUT hits are cached, so the GoldenEye range never is */
+    if (e != NULL)
+        return e->paddr | (addresse & UINT32_C(0xFFF));
+
     if (addresse >= UINT32_C(0x7f000000) && addresse < UINT32_C(0x80000000) && isGoldeneyeRom)
     {
         /**************************************************
@@ -115,12 +179,12 @@ uint32_t virtual_to_physical_address(uint32_t addresse, int w)
     if (w == 1)
     {
         if (tlb_LUT_w[addresse>>12])
-            return (tlb_LUT_w[addresse>>12] & UINT32_C(0xFFFFF000)) | (addresse & UINT32_C(0xFFF));
+            return tlb_cache_fill(addresse, w, tlb_LUT_w[addresse>>12]);
     }
     else
     {
         if (tlb_LUT_r[addresse>>12])
-            return (tlb_LUT_r[addresse>>12] & UINT32_C(0xFFFFF000)) | (addresse & UINT32_C(0xFFF));
+            return tlb_cache_fill(addresse, w, tlb_LUT_r[addresse>>12]);
     }
 
     //printf("tlb exception !!! @ %x, %x, add:%x\n", addresse, w, PC->addr);
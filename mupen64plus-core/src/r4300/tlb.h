@@ -22,8 +22,11 @@
 #ifndef M64P_R4300_TLB_H
 #define M64P_R4300_TLB_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <retro_inline.h>
+
 typedef struct _tlb
 {
    short mask;
@@ -53,6 +56,31 @@ extern tlb tlb_e[32];
 extern uint32_t tlb_LUT_r[0x100000];
 extern uint32_t tlb_LUT_w[0x100000];
 
+/* Direct-mapped cache of recent tlb_LUT_r/tlb_LUT_w hits, indexed by
+ * the low bits of the virtual page number. */
+#define TLB_CACHE_SIZE 64
+
+struct tlb_cache_entry
+{
+   uint32_t vpage;   /* virtual address >> 12, ~0 when empty */
+   uint32_t paddr;   /* translated page, as stored in the LUT */
+   uint32_t *host;   /* the page in RDRAM, NULL if it isn't RDRAM */
+};
+
+/* [0] for reads and code fetches, [1] for writes */
+extern struct tlb_cache_entry tlb_cache[2][TLB_CACHE_SIZE];
+
+static INLINE const struct tlb_cache_entry *tlb_cache_find(uint32_t addresse, int w)
+{
+   const struct tlb_cache_entry *e =
+      &tlb_cache[w == 1][(addresse >> 12) & (TLB_CACHE_SIZE - 1)];
+
+   return (e->vpage == addresse >> 12) ? e : NULL;
+}
+
+/* Must be called whenever tlb_LUT_r or tlb_LUT_w change. */
+void tlb_cache_flush(void);
+
 void tlb_unmap(tlb *entry);
 void tlb_map(tlb *entry);
 uint32_t virtual_to_physical_address(uint32_t addresse, int w);
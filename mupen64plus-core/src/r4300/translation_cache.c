@@ -0,0 +1,382 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - translation_cache.c                                     *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2016 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "translation_cache.h"
+
+#include "api/callbacks.h"
+#include "api/m64p_config.h"
+#include "api/m64p_types.h"
+#include "cached_interp.h"
+#include "main/device.h"
+#include "main/util.h"
+#include "r4300.h"
+
+/* The host code emitted by the dynarec holds absolute addresses of the
+ * emulator state and of other blocks, so it cannot be reused by another
+ * process. What is stored instead is the set of entry points of every
+ * page, keyed by the virtual page address and a hash of its contents;
+ * translating them is then done up front rather than on first use. */
+
+#define TCACHE_MAGIC     "M64+TCCH"
+#define TCACHE_VERSION   1
+#define TCACHE_MAX_PAGES (1 << 16)
+
+struct tcache_page
+{
+   uint32_t vaddr;
+   uint32_t hash;
+   uint32_t entries[0x1000 / 4 / 32]; /* one bit per word of the page */
+};
+
+struct tcache_header
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t count;
+};
+
+int translation_cache_enabled = 0;
+
+static struct tcache_page *pages = NULL;
+static uint32_t page_count;
+static uint32_t page_capacity;
+
+/* open addressing table of page indices + 1, 0 marks a free slot */
+static uint32_t *slots = NULL;
+static uint32_t slot_mask;
+
+/* direct-mapped RDRAM pages that have at least one entry in the index */
+static uint32_t rdram_pages_known[RDRAM_MAX_SIZE / 0x1000 / 32];
+
+static char *cache_path = NULL;
+static int cache_dirty;
+static int warm_requested;
+
+static uint32_t page_hash(const uint32_t *source)
+{
+   uint32_t h = UINT32_C(2166136261);
+   int i;
+
+   for (i = 0; i < 0x1000 / 4; i++)
+      h = (h ^ source[i]) * UINT32_C(16777619);
+
+   return h;
+}
+
+static uint32_t slot_of(uint32_t vaddr, uint32_t hash)
+{
+   return ((vaddr >> 12) * UINT32_C(0x9E3779B1) ^ hash) & slot_mask;
+}
+
+static struct tcache_page *find_page(uint32_t vaddr, uint32_t hash)
+{
+   uint32_t s;
+
+   if (!slots)
+      return NULL;
+
+   for (s = slot_of(vaddr, hash); slots[s]; s = (s + 1) & slot_mask)
+   {
+      struct tcache_page *page = &pages[slots[s] - 1];
+      if (page->vaddr == vaddr && page->hash == hash)
+         return page;
+   }
+
+   return NULL;
+}
+
+static int grow_slots(void)
+{
+   uint32_t size = slots ? (slot_mask + 1) * 2 : 1024;
+   uint32_t *new_slots = (uint32_t *) calloc(size, sizeof(*new_slots));
+   uint32_t i;
+
+   if (!new_slots)
+      return 0;
+
+   free(slots);
+   slots = new_slots;
+   slot_mask = size - 1;
+
+   for (i = 0; i < page_count; i++)
+   {
+      uint32_t s = slot_of(pages[i].vaddr, pages[i].hash);
+      while (slots[s])
+         s = (s + 1) & slot_mask;
+      slots[s] = i + 1;
+   }
+
+   return 1;
+}
+
+static struct tcache_page *add_page(uint32_t vaddr, uint32_t hash)
+{
+   struct tcache_page *page;
+   uint32_t s;
+
+   if (page_count >= TCACHE_MAX_PAGES)
+      return NULL;
+
+   if (page_count == page_capacity)
+   {
+      uint32_t capacity = page_capacity ? page_capacity * 2 : 256;
+      struct tcache_page *new_pages = (struct tcache_page *)
+         realloc(pages, capacity * sizeof(*new_pages));
+      if (!new_pages)
+         return NULL;
+      pages = new_pages;
+      page_capacity = capacity;
+   }
+
+   /* keep the table at most half full */
+   if ((!slots || (page_count + 1) * 2 > slot_mask + 1) && !grow_slots())
+      return NULL;
+
+   page = &pages[page_count];
+   memset(page, 0, sizeof(*page));
+   page->vaddr = vaddr;
+   page->hash = hash;
+
+   s = slot_of(vaddr, hash);
+   while (slots[s])
+      s = (s + 1) & slot_mask;
+   slots[s] = ++page_count;
+
+   if (vaddr >= UINT32_C(0x80000000) && vaddr < UINT32_C(0x80000000) + RDRAM_MAX_SIZE)
+   {
+      uint32_t p = (vaddr - UINT32_C(0x80000000)) >> 12;
+      rdram_pages_known[p >> 5] |= UINT32_C(1) << (p & 31);
+   }
+
+   return page;
+}
+
+static void free_pages(void)
+{
+   free(pages);
+   free(slots);
+   pages = NULL;
+   slots = NULL;
+   page_count = 0;
+   page_capacity = 0;
+   slot_mask = 0;
+   memset(rdram_pages_known, 0, sizeof(rdram_pages_known));
+}
+
+static void load_pages(FILE *f)
+{
+   struct tcache_header header;
+   uint32_t i;
+
+   if (fread(&header, sizeof(header), 1, f) != 1
+         || memcmp(header.magic, TCACHE_MAGIC, sizeof(header.magic)) != 0
+         || header.version != TCACHE_VERSION
+         || header.count > TCACHE_MAX_PAGES)
+   {
+      DebugMessage(M64MSG_WARNING, "Ignoring invalid translation cache %s", cache_path);
+      return;
+   }
+
+   for (i = 0; i < header.count; i++)
+   {
+      struct tcache_page stored, *page;
+
+      if (fread(&stored, sizeof(stored), 1, f) != 1)
+      {
+         DebugMessage(M64MSG_WARNING, "Translation cache %s is truncated", cache_path);
+         break;
+      }
+
+      if (find_page(stored.vaddr, stored.hash))
+         continue;
+      if (!(page = add_page(stored.vaddr, stored.hash)))
+         break;
+      memcpy(page->entries, stored.entries, sizeof(page->entries));
+   }
+}
+
+void translation_cache_open(const char *md5)
+{
+   const char *dir = ConfigGetUserCachePath();
+   char *filename;
+   FILE *f;
+
+   translation_cache_close();
+
+   if (dir == NULL || md5 == NULL || md5[0] == '\0')
+      return;
+
+   filename = formatstr("%s.tcache", md5);
+   if (filename == NULL)
+      return;
+   cache_path = combinepath(dir, filename);
+   free(filename);
+   if (cache_path == NULL)
+      return;
+
+   f = fopen(cache_path, "rb");
+   if (f != NULL)
+   {
+      load_pages(f);
+      fclose(f);
+      DebugMessage(M64MSG_VERBOSE, "Loaded %u pages from translation cache %s",
+            page_count, cache_path);
+   }
+
+   /* an empty index still records this run */
+   if (!slots && !grow_slots())
+   {
+      free(cache_path);
+      cache_path = NULL;
+   }
+   cache_dirty = 0;
+}
+
+void translation_cache_close(void)
+{
+   if (cache_path != NULL && cache_dirty)
+   {
+      FILE *f = fopen(cache_path, "wb");
+
+      if (f != NULL)
+      {
+         struct tcache_header header;
+
+         memcpy(header.magic, TCACHE_MAGIC, sizeof(header.magic));
+         header.version = TCACHE_VERSION;
+         header.count = page_count;
+
+         if (fwrite(&header, sizeof(header), 1, f) != 1
+               || fwrite(pages, sizeof(*pages), page_count, f) != page_count)
+            DebugMessage(M64MSG_WARNING, "Couldn't write translation cache %s", cache_path);
+         fclose(f);
+      }
+      else
+         DebugMessage(M64MSG_WARNING, "Couldn't open translation cache %s for writing", cache_path);
+   }
+
+   free(cache_path);
+   cache_path = NULL;
+   cache_dirty = 0;
+   free_pages();
+}
+
+static void compile_entries(precomp_block *block, const uint32_t *source,
+      const struct tcache_page *page)
+{
+   unsigned int i;
+
+   for (i = 0; i < 0x1000 / 4; i++)
+   {
+      void (*ops)(void);
+
+      if (!(page->entries[i >> 5] & (UINT32_C(1) << (i & 31))))
+         continue;
+
+      ops = block->block[i].ops;
+      if (ops == current_instruction_table.NOTCOMPILED
+            || ops == current_instruction_table.NOTCOMPILED2)
+         recompile_block(source, block, block->start + i * 4);
+   }
+}
+
+void translation_cache_enter(precomp_block *block, const uint32_t *source, uint32_t addr)
+{
+   struct tcache_page *page;
+   uint32_t hash, i;
+
+   if (!slots || block->end - block->start != 0x1000)
+      return;
+
+   if (!block->tcache_hash_valid)
+   {
+      block->tcache_hash = page_hash(source);
+      block->tcache_hash_valid = 1;
+   }
+   hash = block->tcache_hash;
+   page = find_page(block->start, hash);
+
+   if (page != NULL && !block_has_code(block, 0, 0x1000 / 4 - 1))
+      compile_entries(block, source, page);
+
+   if (page == NULL && !(page = add_page(block->start, hash)))
+      return;
+
+   i = (addr - block->start) / 4;
+   if (!(page->entries[i >> 5] & (UINT32_C(1) << (i & 31))))
+   {
+      page->entries[i >> 5] |= UINT32_C(1) << (i & 31);
+      cache_dirty = 1;
+   }
+}
+
+void translation_cache_request_warm(void)
+{
+   warm_requested = 1;
+}
+
+void translation_cache_warm_rdram(void)
+{
+   size_t dram_pages = g_dev.ri.rdram.dram_size / 0x1000;
+   size_t p;
+
+   if (!warm_requested)
+      return;
+   warm_requested = 0;
+
+   if (!page_count)
+      return;
+
+   for (p = 0; p < dram_pages; p++)
+   {
+      uint32_t vaddr = UINT32_C(0x80000000) + (uint32_t)(p * 0x1000);
+      const uint32_t *source = g_dev.rdram + p * (0x1000 / 4);
+      const struct tcache_page *page;
+      precomp_block *block;
+      uint32_t hash;
+
+      if (!(rdram_pages_known[p >> 5] & (UINT32_C(1) << (p & 31))))
+         continue;
+      hash = page_hash(source);
+      if ((page = find_page(vaddr, hash)) == NULL)
+         continue;
+
+      block = blocks[vaddr >> 12];
+      if (!block || invalid_code[vaddr >> 12])
+      {
+         if (!block && !(block = new_block(vaddr)))
+            break;
+         block->start = vaddr;
+         block->end = vaddr + 0x1000;
+         init_block(block);
+      }
+
+      if (!block->block)
+         continue;
+      block->tcache_hash = hash;
+      block->tcache_hash_valid = 1;
+      compile_entries(block, source, page);
+   }
+}
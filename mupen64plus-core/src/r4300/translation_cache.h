@@ -0,0 +1,55 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - translation_cache.h                                     *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2016 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_R4300_TRANSLATION_CACHE_H
+#define M64P_R4300_TRANSLATION_CACHE_H
+
+#include <stdint.h>
+
+#include "recomp.h"
+
+/* Remembers, per ROM and per page contents, which addresses have been
+ * entered as compiled code, so that a later run (or a savestate load)
+ * can translate all of them in one go instead of trapping into
+ * NOTCOMPILED for each block the first time it is reached. */
+
+extern int translation_cache_enabled;
+
+/* Loads the index stored for the ROM with the given MD5, if any. */
+void translation_cache_open(const char *md5);
+/* Writes the index back if it changed and releases it. */
+void translation_cache_close(void);
+
+/* Called when execution enters uncompiled code at addr. On the first
+ * entry into a page, every address known for its current contents is
+ * compiled; addr is then recorded for the next run. */
+void translation_cache_enter(precomp_block *block, const uint32_t *source, uint32_t addr);
+
+/* Asks the next translation_cache_warm_rdram() to do its work. Only user
+ * initiated state loads request it; run-ahead and rewind loads don't. */
+void translation_cache_request_warm(void);
+
+/* If requested, compiles the known entry points of every direct-mapped
+ * RDRAM page whose contents match the index, e.g. right after loading a
+ * state. */
+void translation_cache_warm_rdram(void);
+
+#endif /* M64P_R4300_TRANSLATION_CACHE_H */
@@ -22,60 +22,81 @@
 #include "fb.h"
 #include "rdp_core.h"
 
+#include "../main/savestates.h"
 #include "../memory/memory.h"
 #include "../plugin/plugin.h"
 #include "../r4300/r4300_core.h"
 #include "../ri/ri_controller.h"
 
-extern int fast_memory;
+extern uint32_t fast_memory_fb_start;
+extern uint32_t fast_memory_fb_end;
 
 #include <string.h>
 
 void init_fb(struct fb* fb)
 {
     memset(fb, 0, sizeof(*fb));
-    fb->once = 1;
 }
 
 
+static int page_is_dirty(const struct fb* fb, uint32_t page)
+{
+    return (fb->dirty_pages[page >> 5] >> (page & 31)) & 1;
+}
+
+/* Sets or clears the dirty bits of pages first..last, a word at a time
+ * where the range allows it. */
+static void set_dirty_pages(struct fb* fb, uint32_t first, uint32_t last, int dirty)
+{
+    uint32_t page = first;
+
+    while (page <= last)
+    {
+        uint32_t bits = 32 - (page & 31);
+        uint32_t mask;
+
+        if (bits > last - page + 1)
+            bits = last - page + 1;
+        mask = (bits == 32) ? ~UINT32_C(0) : ((UINT32_C(1) << bits) - 1) << (page & 31);
+
+        if (dirty)
+            fb->dirty_pages[page >> 5] |= mask;
+        else
+            fb->dirty_pages[page >> 5] &= ~mask;
+
+        page += bits;
+    }
+}
+
 static void pre_framebuffer_read(struct fb* fb, uint32_t address)
 {
+    uint32_t offset = address & 0x7FFFFF;
+    uint32_t page   = offset >> 12;
+    unsigned int infos = fb->page_infos[page];
     size_t i;
 
-    for(i = 0; i < FB_INFOS_COUNT; ++i)
+    for (i = 0; infos != 0; ++i, infos >>= 1)
     {
-        if (fb->infos[i].addr)
+        if ((infos & 1) && offset >= fb->info_start[i] && offset <= fb->info_end[i]
+                && page_is_dirty(fb, page))
         {
-            unsigned int start = fb->infos[i].addr & 0x7FFFFF;
-            unsigned int end   = start + fb->infos[i].width*
-                               fb->infos[i].height*
-                               fb->infos[i].size - 1;
-
-            if ((address & 0x7FFFFF) >= start && (address & 0x7FFFFF) <= end &&
-                    fb->dirty_page[(address & 0x7FFFFF)>>12])
-            {
-                gfx.fBRead(address);
-                fb->dirty_page[(address & 0x7FFFFF)>>12] = 0;
-            }
+            gfx.fBRead(address);
+            savestates_dirty_unknown = 1;
+            set_dirty_pages(fb, page, page, 0);
         }
     }
 }
 
 static void pre_framebuffer_write(struct fb* fb, uint32_t address)
 {
+    uint32_t offset = address & 0x7FFFFF;
+    unsigned int infos = fb->page_infos[offset >> 12];
     size_t i;
 
-    for(i = 0; i < FB_INFOS_COUNT; ++i)
+    for (i = 0; infos != 0; ++i, infos >>= 1)
     {
-        if (fb->infos[i].addr)
-        {
-            unsigned int start = fb->infos[i].addr & 0x7FFFFF;
-            unsigned int end   = start + fb->infos[i].width*
-                               fb->infos[i].height*
-                               fb->infos[i].size - 1;
-            if ((address & 0x7FFFFF) >= start && (address & 0x7FFFFF) <= end)
-                gfx.fBWrite(address, 4);
-        }
+        if ((infos & 1) && offset >= fb->info_start[i] && offset <= fb->info_end[i])
+            gfx.fBWrite(address, 4);
     }
 }
 
@@ -110,6 +131,8 @@ void protect_framebuffers(struct rdp_core* dp)
     if (!gfx.fBRead && gfx.fBWrite)
        return;
 
+    memset(fb->page_infos, 0, sizeof(fb->page_infos));
+
     if (fb->infos[0].addr)
     {
        size_t i;
@@ -124,6 +147,13 @@ void protect_framebuffers(struct rdp_core* dp)
                 fb->infos[i].size - 1;
              int start1 = start;
              int end1   = end;
+             uint32_t fb_start, fb_end;
+
+             fb->info_start[i] = start1;
+             fb->info_end[i]   = end1;
+
+             for (j = start1 >> 12; j <= (end1 >> 12) && j < FB_DIRTY_PAGES_COUNT; j++)
+                fb->page_infos[j] |= 1 << i;
 
              start >>= 16;
              end   >>= 16;
@@ -134,23 +164,39 @@ void protect_framebuffers(struct rdp_core* dp)
                 map_region(0xa000+j, M64P_MEM_RDRAM, RW(rdramFB));
              }
 
-             start <<= 4;
-             end   <<= 4;
-
-             for (j=start; j<=end; j++)
+             /* Recompiled code only looks up the region handlers of
+              * accesses within the range that has held framebuffers, so
+              * code emitted for a narrower range must be thrown away. */
+             fb_start = (uint32_t)start << 16;
+             fb_end   = (uint32_t)(end + 1) << 16;
+             if (fast_memory_fb_end > fast_memory_fb_start)
              {
-                if (j >= start1 && j <= end1)
-                   fb->dirty_page[j] = 1;
-                else
-                   fb->dirty_page[j] = 0;
+                if (fb_start > fast_memory_fb_start)
+                   fb_start = fast_memory_fb_start;
+                if (fb_end < fast_memory_fb_end)
+                   fb_end = fast_memory_fb_end;
              }
-
-             if (fb->once != 0)
+             if (fb_start != fast_memory_fb_start || fb_end != fast_memory_fb_end)
              {
-                fb->once = 0;
-                fast_memory = 0;
+                fast_memory_fb_start = fb_start;
+                fast_memory_fb_end   = fb_end;
                 invalidate_r4300_cached_code(0, 0);
              }
+
+             start <<= 4;
+             end   <<= 4;
+             if (end >= FB_DIRTY_PAGES_COUNT)
+                end = FB_DIRTY_PAGES_COUNT - 1;
+
+             /* As before, pages start..end are marked dirty when their
+              * index lies within [start1, end1] and clean otherwise. */
+             if (start <= end)
+             {
+                set_dirty_pages(fb, start, end, 0);
+                if (start1 <= end && end1 >= start)
+                   set_dirty_pages(fb, start1 > start ? start1 : start,
+                         end1 < end ? end1 : end, 1);
+             }
           }
        }
     }
@@ -33,9 +33,13 @@ enum { FB_DIRTY_PAGES_COUNT = 0x800 };
 
 struct fb
 {
-    unsigned char dirty_page[FB_DIRTY_PAGES_COUNT];
+    uint32_t dirty_pages[FB_DIRTY_PAGES_COUNT / 32];
+    /* one bit per infos[] entry overlapping each 4KB page of RDRAM,
+     * rebuilt along with info_start/info_end by protect_framebuffers */
+    uint8_t page_infos[FB_DIRTY_PAGES_COUNT];
+    uint32_t info_start[FB_INFOS_COUNT];
+    uint32_t info_end[FB_INFOS_COUNT];
     FrameBufferInfo infos[FB_INFOS_COUNT];
-    unsigned int once;
 };
 
 void init_fb(struct fb* fb);
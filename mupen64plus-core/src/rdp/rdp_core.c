@@ -21,6 +21,7 @@
 
 #include "rdp_core.h"
 
+#include "../main/savestates.h"
 #include "../memory/memory.h"
 #include "../plugin/plugin.h"
 #include "../r4300/r4300_core.h"
@@ -117,6 +118,7 @@ int write_dpc_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
          break;
       case DPC_END_REG:
          gfx.processRDPList();
+         savestates_dirty_unknown = 1;
          signal_rcp_interrupt(dp->r4300, MI_INTR_DP);
          break;
    }
@@ -22,6 +22,7 @@
 #include "rdram.h"
 #include "ri_controller.h"
 
+#include "../main/savestates.h"
 #include "../memory/memory.h"
 
 #include <string.h>
@@ -38,6 +39,7 @@ void init_rdram(struct rdram* rdram)
 {
     memset(rdram->regs, 0, RDRAM_REGS_COUNT*sizeof(uint32_t));
     memset(rdram->dram, 0, rdram->dram_size);
+    savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, 0, (uint32_t)rdram->dram_size);
 }
 
 
@@ -78,6 +80,7 @@ int write_rdram_dram(void* opaque, uint32_t address, uint32_t value, uint32_t ma
     uint32_t addr            = RDRAM_DRAM_ADDR(address);
 
     ri->rdram.dram[addr] = MASKED_WRITE(&ri->rdram.dram[addr], value, mask);
+    savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, addr * 4, 4);
 
     return 0;
 }
@@ -22,7 +22,9 @@
 #include "rdram_detection_hack.h"
 #include "ri_controller.h"
 
+#include "main/device.h"
 #include "main/main.h"
+#include "main/savestates.h"
 #include "si/si_controller.h"
 
 #include <stdint.h>
@@ -34,9 +36,10 @@
  */
 void force_detected_rdram_size_hack(void)
 {
-    uint32_t address = (g_si.pif.cic.version != CIC_X105)
+    uint32_t address = (g_dev.si.pif.cic.version != CIC_X105)
         ? 0x318
         : 0x3f0;
 
-    g_ri.rdram.dram[address/4] = g_ri.rdram.dram_size;
+    g_dev.ri.rdram.dram[address/4] = g_dev.ri.rdram.dram_size;
+    savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, address, 4);
 }
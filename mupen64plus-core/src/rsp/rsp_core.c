@@ -23,39 +23,44 @@
 
 #include "main/main.h"
 #include "main/profile.h"
+#include "main/savestates.h"
 #include "memory/memory.h"
 #include "plugin/plugin.h"
 #include "r4300/r4300_core.h"
 #include "../rdp/rdp_core.h"
 #include "../ri/ri_controller.h"
 
+#include "libretro_perf.h"
+
 #include <stdio.h>
 #include <string.h>
 
 static void dma_sp_write(struct rsp_core* sp, unsigned length, unsigned count, unsigned skip)
 {
-    unsigned int i,j;
+    unsigned int j;
     unsigned int memaddr  = sp->regs[SP_MEM_ADDR_REG] & 0xfff;
     unsigned int dramaddr = sp->regs[SP_DRAM_ADDR_REG] & 0xffffff;
 
     unsigned char *spmem  = (unsigned char*)sp->mem + (sp->regs[SP_MEM_ADDR_REG] & 0x1000);
     unsigned char *dram   = (unsigned char*)sp->ri->rdram.dram;
+    uint32_t first        = (sp->regs[SP_MEM_ADDR_REG] & 0x1000) + memaddr;
+    uint32_t written      = length * count;
+
+    if (written > SP_MEM_SIZE - first)
+        written = SP_MEM_SIZE - first;
+    savestates_mark_dirty(SAVESTATE_DIRTY_SP_MEM, first, written);
 
     for(j = 0; j < count; j++)
     {
-        for(i = 0; i < length; i++)
-        {
-            spmem[memaddr^S8] = dram[dramaddr^S8];
-            memaddr++;
-            dramaddr++;
-        }
-        dramaddr+=skip;
+        dma_copy(spmem, memaddr, dram, dramaddr, length);
+        memaddr  += length;
+        dramaddr += length + skip;
     }
 }
 
 static void dma_sp_read(struct rsp_core* sp, unsigned length, unsigned count, unsigned skip)
 {
-    unsigned int i,j;
+    unsigned int j;
     unsigned int memaddr  = sp->regs[SP_MEM_ADDR_REG] & 0xfff;
     unsigned int dramaddr = sp->regs[SP_DRAM_ADDR_REG] & 0xffffff;
 
@@ -64,13 +69,9 @@ static void dma_sp_read(struct rsp_core* sp, unsigned length, unsigned count, un
 
     for(j = 0; j < count; j++)
     {
-        for(i = 0; i < length; i++)
-        {
-            dram[dramaddr^S8] = spmem[memaddr^S8];
-            memaddr++;
-            dramaddr++;
-        }
-        dramaddr+=skip;
+        dma_copy(dram, dramaddr, spmem, memaddr, length);
+        memaddr  += length;
+        dramaddr += length + skip;
     }
 }
 
@@ -152,6 +153,7 @@ void connect_rsp(struct rsp_core* sp,
 void init_rsp(struct rsp_core* sp)
 {
     memset(sp->mem, 0, SP_MEM_SIZE);
+    savestates_mark_dirty(SAVESTATE_DIRTY_SP_MEM, 0, SP_MEM_SIZE);
     memset(sp->regs, 0, SP_REGS_COUNT*sizeof(uint32_t));
     memset(sp->regs2, 0, SP_REGS2_COUNT*sizeof(uint32_t));
 
@@ -175,6 +177,7 @@ int write_rsp_mem(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
     uint32_t addr       = RSP_MEM_ADDR(address);
 
     sp->mem[addr] = MASKED_WRITE(&sp->mem[addr], value, mask);
+    savestates_mark_dirty(SAVESTATE_DIRTY_SP_MEM, addr * 4, 4);
 
     return 0;
 }
@@ -260,6 +263,10 @@ void do_SP_Task(struct rsp_core* sp)
 {
     uint32_t save_pc = sp->regs2[SP_PC_REG] & ~0xfff;
 
+    /* the RSP plugin writes SP memory and RDRAM directly */
+    savestates_mark_dirty(SAVESTATE_DIRTY_SP_MEM, 0, SP_MEM_SIZE);
+    savestates_dirty_unknown = 1;
+
     if (sp->mem[0xfc0/4] == 1)
     {
        /* Display list */
@@ -274,7 +281,9 @@ void do_SP_Task(struct rsp_core* sp)
 
         sp->regs2[SP_PC_REG] &= 0xfff;
         timed_section_start(TIMED_SECTION_GFX);
+        perf_counter_start(PERF_RSP_GFX_TASK);
         rsp.doRspCycles(0xffffffff);
+        perf_counter_stop(PERF_RSP_GFX_TASK);
         timed_section_end(TIMED_SECTION_GFX);
         sp->regs2[SP_PC_REG] |= save_pc;
         new_frame();
@@ -294,7 +303,9 @@ void do_SP_Task(struct rsp_core* sp)
        /* Audio List */
         sp->regs2[SP_PC_REG] &= 0xfff;
         timed_section_start(TIMED_SECTION_AUDIO);
+        perf_counter_start(PERF_RSP_AUDIO_TASK);
         rsp.doRspCycles(0xffffffff);
+        perf_counter_stop(PERF_RSP_AUDIO_TASK);
         timed_section_end(TIMED_SECTION_AUDIO);
         sp->regs2[SP_PC_REG] |= save_pc;
 
@@ -25,6 +25,7 @@
 
 #include "../api/m64p_types.h"
 #include "../api/callbacks.h"
+#include "../main/savestates.h"
 #include "../memory/memory.h"
 #include "../plugin/plugin.h"
 #include "r4300/r4300_core.h"
@@ -92,6 +93,7 @@ int write_pif_ram(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
    }
 
    si->pif.ram[addr] = MASKED_WRITE((uint32_t*)(&si->pif.ram[addr]), sl(value), sl(mask));
+   savestates_mark_dirty(SAVESTATE_DIRTY_PIF_RAM, 0, PIF_RAM_SIZE);
 
    if ((addr == 0x3c) && (mask & 0xff))
    {
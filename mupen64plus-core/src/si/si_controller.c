@@ -24,6 +24,7 @@
 #include "../api/m64p_types.h"
 #include "../api/callbacks.h"
 #include "../main/main.h"
+#include "../main/savestates.h"
 #include "../memory/memory.h"
 #include "../r4300/r4300_core.h"
 #include "../ri/ri_controller.h"
@@ -42,6 +43,7 @@ static void dma_si_write(struct si_controller* si)
 
    for (i = 0; i < PIF_RAM_SIZE; i += 4)
       *((uint32_t*)(&si->pif.ram[i])) = sl(si->ri->rdram.dram[(si->regs[SI_DRAM_ADDR_REG]+i)/4]);
+   savestates_mark_dirty(SAVESTATE_DIRTY_PIF_RAM, 0, PIF_RAM_SIZE);
 
    update_pif_write(si);
    cp0_update_count();
@@ -66,9 +68,11 @@ static void dma_si_read(struct si_controller* si)
    }
 
    update_pif_read(si);
+   savestates_mark_dirty(SAVESTATE_DIRTY_PIF_RAM, 0, PIF_RAM_SIZE);
 
    for (i = 0; i < PIF_RAM_SIZE; i += 4)
       si->ri->rdram.dram[(si->regs[SI_DRAM_ADDR_REG]+i)/4] = sl(*(uint32_t*)(&si->pif.ram[i]));
+   savestates_mark_dirty(SAVESTATE_DIRTY_RDRAM, si->regs[SI_DRAM_ADDR_REG], PIF_RAM_SIZE);
    cp0_update_count();
 
    if (g_delay_si)
@@ -141,6 +145,7 @@ void si_end_of_dma_event(struct si_controller* si)
    main_check_inputs();
 
    si->pif.ram[0x3f] = 0x0;
+   savestates_mark_dirty(SAVESTATE_DIRTY_PIF_RAM, 0, PIF_RAM_SIZE);
 
    /* trigger SI interrupt */
    si->regs[SI_STATUS_REG] |= 0x1000;
@@ -22,11 +22,14 @@
 #include "vi_controller.h"
 
 #include "main/main.h"
+#include "main/savestates.h"
 #include "memory/memory.h"
 #include "plugin/plugin.h"
 #include "r4300/r4300_core.h"
 #include "r4300/interupt.h"
 
+#include "libretro_perf.h"
+
 #include <string.h>
 
 extern unsigned alternate_vi_timing;
@@ -105,7 +108,10 @@ int write_vi_regs(void* opaque, uint32_t address,
 
 void vi_vertical_interrupt_event(struct vi_controller* vi)
 {
+   perf_counter_start(PERF_VI_UPDATE_SCREEN);
    gfx.updateScreen();
+   perf_counter_stop(PERF_VI_UPDATE_SCREEN);
+   savestates_dirty_unknown = 1;
 
    /* allow main module to do things on VI event */
    new_vi();
@@ -0,0 +1,163 @@
+/* gmemtest
+ * Checks the RDRAM test the x86_64 hacktarux dynarec emits in front of
+ * its loads and stores (gen_rdram_test).
+ *
+ * The test is assembled the way genlw uses it, followed by the jne to
+ * the handler call, and run on addresses in and out of RDRAM, with and
+ * without a protected framebuffer. An address may only take the direct
+ * RDRAM path if it is direct-mapped RDRAM whose 64KB region is handled
+ * by the plain RDRAM handler.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+#include <sys/mman.h>
+
+#include "r4300/hacktarux_dynarec/gmem.h"
+
+int fast_memory;
+uint32_t fast_memory_fb_start;
+uint32_t fast_memory_fb_end;
+
+int code_length;
+int max_code_length;
+unsigned char **inst_pointer;
+
+static unsigned char *code;
+
+void *realloc_exec(void *ptr, size_t oldsize, size_t newsize)
+{
+	(void)oldsize;
+	return realloc(ptr, newsize);
+}
+
+void DebugMessage(int level, const char *message, ...)
+{
+	(void)level;
+	fprintf(stderr, "%s\n", message);
+}
+
+static void read_rdram(void) { }
+static void read_rdramFB(void) { }
+static void read_nothing(void) { }
+
+static void (*readmem[0x10000])(void);
+
+static int failures;
+
+/* Returns 1 if the emitted code takes the direct RDRAM path for addr. */
+static int takes_fast_path(uint32_t addr)
+{
+	unsigned char *buf = (unsigned char *)malloc(4096);
+	int (*fn)(uint32_t);
+	int fast;
+
+	inst_pointer = &buf;
+	code_length = 0;
+	max_code_length = 4096;
+
+	put8(0x53);                          /* push rbx */
+	mov_reg32_reg32(EAX, EDI);
+	mov_reg32_reg32(EBX, EDI);
+	mov_reg64_imm64(RSI, (uint64_t)readmem);
+	gen_rdram_test(EAX, EBX, RSI, RDI, read_rdram);
+	jne_rj(7);                           /* to the handler call, as in genlw */
+	mov_reg32_imm32(EAX, 1);             /* 5 */
+	put8(0x5B);                          /* pop rbx, 1 */
+	put8(0xC3);                          /* ret, 1 */
+	mov_reg32_imm32(EAX, 0);
+	put8(0x5B);
+	put8(0xC3);
+
+	memcpy(code, buf, code_length);
+	free(buf);
+
+	fn = (int (*)(uint32_t))(uintptr_t)code;
+	fast = fn(addr);
+	return fast;
+}
+
+static void check(const char *config, uint32_t addr, int expected)
+{
+	int fast = takes_fast_path(addr);
+
+	if (fast != expected)
+	{
+		printf("FAIL %s: %08x takes the %s path\n", config, addr,
+				fast ? "RDRAM" : "handler");
+		failures++;
+	}
+}
+
+static void map(uint32_t region, void (*handler)(void))
+{
+	readmem[0x8000 + region] = handler;
+	readmem[0xa000 + region] = handler;
+}
+
+static void check_all(const char *config, int fb_protected)
+{
+	check(config, 0x80001000, 1);
+	check(config, 0xa0100004, 1);
+	check(config, 0x807ffffc, 1);
+	check(config, 0x803d0010, 1);
+	check(config, 0x803e0010, !fb_protected);
+	check(config, 0xa03e8000, !fb_protected);
+	check(config, 0x80800000, 0);
+	check(config, 0xa4400010, 0);     /* VI */
+	check(config, 0xa4600010, 0);     /* PI */
+	check(config, 0xb0000000, 0);     /* cartridge ROM */
+	check(config, 0x00001000, 0);     /* TLB mapped */
+	check(config, 0x7f000000, 0);
+}
+
+int main(void)
+{
+	uint32_t i;
+
+	code = (unsigned char *)mmap(NULL, 4096, PROT_READ | PROT_WRITE | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+
+	for (i = 0; i < 0x10000; i++)
+		readmem[i] = read_nothing;
+	for (i = 0; i < 0x80; i++)
+		map(i, read_rdram);
+
+	fast_memory = 1;
+	check_all("no framebuffer", 0);
+
+	map(0x3e, read_rdramFB);
+	fast_memory_fb_start = 0x3d0000;
+	fast_memory_fb_end   = 0x400000;
+	check_all("protected framebuffer", 1);
+
+	fast_memory = 0;
+	check_all("fast_memory off", 1);
+
+	munmap(code, 4096);
+
+	if (failures)
+		return 1;
+	printf("gmemtest: all checks passed\n");
+	return 0;
+}
+
+#else
+
+int main(void)
+{
+	printf("gmemtest: only supported on x86_64\n");
+	return 0;
+}
+
+#endif
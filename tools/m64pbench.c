@@ -0,0 +1,611 @@
+/* m64pbench
+ * Headless benchmark for the libretro core.
+ *
+ * Loads the core, a ROM and optionally a savestate, then runs a fixed
+ * number of frames with video, audio and input stubbed out. Reports
+ * frames per second, frame time percentiles and the time spent in each
+ * of the core's perf counters over the whole timed run.
+ *
+ * Only plugins that don't need a hardware context (angrylion) can run,
+ * since no OpenGL or Vulkan context is offered to the core.
+ *
+ * Given several cpu cores (-c a,b,...), each one runs in its own process
+ * and a comparison of their speed is printed at the end.
+ */
+
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../mupen64plus-core/src/api/libretro.h"
+
+#define MAX_OPTIONS 128
+#define MAX_PERF_COUNTERS 64
+#define MAX_CORES 8
+
+static struct
+{
+	char key[128];
+	char value[128];
+	int overridden;
+} options[MAX_OPTIONS];
+static int num_options;
+
+static const char *system_dir = ".";
+static int verbose;
+static struct retro_perf_counter *perf_counters[MAX_PERF_COUNTERS];
+static int num_perf_counters;
+static unsigned frames_presented;
+
+static struct
+{
+	void (*init)(void);
+	void (*deinit)(void);
+	void (*set_environment)(retro_environment_t);
+	void (*set_video_refresh)(retro_video_refresh_t);
+	void (*set_audio_sample)(retro_audio_sample_t);
+	void (*set_audio_sample_batch)(retro_audio_sample_batch_t);
+	void (*set_input_poll)(retro_input_poll_t);
+	void (*set_input_state)(retro_input_state_t);
+	void (*get_system_info)(struct retro_system_info *);
+	bool (*load_game)(const struct retro_game_info *);
+	void (*unload_game)(void);
+	void (*run)(void);
+	size_t (*serialize_size)(void);
+	bool (*unserialize)(const void *, size_t);
+} core;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Option keys are "<prefix>-<name>", the prefix depending on how the
+ * core was built (mupen64, parallel, ...). */
+static const char *option_name(const char *key)
+{
+	const char *dash = strchr(key, '-');
+	return dash ? dash + 1 : key;
+}
+
+static int find_option(const char *key)
+{
+	int i;
+	for (i = 0; i < num_options; ++i)
+		if (!strcmp(options[i].key, key))
+			return i;
+	return -1;
+}
+
+/* An overridden value given without the prefix wins over the default */
+static const char *option_value(const char *key)
+{
+	int i = find_option(option_name(key));
+
+	if (i < 0 || !options[i].overridden)
+		i = find_option(key);
+	if (i < 0)
+		for (i = num_options - 1; i >= 0; --i)
+			if (!strcmp(option_name(options[i].key), option_name(key)))
+				break;
+	return i < 0 ? NULL : options[i].value;
+}
+
+static int set_option(const char *key, const char *value, int overridden)
+{
+	int i = find_option(key);
+
+	if (i < 0) {
+		if (num_options == MAX_OPTIONS)
+			return 0;
+		i = num_options++;
+		snprintf(options[i].key, sizeof(options[i].key), "%s", key);
+	} else if (options[i].overridden && !overridden) {
+		return 1;
+	}
+
+	snprintf(options[i].value, sizeof(options[i].value), "%s", value);
+	options[i].overridden = overridden;
+	return 1;
+}
+
+/* The default of "Description; first|second|..." is its first value */
+static void set_default_options(const struct retro_variable *vars)
+{
+	for (; vars->key; ++vars) {
+		char value[128];
+		const char *start = strchr(vars->value, ';');
+		size_t len;
+
+		if (!start)
+			continue;
+		start++;
+		while (*start == ' ')
+			start++;
+		len = strcspn(start, "|");
+		if (len >= sizeof(value))
+			len = sizeof(value) - 1;
+		memcpy(value, start, len);
+		value[len] = '\0';
+		set_option(vars->key, value, 0);
+	}
+}
+
+static void log_printf(enum retro_log_level level, const char *fmt, ...)
+{
+	va_list args;
+
+	if (!verbose && level < RETRO_LOG_WARN)
+		return;
+
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+static retro_perf_tick_t perf_get_counter(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (retro_perf_tick_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static retro_time_t perf_get_time_usec(void)
+{
+	return (retro_time_t)(perf_get_counter() / 1000);
+}
+
+static uint64_t perf_get_cpu_features(void)
+{
+	uint64_t cpu = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("mmx"))
+		cpu |= RETRO_SIMD_MMX;
+	if (__builtin_cpu_supports("sse"))
+		cpu |= RETRO_SIMD_SSE;
+	if (__builtin_cpu_supports("sse2"))
+		cpu |= RETRO_SIMD_SSE2;
+	if (__builtin_cpu_supports("sse3"))
+		cpu |= RETRO_SIMD_SSE3;
+	if (__builtin_cpu_supports("ssse3"))
+		cpu |= RETRO_SIMD_SSSE3;
+	if (__builtin_cpu_supports("sse4.1"))
+		cpu |= RETRO_SIMD_SSE4;
+	if (__builtin_cpu_supports("sse4.2"))
+		cpu |= RETRO_SIMD_SSE42;
+	if (__builtin_cpu_supports("avx"))
+		cpu |= RETRO_SIMD_AVX;
+	if (__builtin_cpu_supports("avx2"))
+		cpu |= RETRO_SIMD_AVX2;
+#endif
+	return cpu;
+}
+
+static void perf_register(struct retro_perf_counter *counter)
+{
+	if (counter->registered || num_perf_counters == MAX_PERF_COUNTERS)
+		return;
+	perf_counters[num_perf_counters++] = counter;
+	counter->registered = true;
+}
+
+static void perf_start(struct retro_perf_counter *counter)
+{
+	counter->start = perf_get_counter();
+}
+
+static void perf_stop(struct retro_perf_counter *counter)
+{
+	counter->total += perf_get_counter() - counter->start;
+	counter->call_cnt++;
+}
+
+static void perf_log(void)
+{
+}
+
+static void perf_reset(void)
+{
+	int i;
+	for (i = 0; i < num_perf_counters; ++i) {
+		perf_counters[i]->total = 0;
+		perf_counters[i]->call_cnt = 0;
+	}
+}
+
+static bool environment(unsigned cmd, void *data)
+{
+	switch (cmd) {
+	case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+		((struct retro_log_callback *)data)->log = log_printf;
+		return true;
+	case RETRO_ENVIRONMENT_SET_VARIABLES:
+		set_default_options((const struct retro_variable *)data);
+		return true;
+	case RETRO_ENVIRONMENT_GET_VARIABLE: {
+		struct retro_variable *var = (struct retro_variable *)data;
+		var->value = option_value(var->key);
+		return var->value != NULL;
+	}
+	case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+		*(bool *)data = false;
+		return true;
+	case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+	case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+		*(const char **)data = system_dir;
+		return true;
+	case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+		return true;
+	case RETRO_ENVIRONMENT_GET_PERF_INTERFACE: {
+		struct retro_perf_callback *cb = (struct retro_perf_callback *)data;
+		cb->get_time_usec = perf_get_time_usec;
+		cb->get_cpu_features = perf_get_cpu_features;
+		cb->get_perf_counter = perf_get_counter;
+		cb->perf_register = perf_register;
+		cb->perf_start = perf_start;
+		cb->perf_stop = perf_stop;
+		cb->perf_log = perf_log;
+		return true;
+	}
+	default:
+		/* no hardware contexts, rumble, ... */
+		return false;
+	}
+}
+
+static void video_refresh(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+	frames_presented++;
+}
+
+static void audio_sample(int16_t left, int16_t right)
+{
+}
+
+static size_t audio_sample_batch(const int16_t *data, size_t frames)
+{
+	return frames;
+}
+
+static void input_poll(void)
+{
+}
+
+static int16_t input_state(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+	return 0;
+}
+
+static void *load_file(const char *path, size_t *size)
+{
+	FILE *fp = fopen(path, "rb");
+	void *data;
+	long len;
+
+	if (!fp) {
+		fprintf(stderr, "Unable to open '%s'\n", path);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	data = malloc(len > 0 ? len : 1);
+	if (!data || fread(data, 1, len, fp) != (size_t)len) {
+		fprintf(stderr, "Unable to read '%s'\n", path);
+		free(data);
+		fclose(fp);
+		return NULL;
+	}
+
+	fclose(fp);
+	*size = len;
+	return data;
+}
+
+static int load_core(const char *path)
+{
+	void *lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+	if (!lib) {
+		fprintf(stderr, "Unable to load core: %s\n", dlerror());
+		return 0;
+	}
+
+#define SYM(name) \
+	if (!(*(void **)&core.name = dlsym(lib, "retro_" #name))) { \
+		fprintf(stderr, "Core is missing retro_%s\n", #name); \
+		return 0; \
+	}
+	SYM(init) SYM(deinit) SYM(set_environment) SYM(set_video_refresh)
+	SYM(set_audio_sample) SYM(set_audio_sample_batch) SYM(set_input_poll)
+	SYM(set_input_state) SYM(get_system_info) SYM(load_game) SYM(unload_game)
+	SYM(run) SYM(serialize_size) SYM(unserialize)
+#undef SYM
+
+	return 1;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(const double *sorted, unsigned count, double p)
+{
+	unsigned i = (unsigned)(p * (count - 1) + 0.5);
+	return sorted[i];
+}
+
+static void usage(const char *argv0)
+{
+	printf("usage: %s [options] <core.so> <rom>\n"
+	       "  -f <frames>    frames to time (default 1000)\n"
+	       "  -w <frames>    untimed warm-up frames (default 60)\n"
+	       "  -s <state>     savestate to load after the warm-up\n"
+	       "  -c <core,...>  cpu core: pure_interpreter, cached_interpreter,\n"
+	       "                 cached_interpreter_threaded, dynamic_recompiler;\n"
+	       "                 several are run one after the other and compared\n"
+	       "  -g <plugin>    gfx plugin (default angrylion)\n"
+	       "  -r <plugin>    rsp plugin: hle, cxd4, parallel\n"
+	       "  -o key=value   any other core option, e.g. -o aspect=16:9\n"
+	       "  -d <dir>       system/save directory (default .)\n"
+	       "  -v             show the core's log\n", argv0);
+}
+
+struct bench_result
+{
+	double fps;
+	double p50;
+};
+
+/* Runs the benchmark with the options set so far, printing its report.
+ * Returns 0 on failure. */
+static int bench(const char *core_path, const char *rom_path, const void *state,
+		 size_t state_size, unsigned warmup, unsigned frames,
+		 struct bench_result *result)
+{
+	struct retro_system_info sysinfo;
+	struct retro_game_info game;
+	double *times, start, total;
+	void *rom = NULL;
+	size_t rom_size = 0;
+	unsigned i;
+
+	if (!load_core(core_path))
+		return 0;
+
+	core.set_environment(environment);
+	core.set_video_refresh(video_refresh);
+	core.set_audio_sample(audio_sample);
+	core.set_audio_sample_batch(audio_sample_batch);
+	core.set_input_poll(input_poll);
+	core.set_input_state(input_state);
+	core.init();
+
+	core.get_system_info(&sysinfo);
+	printf("Core: %s %s\n", sysinfo.library_name, sysinfo.library_version);
+
+	/* like a frontend, only hand over the contents if the core wants them */
+	if (!sysinfo.need_fullpath && !(rom = load_file(rom_path, &rom_size)))
+		return 0;
+
+	game.path = rom_path;
+	game.data = rom;
+	game.size = rom_size;
+	game.meta = NULL;
+	if (!core.load_game(&game)) {
+		fprintf(stderr, "The core refused to load '%s'\n", rom_path);
+		return 0;
+	}
+
+	/* the first frames boot the emulator; a state can only be loaded then */
+	for (i = 0; i < warmup; ++i)
+		core.run();
+
+	if (state && !core.unserialize(state, state_size)) {
+		fprintf(stderr, "Unable to load the savestate\n");
+		return 0;
+	}
+
+	times = (double *)malloc(frames * sizeof(*times));
+	if (!times)
+		return 0;
+
+	frames_presented = 0;
+	perf_reset();
+	start = now_ms();
+	for (i = 0; i < frames; ++i) {
+		double t = now_ms();
+		core.run();
+		times[i] = now_ms() - t;
+	}
+	total = now_ms() - start;
+
+	qsort(times, frames, sizeof(*times), compare_double);
+	result->fps = frames * 1000.0 / total;
+	result->p50 = percentile(times, frames, 0.5);
+
+	printf("Options: cpucore=%s gfxplugin=%s rspplugin=%s\n",
+	       option_value("cpucore") ? option_value("cpucore") : "?",
+	       option_value("gfxplugin") ? option_value("gfxplugin") : "?",
+	       option_value("rspplugin") ? option_value("rspplugin") : "?");
+	printf("Frames: %u in %.1f ms (%u presented)\n", frames, total, frames_presented);
+	printf("FPS: %.2f\n", result->fps);
+	printf("Frame time ms: min %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+	       times[0], result->p50, percentile(times, frames, 0.9),
+	       percentile(times, frames, 0.99), times[frames - 1]);
+
+	if (num_perf_counters) {
+		int c;
+		printf("Perf counters over the timed frames:\n");
+		for (c = 0; c < num_perf_counters; ++c) {
+			const struct retro_perf_counter *counter = perf_counters[c];
+			double ms = counter->total / 1000000.0;
+			if (!counter->call_cnt)
+				continue;
+			printf("  %-24s %10.1f ms %6.2f%% %10llu calls\n", counter->ident,
+			       ms, 100.0 * ms / total, (unsigned long long)counter->call_cnt);
+		}
+	} else {
+		printf("Perf counters: not available (build the core with HAVE_PERF_COUNTERS=1)\n");
+	}
+
+	core.unload_game();
+	core.deinit();
+	free(times);
+	free(rom);
+	return 1;
+}
+
+/* The core can't be unloaded and started again in the same process, so
+ * each cpu core is benchmarked in a child. Returns 0 if it failed. */
+static int bench_child(const char *cpucore, const char *core_path, const char *rom_path,
+		       const void *state, size_t state_size, unsigned warmup,
+		       unsigned frames, struct bench_result *result)
+{
+	int fds[2], status;
+	ssize_t got;
+	pid_t pid;
+
+	fflush(stdout);
+	if (pipe(fds) != 0)
+		return 0;
+
+	pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return 0;
+	}
+	if (pid == 0) {
+		int ok;
+
+		close(fds[0]);
+		set_option("cpucore", cpucore, 1);
+		ok = bench(core_path, rom_path, state, state_size, warmup, frames, result)
+		     && write(fds[1], result, sizeof(*result)) == sizeof(*result);
+		fflush(stdout);
+		_exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	got = read(fds[0], result, sizeof(*result));
+	close(fds[0]);
+	if (waitpid(pid, &status, 0) != pid)
+		return 0;
+	return got == sizeof(*result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_result results[MAX_CORES];
+	int ok[MAX_CORES];
+	char cores[256] = "", *names[MAX_CORES], *name;
+	unsigned frames = 1000, warmup = 60, num_cores = 0, i;
+	const char *state_path = NULL;
+	void *state = NULL;
+	size_t state_size = 0;
+	int arg;
+
+	set_option("gfxplugin", "angrylion", 1);
+
+	for (arg = 1; arg < argc && argv[arg][0] == '-'; ++arg) {
+		const char *opt = argv[arg];
+		const char *val = arg + 1 < argc ? argv[arg + 1] : NULL;
+
+		if (!strcmp(opt, "-v")) {
+			verbose = 1;
+			continue;
+		}
+		if (!val) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		++arg;
+
+		if (!strcmp(opt, "-f")) {
+			frames = strtoul(val, NULL, 10);
+		} else if (!strcmp(opt, "-w")) {
+			warmup = strtoul(val, NULL, 10);
+		} else if (!strcmp(opt, "-s")) {
+			state_path = val;
+		} else if (!strcmp(opt, "-c")) {
+			snprintf(cores, sizeof(cores), "%s", val);
+		} else if (!strcmp(opt, "-g")) {
+			set_option("gfxplugin", val, 1);
+		} else if (!strcmp(opt, "-r")) {
+			set_option("rspplugin", val, 1);
+		} else if (!strcmp(opt, "-d")) {
+			system_dir = val;
+		} else if (!strcmp(opt, "-o")) {
+			char key[128];
+			const char *eq = strchr(val, '=');
+			if (!eq || eq - val >= (int)sizeof(key)) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			memcpy(key, val, eq - val);
+			key[eq - val] = '\0';
+			set_option(key, eq + 1, 1);
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - arg != 2 || frames == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (state_path && !(state = load_file(state_path, &state_size)))
+		return EXIT_FAILURE;
+
+	if (!strchr(cores, ',')) {
+		struct bench_result result;
+
+		if (cores[0])
+			set_option("cpucore", cores, 1);
+		ok[0] = bench(argv[arg], argv[arg + 1], state, state_size, warmup, frames, &result);
+		free(state);
+		return ok[0] ? 0 : EXIT_FAILURE;
+	}
+
+	for (name = strtok(cores, ","); name && num_cores < MAX_CORES; name = strtok(NULL, ","))
+		names[num_cores++] = name;
+
+	for (i = 0; i < num_cores; ++i) {
+		ok[i] = bench_child(names[i], argv[arg], argv[arg + 1], state, state_size,
+				    warmup, frames, &results[i]);
+		if (!ok[i])
+			fprintf(stderr, "Benchmark of %s failed\n", names[i]);
+		printf("\n");
+	}
+
+	printf("Comparison over %u frames:\n", frames);
+	printf("  %-28s %10s %10s %8s\n", "cpucore", "FPS", "p50 ms", "speed");
+	for (i = 0; i < num_cores; ++i) {
+		if (!ok[i])
+			printf("  %-28s %10s\n", names[i], "failed");
+		else if (ok[0])
+			printf("  %-28s %10.2f %10.3f %7.2fx\n", names[i], results[i].fps,
+			       results[i].p50, results[i].fps / results[0].fps);
+		else
+			printf("  %-28s %10.2f %10.3f %8s\n", names[i], results[i].fps,
+			       results[i].p50, "-");
+	}
+
+	free(state);
+	return 0;
+}